@@ -0,0 +1,273 @@
+// PicoC ahead-of-time translator:
+// This compiles every function of a program that Comp.c can handle before main() is called, translates the compiled code into C,
+// has the system's C compiler make a shared library of it, and loads that to run in place of the compiled code.
+// The C works on the slots as Run.c does, though it keeps those that only its own operations reach in variables of their own;
+// and it calls back into Comp.c for calls out, tail calls and failures, and into Vec.c for element-wise loops,
+// so globals, library intrinsics and functions left to the interpreter are all reached just as they are from compiled code.
+// Constants, addresses and sites are written into the C as they are in this process: the library is only good for this run.
+#include "Main.h"
+#include "Extern.h"
+
+#ifndef NO_COMPILER
+#ifdef UNIX_HOST
+#include <dlfcn.h>
+
+#define AotCommandMax 0x400 // The longest command line for the C compiler.
+
+// The integer type Base, as a C cast.
+static const char *Cast(BaseType Base) {
+   switch (Base) {
+      case IntT: return "(int)";
+      case ShortIntT: return "(short)";
+      case CharT: return "(signed char)";
+      case NatT: return "(unsigned)";
+      case ShortNatT: return "(unsigned short)";
+      case ByteT: return "(unsigned char)";
+      default: return "";
+   }
+}
+
+// The size of the Base at an address.
+static int BaseSize(BaseType Base) {
+   switch (Base) {
+      case CharT: case ByteT: return 1;
+      case ShortIntT: case ShortNatT: return 2;
+      case IntT: case NatT: return 4;
+      default: return 8;
+   }
+}
+
+// A slot, as C: in the slots, if its address is taken, else the variable it has to itself, which the C compiler can keep in a register.
+// The names are made in turn in a few buffers, enough for the slots of any one operation.
+static const char *Var(CodeFunc Code, int Slot) {
+   static char Names[4][0x10];
+   static int Next;
+   char *Name = Names[Next++%4];
+   sprintf(Name, Code->Addressed[Slot]? "S[%d]": "V%d", Slot);
+   return Name;
+}
+
+// Write the address of a load or store: address K, indexed by the int in slot B for LoadXC and StoreXC.
+static void Address(FILE *Out, CodeFunc Code, CodeOp Op) {
+   fprintf(Out, "((char *)0x%lxUL", (unsigned long)Op->K.Pointer);
+   if (Op->Code == LoadXC || Op->Code == StoreXC)
+      fprintf(Out, " + (int)%s.I*%d", Var(Code, Op->B), BaseSize(Op->Base));
+   fprintf(Out, ")");
+}
+
+// Write an operation of Code as C.
+static void Translate(FILE *Out, CodeFunc Code, CodeOp Op) {
+   static const char *IntOp[] = { "+", "-", "*", "/", "%", "<<", ">>", "&", "|", "^" };
+   static const char *RelOp[] = { "==", "!=", "<", ">", "<=", ">=" };
+   static const char *RatOp[] = { "+", "-", "*", "/" };
+   static const char *JumpOp[] = { "==", "!=", "<", ">=", ">", "<=" };
+   int A = Op->A, B = Op->B, C = Op->C;
+   switch ((OpCode)Op->Code) {
+      case NopC: fprintf(Out, ";"); break;
+      case ClearC:
+         fprintf(Out, ";");
+         for (int Slot = A; Slot < B; Slot++)
+            fprintf(Out, " %s.I = 0;", Var(Code, Slot));
+      break;
+      case MovKC: fprintf(Out, "%s.I = (long)0x%lxUL;", Var(Code, A), (unsigned long)Op->K.Integer); break;
+      case MovC: fprintf(Out, "%s = %s;", Var(Code, A), Var(Code, B)); break;
+      case ConvC: fprintf(Out, "%s.I = %s%s.I;", Var(Code, A), Cast(Op->Base), Var(Code, B)); break;
+      case FloatC: fprintf(Out, "%s.F = (double)%s.I;", Var(Code, A), Var(Code, B)); break;
+      case FixC: fprintf(Out, "%s.I = (long)%s.F;", Var(Code, A), Var(Code, B)); break;
+   // Integer arithmetic wraps around, as it does in Run.c.
+      case AddC: case SubC: case MulC:
+         fprintf(Out, "%s.I = %s(long)((unsigned long)%s.I %s (unsigned long)%s.I);", Var(Code, A), Cast(Op->Base), Var(Code, B), IntOp[Op->Code - AddC], Var(Code, C));
+      break;
+      case DivC: case ModC: case AndC: case OrC: case XOrC:
+         fprintf(Out, "%s.I = %s(%s.I %s %s.I);", Var(Code, A), Cast(Op->Base), Var(Code, B), IntOp[Op->Code - AddC], Var(Code, C));
+      break;
+      case ShLC: fprintf(Out, "%s.I = %s(long)((unsigned long)%s.I << (%s.I&63));", Var(Code, A), Cast(Op->Base), Var(Code, B), Var(Code, C)); break;
+      case ShRC: fprintf(Out, "%s.I = %s(%s.I >> (%s.I&63));", Var(Code, A), Cast(Op->Base), Var(Code, B), Var(Code, C)); break;
+      case AddKC: fprintf(Out, "%s.I = %s(long)((unsigned long)%s.I + 0x%lxUL);", Var(Code, A), Cast(Op->Base), Var(Code, B), (unsigned long)Op->K.Integer); break;
+      case NegC: fprintf(Out, "%s.I = %s(long)-(unsigned long)%s.I;", Var(Code, A), Cast(Op->Base), Var(Code, B)); break;
+      case CplC: fprintf(Out, "%s.I = %s~%s.I;", Var(Code, A), Cast(Op->Base), Var(Code, B)); break;
+      case NotC: fprintf(Out, "%s.I = !%s.I;", Var(Code, A), Var(Code, B)); break;
+      case EqC: case NeC: case LtC: case GtC: case LeC: case GeC:
+         fprintf(Out, "%s.I = %s.I %s %s.I;", Var(Code, A), Var(Code, B), RelOp[Op->Code - EqC], Var(Code, C));
+      break;
+      case FAddC: case FSubC: case FMulC: case FDivC:
+         fprintf(Out, "%s.F = %s.F %s %s.F;", Var(Code, A), Var(Code, B), RatOp[Op->Code - FAddC], Var(Code, C));
+      break;
+      case FNegC: fprintf(Out, "%s.F = -%s.F;", Var(Code, A), Var(Code, B)); break;
+      case FNotC: fprintf(Out, "%s.F = %s.F == 0.0;", Var(Code, A), Var(Code, B)); break;
+      case FEqC: case FNeC: case FLtC: case FGtC: case FLeC: case FGeC:
+         fprintf(Out, "%s.I = %s.F %s %s.F;", Var(Code, A), Var(Code, B), RelOp[Op->Code - FEqC], Var(Code, C));
+      break;
+      case LoadC: case LoadXC:
+         switch (Op->Base) {
+            case CharT: fprintf(Out, "%s.I = *(signed char *)", Var(Code, A)); break;
+            case ByteT: fprintf(Out, "%s.I = *(unsigned char *)", Var(Code, A)); break;
+            case ShortIntT: fprintf(Out, "%s.I = *(short *)", Var(Code, A)); break;
+            case ShortNatT: fprintf(Out, "%s.I = *(unsigned short *)", Var(Code, A)); break;
+            case IntT: fprintf(Out, "%s.I = *(int *)", Var(Code, A)); break;
+            case NatT: fprintf(Out, "%s.I = *(unsigned *)", Var(Code, A)); break;
+            default: fprintf(Out, "memcpy(&%s, ", Var(Code, A)), Address(Out, Code, Op), fprintf(Out, ", 8);"); return;
+         }
+         Address(Out, Code, Op), fprintf(Out, ";");
+      break;
+      case StoreC: case StoreXC:
+         switch (BaseSize(Op->Base)) {
+            case 1: fprintf(Out, "*(char *)"); break;
+            case 2: fprintf(Out, "*(short *)"); break;
+            case 4: fprintf(Out, "*(int *)"); break;
+            default: fprintf(Out, "memcpy("), Address(Out, Code, Op), fprintf(Out, ", &%s, 8);", Var(Code, A)); return;
+         }
+         Address(Out, Code, Op), fprintf(Out, " = %s.I;", Var(Code, A));
+      break;
+      case JmpC: fprintf(Out, "goto L%ld;", Op->K.Integer); break;
+      case JzC: fprintf(Out, "if (%s.I == 0) goto L%ld;", Var(Code, A), Op->K.Integer); break;
+      case JnzC: fprintf(Out, "if (%s.I != 0) goto L%ld;", Var(Code, A), Op->K.Integer); break;
+      case JEqC: case JNeC: case JLtC: case JGeC: case JGtC: case JLeC:
+         fprintf(Out, "if (%s.I %s %s.I) goto L%ld;", Var(Code, B), JumpOp[Op->Code - JEqC], Var(Code, C), Op->K.Integer);
+      break;
+      case LoopC:
+         fprintf(Out, "%s.I = %s(long)((unsigned long)%s.I + 1); if (%s.I < %s.I) goto L%ld;", Var(Code, A), Cast(Op->Base), Var(Code, A), Var(Code, A), Var(Code, C), Op->K.Integer);
+      break;
+      case VecC: fprintf(Out, "Vec((void *)0x%lxUL, S);", (unsigned long)Op->K.Pointer); break;
+      case CallC:
+         if (A == NoSlot)
+            fprintf(Out, "Call((void *)0x%lxUL, &%s, 0);", (unsigned long)Op->K.Pointer, Var(Code, B));
+         else
+            fprintf(Out, "Call((void *)0x%lxUL, &%s, &%s);", (unsigned long)Op->K.Pointer, Var(Code, B), Var(Code, A));
+      break;
+      case TailCallC: fprintf(Out, "TailCall((void *)0x%lxUL, &%s);", (unsigned long)Op->K.Pointer, Var(Code, B)); break;
+      case FailC: fprintf(Out, "Fail((void *)0x%lxUL); return;", (unsigned long)Op->K.Pointer); break;
+      case RetC: fprintf(Out, "return;"); break;
+      default: break;
+   }
+}
+
+// Write a compiled function as the C function F<Index>, entered at the operation Start: its start, or one of its loops.
+// The slots whose addresses aren't taken are copied to variables of their own as it starts.
+static void TranslateFunction(FILE *Out, CodeFunc Code, const char *Name, int Index) {
+   fprintf(Out, "\n// %s\nvoid F%d(Slot *S, int Start) {\n", Name, Index);
+   for (int Slot = 0; Slot < Code->NumSlots; Slot++) {
+      if (!Code->Addressed[Slot])
+         fprintf(Out, "   Slot V%d = S[%d];\n", Slot, Slot);
+   }
+   fprintf(Out, "   switch (Start) {\n");
+   for (CodeEntry Entry = Code->Entries; Entry != NULL; Entry = Entry->Next) {
+   // Nested loops may start at the same operation.
+      CodeEntry Prev = Code->Entries;
+      while (Prev != Entry && Prev->Op != Entry->Op)
+         Prev = Prev->Next;
+      if (Prev == Entry)
+         fprintf(Out, "      case %d: goto L%d;\n", Entry->Op, Entry->Op);
+   }
+   fprintf(Out, "   }\n");
+   for (int N = 0; N < Code->NumOps; N++) {
+      fprintf(Out, "L%d: ", N);
+      Translate(Out, Code, &Code->Ops[N]);
+      fprintf(Out, "\n");
+   }
+   fprintf(Out, "}\n");
+}
+
+// Call Visit on each user-defined function of the program that's compiled, with its name and its number.
+static void EachFunction(State pc, void (*Visit)(State pc, CodeFunc Code, const char *Name, int Index, void *Data), void *Data) {
+   int Count = 0;
+   for (int H = 0; H < pc->GlobalTable.Size; H++) {
+      for (TableEntry Entry = pc->GlobalTable.HashTable[H]; Entry != NULL; Entry = Entry->Next) {
+         Value Val = Entry->p.v.Val;
+         if (Val->Typ->Base != FunctionT || Val->Val->FuncDef.Intrinsic != NULL || Val->Val->FuncDef.Body.Pos == NULL)
+            continue;
+         if (Val->Val->FuncDef.Compiled != NULL || (!Val->Val->FuncDef.NoCompile && CompileReady(pc, Val)))
+            Visit(pc, Val->Val->FuncDef.Compiled, Entry->p.v.Key, Count++, Data);
+      }
+   }
+}
+
+static void WriteFunction(State pc, CodeFunc Code, const char *Name, int Index, void *Data) {
+   TranslateFunction(Data, Code, Name, Index);
+}
+
+static void LoadFunction(State pc, CodeFunc Code, const char *Name, int Index, void *Data) {
+   char Symbol[0x20];
+   sprintf(Symbol, "F%d", Index);
+   union { void *Sym; void (*Aot)(CodeSlot Slots, int Start); } Entry;
+   Entry.Sym = dlsym(Data, Symbol);
+   Code->Aot = Entry.Aot;
+}
+
+// Write the whole program's compiled code to the C source file Source.
+// Return false if it can't be written.
+static bool WriteProgram(State pc, const char *Source) {
+   FILE *Out = fopen(Source, "w");
+   if (Out == NULL)
+      return false;
+   fprintf(Out, "// Translated by PicoC " PICOC_VERSION ": only good for the run it was made for.\n");
+   fprintf(Out, "#include <string.h>\n\n");
+   fprintf(Out, "typedef union { long I; double F; void *P; } Slot;\n");
+   fprintf(Out, "#define Call ((void (*)(void *, Slot *, Slot *))0x%lxUL)\n", (unsigned long)CompileCall);
+#ifdef TAIL_CALLS
+   fprintf(Out, "#define TailCall ((void (*)(void *, Slot *))0x%lxUL)\n", (unsigned long)CompileTailCall);
+#endif
+   fprintf(Out, "#define Fail ((void (*)(void *))0x%lxUL)\n", (unsigned long)CompileFail);
+   fprintf(Out, "#define Vec ((void (*)(void *, Slot *))0x%lxUL)\n", (unsigned long)VecRun);
+   EachFunction(pc, WriteFunction, Out);
+   return fclose(Out) == 0;
+}
+
+// Quote Path for the shell into Quoted, which holds Size characters: as '...', with each ' in it written as '\''.
+// Return false if it doesn't fit.
+static bool QuotePath(char *Quoted, size_t Size, const char *Path) {
+   size_t N = 0;
+   if (N < Size)
+      Quoted[N++] = '\'';
+   for (; *Path != '\0' && N < Size; Path++) {
+      if (*Path == '\'') {
+         for (const char *Q = "'\\''"; *Q != '\0' && N < Size; Q++)
+            Quoted[N++] = *Q;
+      } else
+         Quoted[N++] = *Path;
+   }
+   if (N + 1 >= Size)
+      return false;
+   Quoted[N++] = '\'', Quoted[N] = '\0';
+   return true;
+}
+#endif
+
+// Free the loaded translation.
+void AotFree(State pc) {
+#ifdef UNIX_HOST
+   if (pc->AotLibrary != NULL)
+      dlclose(pc->AotLibrary), pc->AotLibrary = NULL;
+#endif
+}
+#endif
+
+// Compile the program that's been read in, translate it into C and build and load that with the system's C compiler ($CC, or else cc),
+// to run in place of the compiled code: the C is written to Source, if it's given, else to a temporary file.
+// Return false if it's not been: the program then runs compiled or interpreted as usual.
+bool PicocTranslateProgram(State pc, const char *Source) {
+#if !defined NO_COMPILER && defined UNIX_HOST
+   char Dir[] = "/tmp/PicocXXXXXX", Library[sizeof Dir + 0x10], TempSource[sizeof Dir + 0x10];
+   if (mkdtemp(Dir) == NULL)
+      return false;
+   sprintf(Library, "%s/Aot.so", Dir), sprintf(TempSource, "%s/Aot.c", Dir);
+   if (Source == NULL || *Source == '\0')
+      Source = TempSource;
+// The paths are quoted, so that no character in them is taken by the shell for anything else.
+   char Command[AotCommandMax], QuotedLibrary[AotCommandMax/2], QuotedSource[AotCommandMax/2];
+   const char *CC = getenv("CC");
+   bool Ok =
+      WriteProgram(pc, Source) &&
+      QuotePath(QuotedLibrary, sizeof QuotedLibrary, Library) && QuotePath(QuotedSource, sizeof QuotedSource, Source) &&
+      snprintf(Command, sizeof Command, "%s -shared -fPIC -O2 -w -o %s %s >/dev/null 2>&1", CC != NULL? CC: "cc", QuotedLibrary, QuotedSource) < sizeof Command &&
+      system(Command) == 0 &&
+      (pc->AotLibrary = dlopen(Library, RTLD_NOW|RTLD_LOCAL)) != NULL;
+// Only then is the compiled code run, in its C translation.
+   if (Ok)
+      EachFunction(pc, LoadFunction, pc->AotLibrary), pc->JitEnabled = true;
+   remove(TempSource), remove(Library), rmdir(Dir);
+   return Ok;
+#else
+   return false;
+#endif
+}
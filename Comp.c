@@ -0,0 +1,2532 @@
+// PicoC compiler:
+// This translates a function's tokens, once it's been called or looped enough, into the code of a simple register machine with a slot for each local,
+// for Run.c to run and, once that's been run enough, for Jit.c to turn into machine code.
+// Only a subset of the language is handled: scalar parameters and locals, global scalars and arrays of them, calls and structured control flow.
+// A function using anything else is left to the interpreter.
+#include "Main.h"
+#include "Extern.h"
+
+#ifndef NO_COMPILER
+#define TempSlot 0x8000 // Marks a temporary, by a number of its own until the temporaries are laid out after the variables.
+#define NoJump (-1) // The end of a chain of jumps waiting for their target.
+#define MacroDepthMax 0x20 // The deepest nesting of macros expanded in a function.
+#define InlineDepthMax 4 // The deepest nesting of calls inlined in a function.
+#define InlineTokenMax 0x40 // The most tokens in the body of a function inlined at its calls.
+
+// How each operation uses its operands.
+enum { ReadA = 1, ReadB = 2, ReadC = 4, WriteA = 8, Pure = 0x10, IsJump = 0x20, ReadArgs = 0x40 };
+
+// NOTE: the order of this array must correspond exactly to the order of the operations in OpCode.
+static const unsigned char OpForm[] = {
+   0,						// NopC.
+   0,						// ClearC.
+   WriteA|Pure,					// MovKC.
+   WriteA|ReadB|Pure,				// MovC.
+   WriteA|ReadB|Pure,				// ConvC.
+   WriteA|ReadB|Pure,				// FloatC.
+   WriteA|ReadB|Pure,				// FixC.
+   WriteA|ReadB|ReadC|Pure,			// AddC.
+   WriteA|ReadB|ReadC|Pure,			// SubC.
+   WriteA|ReadB|ReadC|Pure,			// MulC.
+   WriteA|ReadB|ReadC,				// DivC.
+   WriteA|ReadB|ReadC,				// ModC.
+   WriteA|ReadB|ReadC|Pure,			// ShLC.
+   WriteA|ReadB|ReadC|Pure,			// ShRC.
+   WriteA|ReadB|ReadC|Pure,			// AndC.
+   WriteA|ReadB|ReadC|Pure,			// OrC.
+   WriteA|ReadB|ReadC|Pure,			// XOrC.
+   WriteA|ReadB|Pure,				// AddKC.
+   WriteA|ReadB|Pure,				// NegC.
+   WriteA|ReadB|Pure,				// CplC.
+   WriteA|ReadB|Pure,				// NotC.
+   WriteA|ReadB|ReadC|Pure,			// EqC.
+   WriteA|ReadB|ReadC|Pure,			// NeC.
+   WriteA|ReadB|ReadC|Pure,			// LtC.
+   WriteA|ReadB|ReadC|Pure,			// GtC.
+   WriteA|ReadB|ReadC|Pure,			// LeC.
+   WriteA|ReadB|ReadC|Pure,			// GeC.
+   WriteA|ReadB|ReadC|Pure,			// FAddC.
+   WriteA|ReadB|ReadC|Pure,			// FSubC.
+   WriteA|ReadB|ReadC|Pure,			// FMulC.
+   WriteA|ReadB|ReadC|Pure,			// FDivC.
+   WriteA|ReadB|Pure,				// FNegC.
+   WriteA|ReadB|Pure,				// FNotC.
+   WriteA|ReadB|ReadC|Pure,			// FEqC.
+   WriteA|ReadB|ReadC|Pure,			// FNeC.
+   WriteA|ReadB|ReadC|Pure,			// FLtC.
+   WriteA|ReadB|ReadC|Pure,			// FGtC.
+   WriteA|ReadB|ReadC|Pure,			// FLeC.
+   WriteA|ReadB|ReadC|Pure,			// FGeC.
+   WriteA|Pure,					// LoadC.
+   WriteA|ReadB|Pure,				// LoadXC.
+   ReadA,					// StoreC.
+   ReadA|ReadB,					// StoreXC.
+   IsJump,					// JmpC.
+   IsJump|ReadA,				// JzC.
+   IsJump|ReadA,				// JnzC.
+   IsJump|ReadB|ReadC,				// JEqC.
+   IsJump|ReadB|ReadC,				// JNeC.
+   IsJump|ReadB|ReadC,				// JLtC.
+   IsJump|ReadB|ReadC,				// JGeC.
+   IsJump|ReadB|ReadC,				// JGtC.
+   IsJump|ReadB|ReadC,				// JLeC.
+   IsJump|ReadA|WriteA|ReadC,			// LoopC.
+   ReadA|WriteA|ReadC,				// VecC.
+   WriteA|ReadArgs,				// CallC.
+   ReadArgs,					// TailCallC.
+   0,						// RetC.
+   0						// FailC.
+};
+
+// A local variable or parameter in scope.
+typedef struct CodeLocal {
+   const char *Ident;
+   ValueType Typ;
+   int Slot;
+} *CodeLocal;
+
+// A loop or switch statement, for the break and continue statements in it.
+typedef struct CodeExit *CodeExit;
+struct CodeExit {
+   CodeExit Outer; // The enclosing loop or switch.
+   bool IsSwitch;
+   int Breaks, Continues; // Chains of jumps to the end and to the next iteration.
+};
+
+// A call being inlined: the function called, where its result goes, and the chain of jumps from its returns to the end.
+typedef struct CodeInline *CodeInline;
+struct CodeInline {
+   CodeInline Outer; // The inlined call it's in, if any.
+   Value FuncValue;
+   int Result;
+   int Returns;
+};
+
+// What an expression compiles to: nothing, a constant, a slot, or a global in memory, which is only read when it's used.
+typedef enum OperandKind { VoidK, ConstK, SlotK, MemK } OperandKind;
+typedef struct Operand {
+   OperandKind Kind;
+   ValueType Typ;
+   bool IsLValue;
+   int Slot; // The slot, for SlotK; the slot holding the array index or NoSlot, for MemK.
+   union CodeSlot K; // The value, for ConstK; the address, for MemK.
+} Operand;
+
+// The state of the compiler, compiling a function.
+typedef struct Compiler {
+   State pc;
+   struct ParseState Parser; // Where we are in the function's tokens.
+   Value FuncValue; // The function being compiled.
+   struct FuncDef *Func;
+   CodeOp Ops; // The operations compiled so far.
+   int NumOps, MaxOps;
+   CodeSite Sites; // The calls and failures compiled so far.
+   CodeEntry Entries; // The loops compiled so far.
+   struct CodeLocal Local[CodeLocalMax]; // The parameters and local variables in scope, innermost last.
+   int NumLocals;
+   int Scope; // The first local in scope: those before it are the callers', in the body of an inlined call.
+   int NumVars; // The local variables declared, in any scope: each has a slot of its own.
+   int NumTemps, MaxTemps; // The temporaries in use, and the most ever in use.
+   int *TempPlace; // Where each temporary is in the statement's temporaries, by its number.
+   int NumTempIds, MaxTempIds;
+   int TempBase; // The temporaries of the statement an inlined call is in, which the statements of its body keep clear of.
+   int Entry; // Where the function's parameters have been set and its variables are cleared: a self tail call jumps back here.
+   int MacroDepth;
+   CodeExit Exit; // The innermost loop or switch.
+   CodeInline Inline; // The innermost call being inlined.
+   CodeInlining Inlinings; // The decisions on inlining the calls compiled so far.
+   jmp_buf Fail; // Where to go if the function can't be compiled.
+} *Compiler;
+
+static Operand CompileAssignment(Compiler Comp);
+static void CompileBlock(Compiler Comp);
+static void CompileStatement(Compiler Comp, bool AllowDeclaration);
+static bool Targeted(Compiler Comp, int N);
+
+// Give up on the function, leaving it to the interpreter.
+static void Decline(Compiler Comp) {
+   longjmp(Comp->Fail, 1);
+}
+
+// The next token, without consuming it.
+// Preprocessor directives are left to the interpreter.
+static Lexical Peek(Compiler Comp, Value *LexValue) {
+   Lexical Token = LexRawPeekToken(&Comp->Parser);
+   if (Token >= DefineP && Token <= LParP)
+      Decline(Comp);
+   return LexGetToken(&Comp->Parser, LexValue, false);
+}
+
+// Consume the next token.
+static Lexical Next(Compiler Comp, Value *LexValue) {
+   Lexical Token = LexRawPeekToken(&Comp->Parser);
+   if (Token >= DefineP && Token <= LParP)
+      Decline(Comp);
+   return LexGetToken(&Comp->Parser, LexValue, true);
+}
+
+// The token after the next one.
+static Lexical PeekSecond(Compiler Comp) {
+   struct ParseCursor Before;
+   ParserCopyPos(&Before, &Comp->Parser);
+   Next(Comp, NULL);
+   Lexical Token = Peek(Comp, NULL);
+   ParserCopyPos(&Comp->Parser, &Before);
+   return Token;
+}
+
+static void Expect(Compiler Comp, Lexical Token) {
+   if (Next(Comp, NULL) != Token)
+      Decline(Comp);
+}
+
+// Append an operation.
+static CodeOp Emit(Compiler Comp, OpCode Code, int A, int B, int C) {
+   if (Comp->NumOps == Comp->MaxOps) {
+      int MaxOps = 2*Comp->MaxOps + 0x40;
+      CodeOp Ops = HeapAllocMem(Comp->pc, MaxOps*sizeof *Ops);
+      if (Ops == NULL)
+         Decline(Comp);
+      if (Comp->Ops != NULL) {
+         memcpy(Ops, Comp->Ops, Comp->NumOps*sizeof *Ops);
+         HeapFreeMem(Comp->pc, Comp->Ops);
+      }
+      Comp->Ops = Ops, Comp->MaxOps = MaxOps;
+   }
+   CodeOp Op = &Comp->Ops[Comp->NumOps++];
+   memset(Op, '\0', sizeof *Op);
+   Op->Code = Code, Op->A = A, Op->B = B, Op->C = C;
+   return Op;
+}
+
+// Append a jump, adding it to the chain of jumps waiting for the same target.
+static void EmitJump(Compiler Comp, OpCode Code, int A, int *Chain) {
+   Emit(Comp, Code, A, 0, 0)->K.Integer = *Chain;
+   *Chain = Comp->NumOps - 1;
+}
+
+// Point a chain of jumps at Target.
+static void Patch(Compiler Comp, int Chain, int Target) {
+   while (Chain != NoJump) {
+      int Next = Comp->Ops[Chain].K.Integer;
+      Comp->Ops[Chain].K.Integer = Target;
+      Chain = Next;
+   }
+}
+
+// A new temporary.
+// Temporaries last only until the end of the statement, and are then reused.
+// But each gets a number of its own, for Tidy() to tell them apart.
+static int Temp(Compiler Comp) {
+   if (Comp->NumTempIds == Comp->MaxTempIds) {
+      int MaxTempIds = 2*Comp->MaxTempIds + 0x40;
+      int *TempPlace = MaxTempIds < TempSlot? HeapAllocMem(Comp->pc, MaxTempIds*sizeof *TempPlace): NULL;
+      if (TempPlace == NULL)
+         Decline(Comp);
+      if (Comp->TempPlace != NULL) {
+         memcpy(TempPlace, Comp->TempPlace, Comp->NumTempIds*sizeof *TempPlace);
+         HeapFreeMem(Comp->pc, Comp->TempPlace);
+      }
+      Comp->TempPlace = TempPlace, Comp->MaxTempIds = MaxTempIds;
+   }
+   Comp->TempPlace[Comp->NumTempIds] = Comp->NumTemps++;
+   if (Comp->NumTemps > Comp->MaxTemps)
+      Comp->MaxTemps = Comp->NumTemps;
+   return TempSlot|Comp->NumTempIds++;
+}
+
+// A slot for a new local variable, which keeps it for the whole function.
+static int Variable(Compiler Comp) {
+   if (Comp->NumVars == CodeLocalMax)
+      Decline(Comp);
+   return 1 + Comp->Func->NumParams + Comp->NumVars++;
+}
+
+// The parameter or local variable in scope named Ident, if any.
+static CodeLocal FindLocal(Compiler Comp, const char *Ident) {
+   for (int L = Comp->NumLocals - 1; L >= Comp->Scope; L--) {
+      if (Comp->Local[L].Ident == Ident)
+         return &Comp->Local[L];
+   }
+   return NULL;
+}
+
+// Handle the types the compiler handles: integers and doubles.
+static bool IsScalar(State pc, ValueType Typ) {
+#ifndef NO_FP
+   if (Typ == &pc->FPType)
+      return true;
+#endif
+   return IsIntType(Typ);
+}
+
+static bool IsRat(ValueType Typ) {
+#ifndef NO_FP
+   return Typ->Base == RatT;
+#else
+   return false;
+#endif
+}
+
+static bool IsUnsigned(BaseType Base) {
+   return Base >= NatT && Base <= LongNatT;
+}
+
+// Convert an integer to one of the integer types, as an assignment would.
+static long IntConvert(long Integer, BaseType Base) {
+   switch (Base) {
+      case IntT: return (int)Integer;
+      case ShortIntT: return (short)Integer;
+      case CharT: return (char)Integer;
+      case NatT: return (unsigned)Integer;
+      case ShortNatT: return (unsigned short)Integer;
+      case ByteT: return (unsigned char)Integer;
+      default: return Integer;
+   }
+}
+
+// Does every integer of type From convert to type To unchanged?
+static bool Fits(BaseType From, BaseType To) {
+   switch (To) {
+      case LongIntT: case LongNatT: return true;
+      case IntT: return From == IntT || From == ShortIntT || From == CharT || From == ShortNatT || From == ByteT;
+      case ShortIntT: return From == ShortIntT || From == CharT || From == ByteT;
+      case NatT: return From == NatT || From == ShortNatT || From == ByteT;
+      case ShortNatT: return From == ShortNatT || From == ByteT;
+      default: return From == To;
+   }
+}
+
+static Operand IntConst(ValueType Typ, long Integer) {
+   Operand X = { ConstK, Typ, false, NoSlot };
+   X.K.Integer = Integer;
+   return X;
+}
+
+#ifndef NO_FP
+static Operand RatConst(State pc, double FP) {
+   Operand X = { ConstK, &pc->FPType, false, NoSlot };
+   X.K.FP = FP;
+   return X;
+}
+#endif
+
+static Operand InSlot(ValueType Typ, int Slot, bool IsLValue) {
+   Operand X = { SlotK, Typ, IsLValue, Slot };
+   return X;
+}
+
+// Put the value of X into slot Dest.
+static void Place(Compiler Comp, Operand *X, int Dest) {
+   switch (X->Kind) {
+      case ConstK: {
+         CodeOp Op = Emit(Comp, MovKC, Dest, 0, 0);
+         Op->Base = X->Typ->Base, Op->K = X->K;
+      }
+      break;
+      case SlotK:
+         if (X->Slot != Dest)
+            Emit(Comp, MovC, Dest, X->Slot, 0);
+      break;
+      case MemK: {
+         if (!IsScalar(Comp->pc, X->Typ))
+            Decline(Comp);
+         CodeOp Op = X->Slot == NoSlot? Emit(Comp, LoadC, Dest, 0, 0): Emit(Comp, LoadXC, Dest, X->Slot, 0);
+         Op->Base = X->Typ->Base, Op->K = X->K;
+      }
+      break;
+      default: Decline(Comp); break;
+   }
+}
+
+// The slot holding the value of X, which is read now if it's in memory.
+static int Use(Compiler Comp, Operand *X) {
+   if (X->Kind == SlotK)
+      return X->Slot;
+   int Slot = Temp(Comp);
+   Place(Comp, X, Slot);
+   return Slot;
+}
+
+// A temporary holding the value in Slot, which may be a variable's.
+static int Fresh(Compiler Comp, int Slot) {
+   if (Slot&TempSlot)
+      return Slot;
+   int T = Temp(Comp);
+   Emit(Comp, MovC, T, Slot, 0);
+   return T;
+}
+
+// An integer X as an int, the type the interpreter gives the results of integer arithmetic, in a temporary.
+static Operand IntResult(Compiler Comp, int Slot, ValueType Typ) {
+   if (Fits(Typ->Base, IntT))
+      return InSlot(&Comp->pc->IntType, Fresh(Comp, Slot), false);
+   int T = Temp(Comp);
+   Emit(Comp, ConvC, T, Slot, 0)->Base = IntT;
+   return InSlot(&Comp->pc->IntType, T, false);
+}
+
+#ifndef NO_FP
+// The slot holding X as a double, converted the way arithmetic converts it.
+static int RatSlot(Compiler Comp, Operand *X) {
+   if (IsRat(X->Typ))
+      return Use(Comp, X);
+   if (X->Kind == ConstK) {
+      Operand Y = RatConst(Comp->pc, (double)X->K.Integer);
+      return Use(Comp, &Y);
+   }
+   int T = Temp(Comp);
+   Emit(Comp, FloatC, T, Use(Comp, X), 0);
+   return T;
+}
+#endif
+
+// The integer value of X, as a condition, in a slot: a double is truncated to an integer.
+static int Test(Compiler Comp, Operand *X) {
+   if (!IsScalar(Comp->pc, X->Typ))
+      Decline(Comp);
+   if (!IsRat(X->Typ))
+      return Use(Comp, X);
+   int T = Temp(Comp);
+   Emit(Comp, FixC, T, Use(Comp, X), 0);
+   return T;
+}
+
+// Jump to the chain if X, as a condition, is IfTrue.
+static void Branch(Compiler Comp, Operand *X, bool IfTrue, int *Chain) {
+   if (X->Kind == ConstK && IsScalar(Comp->pc, X->Typ)) {
+#ifndef NO_FP
+      bool Truth = IsRat(X->Typ)? (long)X->K.FP != 0: X->K.Integer != 0;
+#else
+      bool Truth = X->K.Integer != 0;
+#endif
+      if (Truth == IfTrue)
+         EmitJump(Comp, JmpC, 0, Chain);
+   } else
+      EmitJump(Comp, IfTrue? JnzC: JzC, Test(Comp, X), Chain);
+}
+
+// Convert X to type To into slot Dest, the way ExpressionAssign() converts values for declarations, parameters, return values and casts.
+static void Convert(Compiler Comp, ValueType To, Operand *X, int Dest) {
+   if (!IsScalar(Comp->pc, X->Typ) || !IsScalar(Comp->pc, To))
+      Decline(Comp);
+   BaseType From = X->Typ->Base;
+#ifndef NO_FP
+   if (IsRat(To)) {
+      if (IsRat(X->Typ))
+         Place(Comp, X, Dest);
+      else if (X->Kind == ConstK) {
+#   ifndef BROKEN_FLOAT_CASTS
+         Operand Y = RatConst(Comp->pc, From == LongIntT? (double)(int)X->K.Integer: From == LongNatT? (double)(unsigned)X->K.Integer: (double)X->K.Integer);
+#   else
+         Operand Y = RatConst(Comp->pc, From == LongNatT? (double)(unsigned long)X->K.Integer: (double)X->K.Integer);
+#   endif
+         Place(Comp, &Y, Dest);
+      } else {
+         int Slot = Use(Comp, X);
+#   ifndef BROKEN_FLOAT_CASTS
+      // Longs are cut down to 32 bits first.
+         if (From == LongIntT || From == LongNatT) {
+            int T = Temp(Comp);
+            Emit(Comp, ConvC, T, Slot, 0)->Base = From == LongIntT? IntT: NatT;
+            Slot = T;
+         }
+#   else
+         if (From == LongNatT)
+            Decline(Comp);
+#   endif
+         Emit(Comp, FloatC, Dest, Slot, 0);
+      }
+      return;
+   }
+   if (IsRat(X->Typ)) {
+   // Converting a double to an unsigned type isn't the same as converting it to a long first.
+      if (IsUnsigned(To->Base))
+         Decline(Comp);
+      if (X->Kind == ConstK) {
+         Operand Y = IntConst(To, IntConvert((long)X->K.FP, To->Base));
+         Place(Comp, &Y, Dest);
+      } else {
+         Emit(Comp, FixC, Dest, Use(Comp, X), 0);
+         if (To->Base != LongIntT)
+            Emit(Comp, ConvC, Dest, Dest, 0)->Base = To->Base;
+      }
+      return;
+   }
+#endif
+   if (X->Kind == ConstK) {
+      Operand Y = IntConst(To, IntConvert(X->K.Integer, To->Base));
+      Place(Comp, &Y, Dest);
+   } else if (Fits(From, To->Base))
+      Place(Comp, X, Dest);
+   else
+      Emit(Comp, ConvC, Dest, Use(Comp, X), 0)->Base = To->Base;
+}
+
+// X cast to type To.
+static Operand Cast(Compiler Comp, ValueType To, Operand *X) {
+   if (X->Kind == ConstK && IsScalar(Comp->pc, X->Typ) && IsScalar(Comp->pc, To) && !IsRat(To)) {
+#ifndef NO_FP
+      if (IsRat(X->Typ)) {
+         if (IsUnsigned(To->Base))
+            Decline(Comp);
+         return IntConst(To, IntConvert((long)X->K.FP, To->Base));
+      }
+#endif
+      return IntConst(To, IntConvert(X->K.Integer, To->Base));
+   }
+   int T = Temp(Comp);
+   Convert(Comp, To, X, T);
+   return InSlot(To, T, false);
+}
+
+// Store the value in slot Src, of type From, to the lvalue Dest, converting it the way an assignment does.
+// A double is only ever stored to a double.
+static void Store(Compiler Comp, Operand *Dest, int Src, ValueType From) {
+   if (Dest->Kind == SlotK) {
+      if (IsRat(Dest->Typ) || Fits(From->Base, Dest->Typ->Base)) {
+         if (Src != Dest->Slot)
+            Emit(Comp, MovC, Dest->Slot, Src, 0);
+      } else
+         Emit(Comp, ConvC, Dest->Slot, Src, 0)->Base = Dest->Typ->Base;
+   } else {
+      CodeOp Op = Dest->Slot == NoSlot? Emit(Comp, StoreC, Src, 0, 0): Emit(Comp, StoreXC, Src, Dest->Slot, 0);
+      Op->Base = Dest->Typ->Base, Op->K = Dest->K;
+   }
+}
+
+// Evaluate an integer operation on constants, as the interpreter would, in a long.
+// Return false if it's best left until it's run, because it would trap or its result is undefined.
+static bool FoldInt(OpCode Code, long X, long Y, long *Result) {
+   unsigned long UX = X, UY = Y;
+   switch (Code) {
+      case AddC: *Result = (long)(UX + UY); break;
+      case SubC: *Result = (long)(UX - UY); break;
+      case MulC: *Result = (long)(UX*UY); break;
+      case DivC:
+         if (Y == 0)
+            return false;
+         *Result = Y == -1? (long)(0 - UX): X/Y;
+      break;
+      case ModC:
+         if (Y == 0)
+            return false;
+         *Result = Y == -1? 0: X%Y;
+      break;
+      case ShLC:
+         if (Y < 0 || Y > 63)
+            return false;
+         *Result = (long)(UX << Y);
+      break;
+      case ShRC:
+         if (Y < 0 || Y > 63)
+            return false;
+         *Result = X >> Y;
+      break;
+      case AndC: *Result = X&Y; break;
+      case OrC: *Result = X|Y; break;
+      case XOrC: *Result = X^Y; break;
+      case EqC: *Result = X == Y; break;
+      case NeC: *Result = X != Y; break;
+      case LtC: *Result = X < Y; break;
+      case GtC: *Result = X > Y; break;
+      case LeC: *Result = X <= Y; break;
+      case GeC: *Result = X >= Y; break;
+      default: return false;
+   }
+   return true;
+}
+
+// The integer operation for an operator, or for the arithmetic part of an assignment operator.
+static OpCode IntCode(Lexical Op) {
+   switch (Op) {
+      case AddL: case AddEquL: return AddC;
+      case SubL: case SubEquL: return SubC;
+      case StarL: case MulEquL: return MulC;
+      case DivL: case DivEquL: return DivC;
+#ifndef NO_MODULUS
+      case ModL: case ModEquL: return ModC;
+#endif
+      case ShLL: case ShLEquL: return ShLC;
+      case ShRL: case ShREquL: return ShRC;
+      case AndL: case AndEquL: return AndC;
+      case OrL: case OrEquL: return OrC;
+      case XOrL: case XOrEquL: return XOrC;
+      case RelEqL: return EqC;
+      case RelNeL: return NeC;
+      case RelLtL: return LtC;
+      case RelGtL: return GtC;
+      case RelLeL: return LeC;
+      case RelGeL: return GeC;
+      default: return NopC;
+   }
+}
+
+#ifndef NO_FP
+// The floating point operation for an operator, or for the arithmetic part of an assignment operator.
+static OpCode RatCode(Lexical Op) {
+   switch (Op) {
+      case AddL: case AddEquL: return FAddC;
+      case SubL: case SubEquL: return FSubC;
+      case StarL: case MulEquL: return FMulC;
+      case DivL: case DivEquL: return FDivC;
+      case RelEqL: return FEqC;
+      case RelNeL: return FNeC;
+      case RelLtL: return FLtC;
+      case RelGtL: return FGtC;
+      case RelLeL: return FLeC;
+      case RelGeL: return FGeC;
+      default: return NopC;
+   }
+}
+#endif
+
+// An integer operation on X and Y, with the result converted to Base in a new temporary.
+static int IntOperation(Compiler Comp, OpCode Code, Operand *X, Operand *Y, BaseType Base) {
+   CodeOp Op;
+   if ((Code == AddC || Code == SubC) && Y->Kind == ConstK) {
+      int B = Use(Comp, X);
+      Op = Emit(Comp, AddKC, Temp(Comp), B, 0);
+      Op->K.Integer = Code == AddC? Y->K.Integer: (long)(0 - (unsigned long)Y->K.Integer);
+   } else if (Code == AddC && X->Kind == ConstK) {
+      int B = Use(Comp, Y);
+      Op = Emit(Comp, AddKC, Temp(Comp), B, 0);
+      Op->K.Integer = X->K.Integer;
+   } else {
+      int B = Use(Comp, X), C = Use(Comp, Y);
+      Op = Emit(Comp, Code, Temp(Comp), B, C);
+   }
+   Op->Base = Base;
+   return Op->A;
+}
+
+// Apply an infix operator.
+// As in the interpreter, a variable operand is only read now, after the right hand side has been evaluated.
+static Operand Infix(Compiler Comp, Lexical Op, Operand *X, Operand *Y) {
+   State pc = Comp->pc;
+   if (!IsScalar(pc, X->Typ) || !IsScalar(pc, Y->Typ))
+      Decline(Comp);
+#ifndef NO_FP
+   if (IsRat(X->Typ) || IsRat(Y->Typ)) {
+      OpCode Code = RatCode(Op);
+      if (Code == NopC)
+         Decline(Comp);
+      int B = RatSlot(Comp, X), C = RatSlot(Comp, Y), T = Temp(Comp);
+      Emit(Comp, Code, T, B, C);
+      return InSlot(Code >= FEqC? &pc->IntType: &pc->FPType, T, false);
+   }
+#endif
+   OpCode Code = IntCode(Op);
+   if (Code == NopC)
+      Decline(Comp);
+   long Result;
+   if (X->Kind == ConstK && Y->Kind == ConstK && FoldInt(Code, X->K.Integer, Y->K.Integer, &Result))
+      return IntConst(&pc->IntType, (int)Result);
+   if (Code >= EqC) {
+      int B = Use(Comp, X), C = Use(Comp, Y), T = Temp(Comp);
+      Emit(Comp, Code, T, B, C);
+      return InSlot(&pc->IntType, T, false);
+   }
+   return InSlot(&pc->IntType, IntOperation(Comp, Code, X, Y, IntT), false);
+}
+
+// Apply an assignment operator.
+// The result is a new value: an int, the way the interpreter returns it, or a double.
+static Operand Assign(Compiler Comp, Lexical Op, Operand *X, Operand *Y) {
+   State pc = Comp->pc;
+   if (!X->IsLValue || !IsScalar(pc, X->Typ) || !IsScalar(pc, Y->Typ))
+      Decline(Comp);
+#ifndef NO_FP
+   if (IsRat(X->Typ) || IsRat(Y->Typ)) {
+      int R;
+      if (Op == EquL)
+         R = RatSlot(Comp, Y);
+      else {
+         OpCode Code = RatCode(Op);
+         if (Code == NopC || Code >= FEqC)
+            Decline(Comp);
+         int B = RatSlot(Comp, X), C = RatSlot(Comp, Y);
+         R = Temp(Comp);
+         Emit(Comp, Code, R, B, C);
+      }
+      if (IsRat(X->Typ)) {
+         R = Fresh(Comp, R);
+         Store(Comp, X, R, &pc->FPType);
+         return InSlot(&pc->FPType, R, false);
+      }
+      int T = Temp(Comp);
+      Emit(Comp, FixC, T, R, 0);
+      Store(Comp, X, T, &pc->LongType);
+      return IntResult(Comp, T, &pc->LongType);
+   }
+#endif
+   if (Op == EquL) {
+      int V = Use(Comp, Y);
+      Operand Result = IntResult(Comp, V, Y->Typ);
+      Store(Comp, X, V, Y->Typ);
+      return Result;
+   }
+   OpCode Code = IntCode(Op);
+   if (Code == NopC)
+      Decline(Comp);
+   int T = IntOperation(Comp, Code, X, Y, LongIntT);
+   Store(Comp, X, T, &pc->LongType);
+   return IntResult(Comp, T, &pc->LongType);
+}
+
+// Apply ++ or -- to X, before or after reading it.
+static Operand IncDec(Compiler Comp, Lexical Op, Operand *X, bool Before) {
+   State pc = Comp->pc;
+   if (!X->IsLValue || !IsScalar(pc, X->Typ))
+      Decline(Comp);
+#ifndef NO_FP
+   if (IsRat(X->Typ)) {
+   // Either way the interpreter returns the new value.
+      Operand One = RatConst(pc, 1.0);
+      int B = Use(Comp, X), C = Use(Comp, &One), T = Temp(Comp);
+      Emit(Comp, Op == IncOpL? FAddC: FSubC, T, B, C);
+      Store(Comp, X, T, &pc->FPType);
+      return InSlot(&pc->FPType, T, false);
+   }
+#endif
+   int Slot = Use(Comp, X);
+   Operand Result = Before? IntConst(&pc->IntType, 0): IntResult(Comp, Slot, X->Typ);
+   int T = Temp(Comp);
+   CodeOp Add = Emit(Comp, AddKC, T, Slot, 0);
+   Add->Base = LongIntT, Add->K.Integer = Op == IncOpL? 1: -1;
+   Store(Comp, X, T, &pc->LongType);
+   return Before? IntResult(Comp, T, &pc->LongType): Result;
+}
+
+// Apply a prefix arithmetic operator.
+static Operand Prefix(Compiler Comp, Lexical Op, Operand *X) {
+   State pc = Comp->pc;
+   if (!IsScalar(pc, X->Typ))
+      Decline(Comp);
+#ifndef NO_FP
+   if (IsRat(X->Typ)) {
+      if (Op == CplL)
+         Decline(Comp);
+      if (X->Kind == ConstK)
+         return RatConst(pc, Op == SubL? -X->K.FP: Op == NotL? (double)!X->K.FP: X->K.FP);
+      int B = Use(Comp, X), T = Temp(Comp);
+      Emit(Comp, Op == SubL? FNegC: Op == NotL? FNotC: MovC, T, B, 0);
+      return InSlot(&pc->FPType, T, false);
+   }
+#endif
+   if (X->Kind == ConstK) {
+      long Integer = X->K.Integer;
+      switch (Op) {
+         case SubL: Integer = (long)(0 - (unsigned long)Integer); break;
+         case NotL: Integer = !Integer; break;
+         case CplL: Integer = ~Integer; break;
+         default: break;
+      }
+      return IntConst(&pc->IntType, (int)Integer);
+   }
+   int B = Use(Comp, X), T = Temp(Comp);
+   switch (Op) {
+      case SubL: Emit(Comp, NegC, T, B, 0)->Base = IntT; break;
+      case NotL: Emit(Comp, NotC, T, B, 0); break;
+      case CplL: Emit(Comp, CplC, T, B, 0)->Base = IntT; break;
+      default: return IntResult(Comp, B, X->Typ);
+   }
+   return InSlot(&pc->IntType, T, false);
+}
+
+// Parse a base type: only the arithmetic types, as TypeParseFront() parses them.
+static ValueType CompileType(Compiler Comp) {
+   State pc = Comp->pc;
+   Lexical Token = Next(Comp, NULL);
+   while (Token == AutoL || Token == RegisterL)
+      Token = Next(Comp, NULL);
+   bool Unsigned = Token == UnsignedL;
+   if (Token == SignedL || Token == UnsignedL) {
+      Lexical FollowToken = Peek(Comp, NULL);
+      if (FollowToken != IntL && FollowToken != LongL && FollowToken != ShortL && FollowToken != CharL)
+         return Unsigned? &pc->UnsignedIntType: &pc->IntType;
+      Token = Next(Comp, NULL);
+   }
+   switch (Token) {
+      case IntL: return Unsigned? &pc->UnsignedIntType: &pc->IntType;
+      case ShortL: return Unsigned? &pc->UnsignedShortType: &pc->ShortType;
+      case CharL: return Unsigned? &pc->UnsignedCharType: &pc->CharType;
+      case LongL: return Unsigned? &pc->UnsignedLongType: &pc->LongType;
+#ifndef NO_FP
+      case FloatL: case DoubleL: return &pc->FPType;
+#endif
+      default: Decline(Comp); return NULL;
+   }
+}
+
+// Is the global Ident a typedef?
+static bool IsTypedef(Compiler Comp, const char *Ident) {
+   if (FindLocal(Comp, Ident) != NULL)
+      return false;
+   Value Val = TableGet(&Comp->pc->GlobalTable, Ident, NULL, NULL, NULL);
+   return Val != NULL && Val->Typ == &Comp->pc->TypeType;
+}
+
+// A new call site: where the parser is now.
+static CodeSite NewSite(Compiler Comp, Value Func, const char *FuncName, int NumArgs) {
+   CodeSite Site = HeapAllocMem(Comp->pc, sizeof *Site + NumArgs*sizeof Site->ArgType[0]);
+   if (Site == NULL)
+      Decline(Comp);
+   Site->Next = Comp->Sites, Comp->Sites = Site;
+   ParserCopy(&Site->Where, &Comp->Parser);
+   Site->Where.Mode = RunM;
+   Site->Func = Func, Site->FuncName = FuncName, Site->NumArgs = NumArgs;
+   return Site;
+}
+
+// Note a loop, at Where on Line in the tokens, whose body starts at operation Top,
+// that an interpreted call can carry on from at operation Op, with the variables now in scope.
+// The caller notes where the loop ends, once its jump back is compiled.
+static CodeEntry NewEntry(Compiler Comp, const unsigned char *Where, int Line, int Top, int Op) {
+   CodeEntry Entry = HeapAllocMem(Comp->pc, sizeof *Entry + Comp->NumLocals*sizeof Entry->Var[0]);
+   if (Entry == NULL)
+      Decline(Comp);
+// The loops are kept in the order they're finished: an inner loop before the loop it's in.
+   CodeEntry *At = &Comp->Entries;
+   while (*At != NULL)
+      At = &(*At)->Next;
+   *At = Entry;
+   Entry->Where = Where, Entry->Line = Line, Entry->Top = Top, Entry->Op = Op, Entry->NumVars = Comp->NumLocals;
+   for (int L = 0; L < Comp->NumLocals; L++)
+      Entry->Var[L].Ident = Comp->Local[L].Ident, Entry->Var[L].Slot = Comp->Local[L].Slot;
+   return Entry;
+}
+
+// Count the arguments of a call, up to the close bracket, without consuming them.
+static int CountArguments(Compiler Comp) {
+   struct ParseState Scan;
+   ParserCopy(&Scan, &Comp->Parser);
+   if (LexGetToken(&Scan, NULL, false) == RParL)
+      return 0;
+   int Count = 1;
+   for (int Depth = 0; ; ) {
+      switch (LexGetToken(&Scan, NULL, true)) {
+         case LParL: case LBrL: Depth++; break;
+         case RParL: case RBrL:
+            if (Depth-- == 0)
+               return Count;
+         break;
+         case CommaL:
+            if (Depth == 0)
+               Count++;
+         break;
+         case EofL: case EndFnL: Decline(Comp); break;
+         default: break;
+      }
+   }
+}
+
+// The function that a call to Ident calls, if the compiler can call it:
+// an intrinsic, or a defined function, with scalar or string parameters and a scalar or void result.
+static struct FuncDef *CallableFunction(Compiler Comp, const char *Ident, Value *FuncValue) {
+   State pc = Comp->pc;
+   if (FindLocal(Comp, Ident) != NULL)
+      Decline(Comp);
+   *FuncValue = TableGet(&pc->GlobalTable, Ident, NULL, NULL, NULL);
+   if (*FuncValue == NULL || (*FuncValue)->Typ != &pc->FunctionType)
+      Decline(Comp);
+   struct FuncDef *Func = &(*FuncValue)->Val->FuncDef;
+   if (Func->Intrinsic == NULL && (Func->Body.Pos == NULL || Func->VarArgs))
+      Decline(Comp);
+   if (Func->ReturnType != &pc->VoidType && !IsScalar(pc, Func->ReturnType))
+      Decline(Comp);
+   for (int P = 0; P < Func->NumParams; P++) {
+      if (!IsScalar(pc, Func->ParamType[P]) && Func->ParamType[P] != pc->CharPtrType)
+         Decline(Comp);
+   }
+   return Func;
+}
+
+#ifdef TAIL_CALLS
+// Whether a call, with Scan just after its open bracket, is all there is to the statement it's in: it's followed by a semicolon.
+static bool CallEndsStatement(ParseState Scan) {
+   for (int Depth = 0; Depth >= 0; ) {
+      switch (LexGetToken(Scan, NULL, true)) {
+         case LParL: case LBrL: Depth++; break;
+         case RParL: case RBrL: Depth--; break;
+         case EofL: case EndFnL: return false;
+         default: break;
+      }
+   }
+   return LexGetToken(Scan, NULL, false) == SemiL;
+}
+#endif
+
+// Why a call of the defined function FuncValue can't be inlined, or NULL if it can.
+// It can be if it's not being compiled already, takes only numbers, and has a small body without loops, switches, gotos or tail calls,
+// since a loop inlined would have no entry from the interpreter, and a tail call inlined would no longer be one.
+static const char *Uninlinable(Compiler Comp, Value FuncValue) {
+   State pc = Comp->pc;
+   struct FuncDef *Func = &FuncValue->Val->FuncDef;
+   int Depth = 0;
+   for (CodeInline Inline = Comp->Inline; Inline != NULL; Inline = Inline->Outer, Depth++) {
+      if (Inline->FuncValue == FuncValue)
+         return "it's recursive";
+   }
+   if (FuncValue == Comp->FuncValue)
+      return "it's recursive";
+   if (Depth == InlineDepthMax)
+      return "the calls it's in are inlined too deeply";
+   if (Func->NoCompile)
+      return "it can't be compiled";
+   for (int P = 0; P < Func->NumParams; P++) {
+      if (!IsScalar(pc, Func->ParamType[P]))
+         return "it takes a string";
+   }
+   struct ParseState Scan;
+   ParserCopy(&Scan, &Func->Body);
+   for (int NumTokens = 0, Level = 0; ; NumTokens++) {
+      if (NumTokens > InlineTokenMax)
+         return "it's too big";
+      switch (LexGetToken(&Scan, NULL, true)) {
+         case LCurlL: Level++; break;
+         case RCurlL:
+            if (--Level == 0)
+               return NULL;
+         break;
+         case WhileL: case DoL: case ForL: case SwitchL: case GotoL: return "it has a loop, a switch or a goto";
+         case EofL: case EndFnL: return "it can't be compiled";
+#ifdef TAIL_CALLS
+         case ReturnL: {
+            struct ParseState Call;
+            ParserCopy(&Call, &Scan);
+            Value LexValue;
+            if (LexGetToken(&Call, &LexValue, true) != IdL)
+               break;
+            Value Callee = TableGet(&pc->GlobalTable, LexValue->Val->Identifier, NULL, NULL, NULL);
+            if (
+               Callee != NULL && Callee->Typ == &pc->FunctionType && Callee->Val->FuncDef.Intrinsic == NULL &&
+               LexGetToken(&Call, NULL, true) == LParL && CallEndsStatement(&Call)
+            )
+               return "it makes a tail call";
+         }
+         break;
+#endif
+         default: break;
+      }
+   }
+}
+
+// Note whether a call of FuncName, on Line in FileName, is inlined: it is if there's no Reason it's not.
+// The notes are kept in the order the calls are compiled, after their arguments.
+static CodeInlining NewInlining(Compiler Comp, const char *FileName, int Line, const char *FuncName, const char *Reason) {
+   CodeInlining Note = HeapAllocMem(Comp->pc, sizeof *Note);
+   if (Note == NULL)
+      Decline(Comp);
+   CodeInlining *At = &Comp->Inlinings;
+   while (*At != NULL)
+      At = &(*At)->Next;
+   *At = Note;
+   Note->FileName = FileName, Note->Line = Line, Note->FuncName = FuncName, Note->Reason = Reason;
+   return Note;
+}
+
+// Free a list of notes on inlining.
+static void FreeInlinings(State pc, CodeInlining Notes) {
+   while (Notes != NULL) {
+      CodeInlining Next = Notes->Next;
+      HeapFreeMem(pc, Notes);
+      Notes = Next;
+   }
+}
+
+// Compile the arguments of a call into consecutive temporaries, after the open bracket and up to and including the close bracket.
+// Return the first of them.
+static int CompileArguments(Compiler Comp, struct FuncDef *Func, int NumArgs, ValueType *ArgType) {
+   State pc = Comp->pc;
+   int Args = NumArgs == 0? 0: TempSlot|Comp->NumTempIds;
+   for (int A = 0; A < NumArgs; A++)
+      Temp(Comp);
+   for (int A = 0; A < NumArgs; A++) {
+      if (A > 0)
+         Expect(Comp, CommaL);
+      Operand X = CompileAssignment(Comp);
+      ValueType Typ = A < Func->NumParams? Func->ParamType[A]: X.Typ;
+      if (Typ == pc->CharPtrType) {
+      // Only a string literal can be passed as a string.
+         if (X.Kind != ConstK || X.Typ != pc->CharPtrType)
+            Decline(Comp);
+         Place(Comp, &X, Args + A);
+      } else
+         Convert(Comp, Typ, &X, Args + A);
+      ArgType[A] = Typ;
+   }
+   Expect(Comp, RParL);
+   return Args;
+}
+
+// Compile a call of a defined function in place, after its close bracket, with its arguments in the consecutive temporaries from Args on:
+// these are its parameters, while its variables get slots of their own, and each of its returns sets its result and jumps to its end.
+// Set X to its result and return true; or, if it can't be, return false, having compiled nothing, with the Note on it saying so.
+static bool CompileInline(Compiler Comp, Value FuncValue, int Args, CodeInlining Note, Operand *X) {
+   State pc = Comp->pc;
+   struct FuncDef *Func = &FuncValue->Val->FuncDef;
+   struct ParseState Parser;
+   ParserCopy(&Parser, &Comp->Parser);
+   int NumOps = Comp->NumOps, NumVars = Comp->NumVars, NumLocals = Comp->NumLocals, Scope = Comp->Scope;
+   int NumTemps = Comp->NumTemps, TempBase = Comp->TempBase, MacroDepth = Comp->MacroDepth;
+   CodeExit Exit = Comp->Exit;
+   CodeInline Outer = Comp->Inline;
+   CodeSite Sites = Comp->Sites;
+   jmp_buf Fail;
+   memcpy(Fail, Comp->Fail, sizeof Fail);
+   if (setjmp(Comp->Fail)) {
+      memcpy(Comp->Fail, Fail, sizeof Fail);
+      ParserCopy(&Comp->Parser, &Parser);
+      Comp->NumOps = NumOps, Comp->NumVars = NumVars, Comp->NumLocals = NumLocals, Comp->Scope = Scope;
+      Comp->NumTemps = NumTemps, Comp->TempBase = TempBase, Comp->MacroDepth = MacroDepth;
+      Comp->Exit = Exit, Comp->Inline = Outer;
+      while (Comp->Sites != Sites) {
+         CodeSite Next = Comp->Sites->Next;
+         HeapFreeMem(pc, Comp->Sites);
+         Comp->Sites = Next;
+      }
+      FreeInlinings(pc, Note->Next), Note->Next = NULL;
+      Note->Reason = "it can't be compiled in place";
+      return false;
+   }
+   struct CodeInline Inline = { Outer, FuncValue, Func->ReturnType == &pc->VoidType? NoSlot: Temp(Comp), NoJump };
+   Comp->Inline = &Inline, Comp->Exit = NULL;
+// Only its own parameters and variables are in scope in it, and its statements leave the temporaries of the call alone.
+   Comp->Scope = Comp->NumLocals;
+   for (int P = 0; P < Func->NumParams; P++) {
+      if (Comp->NumLocals == CodeLocalMax)
+         Decline(Comp);
+      CodeLocal Local = &Comp->Local[Comp->NumLocals++];
+      Local->Ident = Func->ParamName[P], Local->Typ = Func->ParamType[P], Local->Slot = Args + P;
+   }
+   Comp->TempBase = Comp->NumTemps;
+   ParserCopy(&Comp->Parser, &Func->Body);
+   Comp->Parser.Mode = SkipM;
+   Expect(Comp, LCurlL);
+   CompileBlock(Comp);
+// A return at the very end needs no jump; but if it can run off the end, it fails there, as a call would.
+   if (Inline.Returns != NoJump && Inline.Returns == Comp->NumOps - 1 && !Targeted(Comp, Comp->NumOps))
+      Inline.Returns = Comp->Ops[--Comp->NumOps].K.Integer;
+   else if (Func->ReturnType != &pc->VoidType)
+      Emit(Comp, FailC, 0, 0, 0)->K.Pointer = NewSite(Comp, FuncValue, NULL, 0);
+   Patch(Comp, Inline.Returns, Comp->NumOps);
+   memcpy(Comp->Fail, Fail, sizeof Fail);
+   ParserCopy(&Comp->Parser, &Parser);
+   Comp->NumLocals = NumLocals, Comp->Scope = Scope;
+   Comp->NumTemps = Comp->TempBase, Comp->TempBase = TempBase;
+   Comp->Exit = Exit, Comp->Inline = Outer;
+   if (Inline.Result == NoSlot) {
+      Operand Void = { VoidK, &pc->VoidType, false, NoSlot };
+      *X = Void;
+   } else
+      *X = InSlot(Func->ReturnType, Inline.Result, false);
+   return true;
+}
+
+// Compile a call to Ident, after its name.
+// A call of a small defined function is compiled in place, instead of a call to it.
+static Operand CompileFunctionCall(Compiler Comp, const char *Ident) {
+   State pc = Comp->pc;
+   Value FuncValue;
+   struct FuncDef *Func = CallableFunction(Comp, Ident, &FuncValue);
+   const char *FileName = Comp->Parser.FileName;
+   int Line = Comp->Parser.Line;
+   Expect(Comp, LParL);
+   int NumArgs = CountArguments(Comp);
+   if (NumArgs < Func->NumParams || (NumArgs > Func->NumParams && !Func->VarArgs) || NumArgs > ParameterMax)
+      Decline(Comp);
+   ValueType ArgType[ParameterMax];
+   int Args = CompileArguments(Comp, Func, NumArgs, ArgType);
+   if (Func->Intrinsic == NULL) {
+      CodeInlining Note = NewInlining(Comp, FileName, Line, Ident, Uninlinable(Comp, FuncValue));
+      Operand X;
+      if (Note->Reason == NULL && CompileInline(Comp, FuncValue, Args, Note, &X))
+         return X;
+   }
+   CodeSite Site = NewSite(Comp, FuncValue, Ident, NumArgs);
+   memcpy(Site->ArgType, ArgType, NumArgs*sizeof ArgType[0]);
+   if (Func->ReturnType == &pc->VoidType) {
+      Emit(Comp, CallC, NoSlot, Args, NumArgs)->K.Pointer = Site;
+      Operand X = { VoidK, &pc->VoidType, false, NoSlot };
+      return X;
+   }
+   int T = Temp(Comp);
+   Emit(Comp, CallC, T, Args, NumArgs)->K.Pointer = Site;
+   return InSlot(Func->ReturnType, T, false);
+}
+
+// Compile a macro without parameters, in place, as the interpreter evaluates it.
+static Operand CompileMacro(Compiler Comp, MacroDef MDef) {
+   if (MDef->NumParams != 0 || Comp->MacroDepth == MacroDepthMax)
+      Decline(Comp);
+   struct ParseState Outer;
+   ParserCopy(&Outer, &Comp->Parser);
+   ParserCopy(&Comp->Parser, &MDef->Body);
+   Comp->Parser.Mode = SkipM;
+   Comp->MacroDepth++;
+   Operand X = CompileAssignment(Comp);
+   if (Peek(Comp, NULL) != EndFnL)
+      Decline(Comp);
+   Comp->MacroDepth--;
+   ParserCopy(&Comp->Parser, &Outer);
+   return X;
+}
+
+// Compile a reference to an identifier, after it.
+static Operand CompileIdentifier(Compiler Comp, const char *Ident) {
+   State pc = Comp->pc;
+   if (Peek(Comp, NULL) == LParL)
+      return CompileFunctionCall(Comp, Ident);
+   CodeLocal Local = FindLocal(Comp, Ident);
+   if (Local != NULL)
+      return InSlot(Local->Typ, Local->Slot, true);
+   Value Val = TableGet(&pc->GlobalTable, Ident, NULL, NULL, NULL);
+   if (Val == NULL)
+      Decline(Comp);
+   if (Val->Typ->Base == MacroT)
+      return CompileMacro(Comp, &Val->Val->MacroDef);
+   Operand X = { MemK, Val->Typ, Val->IsLValue, NoSlot };
+   if (Val->Typ->Base == ArrayT && IsScalar(pc, Val->Typ->FromType))
+      X.K.Pointer = Val->Val->ArrayMem;
+   else if (IsScalar(pc, Val->Typ))
+      X.K.Pointer = Val->Val;
+   else
+      Decline(Comp);
+   return X;
+}
+
+// Compile a primary expression: a literal, a bracketed expression, a variable, a macro or a call.
+static Operand CompilePrimary(Compiler Comp) {
+   State pc = Comp->pc;
+   Value LexValue;
+   Lexical Token = Next(Comp, &LexValue);
+   switch (Token) {
+      case IntLitL: case CharLitL:
+         if (!IsIntType(LexValue->Typ))
+            Decline(Comp);
+         return IntConst(LexValue->Typ, ExpressionCoerceInteger(LexValue));
+#ifndef NO_FP
+      case RatLitL: return RatConst(pc, LexValue->Val->FP);
+#endif
+      case StrLitL: {
+         Operand X = { ConstK, pc->CharPtrType, false, NoSlot };
+         X.K.Pointer = LexValue->Val->Pointer;
+         return X;
+      }
+      case LParL: {
+         Operand X = CompileAssignment(Comp);
+         Expect(Comp, RParL);
+         return X;
+      }
+      case IdL: return CompileIdentifier(Comp, LexValue->Val->Identifier);
+      default: Decline(Comp); return IntConst(&pc->IntType, 0);
+   }
+}
+
+// Compile an array index, after the open bracket: the index is read now, as the interpreter reads it at the close bracket.
+static Operand CompileIndex(Compiler Comp, Operand *X) {
+   State pc = Comp->pc;
+   if (X->Kind != MemK || X->Typ->Base != ArrayT || X->Slot != NoSlot)
+      Decline(Comp);
+   Operand I = CompileAssignment(Comp);
+   Expect(Comp, RBrL);
+   if (!IsScalar(pc, I.Typ))
+      Decline(Comp);
+   ValueType Typ = X->Typ->FromType;
+   Operand Elem = { MemK, Typ, X->IsLValue, NoSlot, X->K };
+   if (I.Kind == ConstK) {
+#ifndef NO_FP
+      int Index = IsRat(I.Typ)? (int)(long)I.K.FP: (int)I.K.Integer;
+#else
+      int Index = (int)I.K.Integer;
+#endif
+      Elem.K.Pointer = (char *)X->K.Pointer + (long)Index*Typ->Sizeof;
+   } else if (IsRat(I.Typ)) {
+      Elem.Slot = Temp(Comp);
+      Emit(Comp, FixC, Elem.Slot, Use(Comp, &I), 0);
+   } else if (I.Kind == SlotK && !I.IsLValue)
+      Elem.Slot = I.Slot;
+   else {
+      Elem.Slot = Temp(Comp);
+      Place(Comp, &I, Elem.Slot);
+   }
+   return Elem;
+}
+
+// Compile a primary expression with any postfix operators.
+static Operand CompilePostfix(Compiler Comp) {
+   Operand X = CompilePrimary(Comp);
+   while (true) {
+      Lexical Token = Peek(Comp, NULL);
+      switch (Token) {
+         case LBrL: Next(Comp, NULL), X = CompileIndex(Comp, &X); break;
+         case IncOpL: case DecOpL: Next(Comp, NULL), X = IncDec(Comp, Token, &X, false); break;
+         case DotL: case ArrowL: Decline(Comp); break;
+         default: return X;
+      }
+   }
+}
+
+// Compile an expression with any prefix operators or casts.
+static Operand CompileUnary(Compiler Comp) {
+   Value LexValue;
+   Lexical Token = Peek(Comp, &LexValue);
+   switch (Token) {
+      case SubL: case AddL: case NotL: case CplL: {
+         Next(Comp, NULL);
+         Operand X = CompileUnary(Comp);
+         return Prefix(Comp, Token, &X);
+      }
+      case IncOpL: case DecOpL: {
+         Next(Comp, NULL);
+         Operand X = CompileUnary(Comp);
+         return IncDec(Comp, Token, &X, true);
+      }
+      case StarL: case AndL: case SizeOfL: Decline(Comp); break;
+      case LParL: {
+      // Is it a cast?
+         struct ParseCursor Before;
+         ParserCopyPos(&Before, &Comp->Parser);
+         Next(Comp, NULL);
+         Token = Peek(Comp, &LexValue);
+         if (Token == IdL && IsTypedef(Comp, LexValue->Val->Identifier))
+            Decline(Comp);
+         if (Token >= IntL && Token <= UnsignedL) {
+            ValueType Typ = CompileType(Comp);
+            Expect(Comp, RParL);
+            Operand X = CompileUnary(Comp);
+            return Cast(Comp, Typ, &X);
+         }
+         ParserCopyPos(&Comp->Parser, &Before);
+      }
+      break;
+      default: break;
+   }
+   return CompilePostfix(Comp);
+}
+
+// How tightly an infix operator from || up to * / % binds, as in the interpreter's table; or 0 if it's not one of them.
+static int InfixLevel(Lexical Token) {
+   switch (Token) {
+      case OrOrL: return 4;
+      case AndAndL: return 5;
+      case OrL: return 6;
+      case XOrL: return 7;
+      case AndL: return 8;
+      case RelEqL: case RelNeL: return 9;
+      case RelLtL: case RelGtL: case RelLeL: case RelGeL: return 10;
+      case ShLL: case ShRL: return 11;
+      case AddL: case SubL: return 12;
+      case StarL: case DivL: case ModL: return 13;
+      default: return 0;
+   }
+}
+
+static Operand CompileInfix(Compiler Comp, int Level);
+
+// Compile the right hand side of && or ||, and the operator, after it.
+// The interpreter decides whether to skip the right hand side by reading the left, and then, if it's not skipped, reads the left again.
+static Operand CompileLogical(Compiler Comp, Lexical Op, Operand *X, int Level) {
+   State pc = Comp->pc;
+   if (!IsIntType(X->Typ))
+      Decline(Comp);
+   int T = Temp(Comp), Skip = NoJump, End = NoJump;
+   Branch(Comp, X, Op == OrOrL, &Skip);
+   Operand Y = CompileInfix(Comp, Level + 1);
+   if (!IsIntType(Y.Typ))
+      Decline(Comp);
+   int C = Use(Comp, &Y), NotY = Temp(Comp);
+   Emit(Comp, NotC, NotY, C, 0);
+   if (X->IsLValue) {
+      int B = Use(Comp, X), NotB = Temp(Comp), Either = Temp(Comp);
+      Emit(Comp, NotC, NotB, B, 0);
+      Emit(Comp, Op == OrOrL? AndC: OrC, Either, NotB, NotY)->Base = LongIntT;
+      Emit(Comp, NotC, T, Either, 0);
+   } else
+      Emit(Comp, NotC, T, NotY, 0);
+   EmitJump(Comp, JmpC, 0, &End);
+   Patch(Comp, Skip, Comp->NumOps);
+   Emit(Comp, MovKC, T, 0, 0)->K.Integer = Op == OrOrL;
+   Patch(Comp, End, Comp->NumOps);
+   return InSlot(&pc->IntType, T, false);
+}
+
+// Compile the infix operators that bind at least as tightly as Level, left to right.
+static Operand CompileInfix(Compiler Comp, int Level) {
+   Operand X = CompileUnary(Comp);
+   while (true) {
+      Lexical Op = Peek(Comp, NULL);
+      int OpLevel = InfixLevel(Op);
+      if (OpLevel == 0 || OpLevel < Level)
+         return X;
+      Next(Comp, NULL);
+      if (Op == OrOrL || Op == AndAndL)
+         X = CompileLogical(Comp, Op, &X, OpLevel);
+      else {
+         Operand Y = CompileInfix(Comp, OpLevel + 1);
+         X = Infix(Comp, Op, &X, &Y);
+      }
+   }
+}
+
+// The type of x? y: z, which the interpreter takes from whichever of y and z it chose.
+// The compiler allows only pairs where this makes no difference to how the value's used.
+static ValueType TernaryType(Compiler Comp, ValueType Y, ValueType Z) {
+   State pc = Comp->pc;
+   if (!IsScalar(pc, Y) || !IsScalar(pc, Z))
+      Decline(Comp);
+   if (Y == Z)
+      return Y;
+   if (IsIntType(Y) && IsIntType(Z)) {
+      if (!IsUnsigned(Y->Base) && !IsUnsigned(Z->Base))
+         return &pc->LongType;
+      if (IsUnsigned(Y->Base) && IsUnsigned(Z->Base) && Y->Base != LongNatT && Z->Base != LongNatT)
+         return &pc->UnsignedIntType;
+   }
+   Decline(Comp);
+   return NULL;
+}
+
+// Compile x? y: z, which the interpreter treats as left associative.
+// The condition is read once to decide whether to evaluate y and, if it was, again to decide whether to evaluate z.
+static Operand CompileTernary(Compiler Comp) {
+   Operand X = CompileInfix(Comp, 4);
+   while (Peek(Comp, NULL) == QuestL) {
+      Next(Comp, NULL);
+      int Else = NoJump, End = NoJump, R = Temp(Comp);
+      Branch(Comp, &X, false, &Else);
+      Operand Y = CompileInfix(Comp, 4);
+      Expect(Comp, ColonL);
+      if (!IsScalar(Comp->pc, Y.Typ))
+         Decline(Comp);
+      Place(Comp, &Y, R);
+      if (X.IsLValue)
+         Branch(Comp, &X, false, &Else);
+      EmitJump(Comp, JmpC, 0, &End);
+      Patch(Comp, Else, Comp->NumOps);
+      Operand Z = CompileInfix(Comp, 4);
+      if (!IsScalar(Comp->pc, Z.Typ))
+         Decline(Comp);
+      Place(Comp, &Z, R);
+      Patch(Comp, End, Comp->NumOps);
+      X = InSlot(TernaryType(Comp, Y.Typ, Z.Typ), R, false);
+   }
+   return X;
+}
+
+// Compile an expression, with assignments, which are right associative.
+static Operand CompileAssignment(Compiler Comp) {
+   Operand X = CompileTernary(Comp);
+   Lexical Op = Peek(Comp, NULL);
+   if (Op < EquL || Op > XOrEquL)
+      return X;
+   Next(Comp, NULL);
+   Operand Y = CompileAssignment(Comp);
+   return Assign(Comp, Op, &X, &Y);
+}
+
+// Compile a block, after its open brace.
+static void CompileBlock(Compiler Comp) {
+   int NumLocals = Comp->NumLocals;
+   while (Peek(Comp, NULL) != RCurlL)
+      CompileStatement(Comp, true);
+   Next(Comp, NULL);
+   Comp->NumLocals = NumLocals;
+}
+
+// Compile a declaration of scalar local variables.
+// Each gets a slot of its own; and, as in the interpreter, a variable is defined before its initializer's evaluated.
+static void CompileDeclaration(Compiler Comp) {
+   ValueType Typ = CompileType(Comp);
+   Lexical Token;
+   do {
+      Value LexValue;
+      if (Next(Comp, &LexValue) != IdL)
+         Decline(Comp);
+      const char *Ident = LexValue->Val->Identifier;
+      if (FindLocal(Comp, Ident) != NULL || Comp->NumLocals == CodeLocalMax)
+         Decline(Comp);
+      Token = Peek(Comp, NULL);
+      if (Token == LParL || Token == LBrL)
+         Decline(Comp);
+      CodeLocal Local = &Comp->Local[Comp->NumLocals++];
+      Local->Ident = Ident, Local->Typ = Typ, Local->Slot = Variable(Comp);
+      if (Token == EquL) {
+         Next(Comp, NULL);
+         if (Peek(Comp, NULL) == LCurlL)
+            Decline(Comp);
+         Operand X = CompileAssignment(Comp);
+         Convert(Comp, Typ, &X, Local->Slot);
+      } else if (Comp->Inline != NULL) {
+      // Cleared on each inlined call, as it would be in a new frame.
+         Operand Zero = IntConst(&Comp->pc->IntType, 0);
+         Convert(Comp, Typ, &Zero, Local->Slot);
+      }
+      Token = Next(Comp, NULL);
+   } while (Token == CommaL);
+   if (Token != SemiL)
+      Decline(Comp);
+}
+
+// Compile the condition of an if or a loop, with its brackets, as ExpressionParseInt() evaluates it.
+static Operand CompileCondition(Compiler Comp) {
+   Expect(Comp, LParL);
+   Operand X = CompileAssignment(Comp);
+   Expect(Comp, RParL);
+   if (!IsScalar(Comp->pc, X.Typ))
+      Decline(Comp);
+   return X;
+}
+
+// Start and end a loop or a switch.
+static void EnterExit(Compiler Comp, CodeExit Exit, bool IsSwitch) {
+   Exit->Outer = Comp->Exit, Exit->IsSwitch = IsSwitch, Exit->Breaks = Exit->Continues = NoJump;
+   Comp->Exit = Exit;
+}
+
+static void LeaveExit(Compiler Comp, CodeExit Exit) {
+   Patch(Comp, Exit->Breaks, Comp->NumOps);
+   Comp->Exit = Exit->Outer;
+}
+
+// Compile a while loop, after the while.
+// The condition's compiled twice: once before the loop and once at the bottom, so each iteration takes one branch.
+static void CompileWhile(Compiler Comp) {
+   struct CodeExit Exit;
+   EnterExit(Comp, &Exit, false);
+   struct ParseCursor PreCondition;
+   ParserCopyPos(&PreCondition, &Comp->Parser);
+   Operand X = CompileCondition(Comp);
+   Branch(Comp, &X, false, &Exit.Breaks);
+   int Top = Comp->NumOps;
+   CompileStatement(Comp, false);
+   Patch(Comp, Exit.Continues, Comp->NumOps);
+   CodeEntry Entry = NewEntry(Comp, PreCondition.Pos, PreCondition.Line, Top, Comp->NumOps);
+   struct ParseCursor After;
+   ParserCopyPos(&After, &Comp->Parser);
+   ParserCopyPos(&Comp->Parser, &PreCondition);
+   Comp->NumTemps = Comp->TempBase;
+   X = CompileCondition(Comp);
+   int Loop = NoJump;
+   Branch(Comp, &X, true, &Loop);
+   Patch(Comp, Loop, Top);
+   Entry->End = Comp->NumOps;
+   ParserCopyPos(&Comp->Parser, &After);
+   LeaveExit(Comp, &Exit);
+}
+
+// Compile a do loop, after the do.
+static void CompileDo(Compiler Comp) {
+   struct CodeExit Exit;
+   EnterExit(Comp, &Exit, false);
+   int Top = Comp->NumOps;
+   CodeEntry Entry = NewEntry(Comp, Comp->Parser.Pos, Comp->Parser.Line, Top, Top);
+   CompileStatement(Comp, false);
+   Patch(Comp, Exit.Continues, Comp->NumOps);
+   Expect(Comp, WhileL);
+   Comp->NumTemps = Comp->TempBase;
+   Operand X = CompileCondition(Comp);
+   int Loop = NoJump;
+   Branch(Comp, &X, true, &Loop);
+   Patch(Comp, Loop, Top);
+   Entry->End = Comp->NumOps;
+   Expect(Comp, SemiL);
+   LeaveExit(Comp, &Exit);
+}
+
+// Compile the condition of a for loop, up to and including its semicolon, jumping to the chain if it's IfTrue.
+static void CompileForCondition(Compiler Comp, bool IfTrue, int *Chain) {
+   Comp->NumTemps = Comp->TempBase;
+   if (Peek(Comp, NULL) == SemiL) {
+      if (IfTrue)
+         EmitJump(Comp, JmpC, 0, Chain);
+   } else {
+      Operand X = CompileAssignment(Comp);
+      if (!IsScalar(Comp->pc, X.Typ))
+         Decline(Comp);
+      Branch(Comp, &X, IfTrue, Chain);
+   }
+   Expect(Comp, SemiL);
+}
+
+// Compile a for loop, after the for.
+// Like a while loop, its condition is compiled before the loop and at the bottom, after the increment.
+static void CompileFor(Compiler Comp) {
+   int NumLocals = Comp->NumLocals;
+   Expect(Comp, LParL);
+   CompileStatement(Comp, true);
+   struct CodeExit Exit;
+   EnterExit(Comp, &Exit, false);
+   struct ParseCursor PreCondition;
+   ParserCopyPos(&PreCondition, &Comp->Parser);
+   CompileForCondition(Comp, false, &Exit.Breaks);
+// Skip the increment for now.
+   struct ParseCursor PreIncrement;
+   ParserCopyPos(&PreIncrement, &Comp->Parser);
+   for (int Depth = 0; ; ) {
+      Lexical Token = Next(Comp, NULL);
+      if (Token == LParL || Token == LBrL)
+         Depth++;
+      else if (Token == RBrL || (Token == RParL && Depth > 0))
+         Depth--;
+      else if (Token == RParL)
+         break;
+      else if (Token == EofL || Token == EndFnL)
+         Decline(Comp);
+   }
+   int Top = Comp->NumOps;
+   CompileStatement(Comp, false);
+   struct ParseCursor After;
+   ParserCopyPos(&After, &Comp->Parser);
+   Patch(Comp, Exit.Continues, Comp->NumOps);
+   CodeEntry Entry = NewEntry(Comp, PreCondition.Pos, PreCondition.Line, Top, Comp->NumOps);
+   ParserCopyPos(&Comp->Parser, &PreIncrement);
+   Comp->NumTemps = Comp->TempBase;
+   if (Peek(Comp, NULL) != RParL)
+      CompileAssignment(Comp);
+   Expect(Comp, RParL);
+   ParserCopyPos(&Comp->Parser, &PreCondition);
+   int Loop = NoJump;
+   CompileForCondition(Comp, true, &Loop);
+   Patch(Comp, Loop, Top);
+   Entry->End = Comp->NumOps;
+   ParserCopyPos(&Comp->Parser, &After);
+   LeaveExit(Comp, &Exit);
+   Comp->NumLocals = NumLocals;
+}
+
+// Compile a switch statement, after the switch.
+// The body's compiled first, noting its case labels, then the search for the label, which is made in the order the labels are written.
+static void CompileSwitch(Compiler Comp) {
+   State pc = Comp->pc;
+   struct CaseLabel { bool IsDefault; long Label; int Target; } Labels[CodeLocalMax];
+   int NumLabels = 0;
+   Operand X = CompileCondition(Comp);
+   int Selector = Variable(Comp), Search = NoJump;
+   Convert(Comp, &pc->IntType, &X, Selector);
+   EmitJump(Comp, JmpC, 0, &Search);
+   Expect(Comp, LCurlL);
+   struct CodeExit Exit;
+   EnterExit(Comp, &Exit, true);
+   int NumLocals = Comp->NumLocals;
+   while (true) {
+      Lexical Token = Peek(Comp, NULL);
+      if (Token == RCurlL)
+         break;
+      if (Token == CaseL || Token == DefaultL) {
+         if (NumLabels == CodeLocalMax)
+            Decline(Comp);
+         struct CaseLabel *Label = &Labels[NumLabels++];
+         Next(Comp, NULL);
+         Label->IsDefault = Token == DefaultL, Label->Target = Comp->NumOps;
+         if (Token == CaseL) {
+         // Only constant labels: the interpreter evaluates them as it searches.
+            Comp->NumTemps = Comp->TempBase;
+            int NumOps = Comp->NumOps;
+            Operand L = CompileTernary(Comp);
+            if (L.Kind == MemK && !L.IsLValue && L.Slot == NoSlot && IsIntType(L.Typ)) {
+            // A constant global, such as an enum value.
+               struct Value Val = { L.Typ, L.K.Pointer };
+               L = IntConst(L.Typ, ExpressionCoerceInteger(&Val));
+            }
+            if (L.Kind != ConstK || !IsIntType(L.Typ) || Comp->NumOps != NumOps)
+               Decline(Comp);
+            Label->Label = (int)L.K.Integer;
+         }
+         Expect(Comp, ColonL);
+      } else
+         CompileStatement(Comp, false);
+   }
+   Next(Comp, NULL);
+   Comp->NumLocals = NumLocals;
+   EmitJump(Comp, JmpC, 0, &Exit.Breaks);
+// Search for the label.
+   Patch(Comp, Search, Comp->NumOps);
+   Comp->NumTemps = Comp->TempBase;
+   bool HasDefault = false;
+   for (int L = 0; L < NumLabels && !HasDefault; L++) {
+      if (Labels[L].IsDefault) {
+         Emit(Comp, JmpC, 0, 0, 0)->K.Integer = Labels[L].Target;
+         HasDefault = true;
+      } else {
+         int K = Temp(Comp), T = Temp(Comp);
+         Emit(Comp, MovKC, K, 0, 0)->K.Integer = Labels[L].Label;
+         Emit(Comp, EqC, T, Selector, K);
+         Emit(Comp, JnzC, T, 0, 0)->K.Integer = Labels[L].Target;
+      }
+   }
+   if (!HasDefault)
+      EmitJump(Comp, JmpC, 0, &Exit.Breaks);
+   LeaveExit(Comp, &Exit);
+}
+
+#ifdef TAIL_CALLS
+// Compile "return f(...);" as a tail call, the way ExpressionParseTailCall() makes one, after the return.
+// A call to the function itself reuses its slots and jumps back to its start.
+// Return false if it's not a tail call, compiling nothing.
+static bool CompileReturnCall(Compiler Comp) {
+   State pc = Comp->pc;
+   struct ParseState Scan;
+   ParserCopy(&Scan, &Comp->Parser);
+   Value LexValue;
+   if (LexGetToken(&Scan, &LexValue, true) != IdL)
+      return false;
+   const char *Ident = LexValue->Val->Identifier;
+   if (LexGetToken(&Scan, NULL, true) != LParL)
+      return false;
+   if (FindLocal(Comp, Ident) != NULL)
+      return false;
+   Value FuncValue = TableGet(&pc->GlobalTable, Ident, NULL, NULL, NULL);
+   if (FuncValue == NULL || FuncValue->Typ != &pc->FunctionType)
+      return false;
+   struct FuncDef *Func = &FuncValue->Val->FuncDef;
+   if (Func->Intrinsic != NULL || Func->VarArgs || Func->ReturnType != Comp->Func->ReturnType)
+      return false;
+// A function that can be inlined is, instead.
+   if (!CallEndsStatement(&Scan) || Uninlinable(Comp, FuncValue) == NULL)
+      return false;
+// It's a tail call.
+   CallableFunction(Comp, Ident, &FuncValue);
+   Next(Comp, NULL), Next(Comp, NULL);
+   int NumArgs = CountArguments(Comp);
+   if (NumArgs != Func->NumParams)
+      Decline(Comp);
+   ValueType ArgType[ParameterMax];
+   int Args = CompileArguments(Comp, Func, NumArgs, ArgType);
+   if (FuncValue == Comp->FuncValue) {
+      for (int A = 0; A < NumArgs; A++)
+         Emit(Comp, MovC, 1 + A, Args + A, 0);
+      Emit(Comp, JmpC, 0, 0, 0)->K.Integer = Comp->Entry;
+   } else {
+      CodeSite Site = NewSite(Comp, FuncValue, Ident, NumArgs);
+      memcpy(Site->ArgType, ArgType, NumArgs*sizeof ArgType[0]);
+      Emit(Comp, TailCallC, 0, Args, NumArgs)->K.Pointer = Site;
+      Emit(Comp, RetC, 0, 0, 0);
+   }
+   return true;
+}
+#endif
+
+// Compile a return statement, after the return.
+static void CompileReturn(Compiler Comp) {
+   State pc = Comp->pc;
+   if (Comp->Inline != NULL) {
+   // In an inlined call: the result goes to its slot, and the return is a jump to the end.
+      ValueType Typ = Comp->Inline->FuncValue->Val->FuncDef.ReturnType;
+      if (Typ != &pc->VoidType) {
+         Operand X = CompileAssignment(Comp);
+         Convert(Comp, Typ, &X, Comp->Inline->Result);
+      } else if (Peek(Comp, NULL) != SemiL)
+         Decline(Comp);
+      EmitJump(Comp, JmpC, 0, &Comp->Inline->Returns);
+      Expect(Comp, SemiL);
+      return;
+   }
+#ifdef TAIL_CALLS
+   if (CompileReturnCall(Comp))
+      ;
+   else
+#endif
+   if (Comp->Func->ReturnType != &pc->VoidType) {
+      Operand X = CompileAssignment(Comp);
+      Convert(Comp, Comp->Func->ReturnType, &X, 0);
+      Emit(Comp, RetC, 0, 0, 0);
+   } else {
+      if (Peek(Comp, NULL) != SemiL)
+         Decline(Comp);
+      Emit(Comp, RetC, 0, 0, 0);
+   }
+   Expect(Comp, SemiL);
+}
+
+// Compile a statement.
+// Temporaries are freed at the start of each, since no value lasts from one statement to the next.
+static void CompileStatement(Compiler Comp, bool AllowDeclaration) {
+   Comp->NumTemps = Comp->TempBase;
+   Value LexValue;
+   Lexical Token = Peek(Comp, &LexValue);
+   switch (Token) {
+      case SemiL: Next(Comp, NULL); break;
+      case LCurlL: Next(Comp, NULL), CompileBlock(Comp); break;
+      case IfL: {
+         Next(Comp, NULL);
+         Operand X = CompileCondition(Comp);
+         int Else = NoJump;
+         Branch(Comp, &X, false, &Else);
+         CompileStatement(Comp, false);
+         if (Peek(Comp, NULL) == ElseL) {
+            Next(Comp, NULL);
+            int End = NoJump;
+            EmitJump(Comp, JmpC, 0, &End);
+            Patch(Comp, Else, Comp->NumOps);
+            CompileStatement(Comp, false);
+            Patch(Comp, End, Comp->NumOps);
+         } else
+            Patch(Comp, Else, Comp->NumOps);
+      }
+      break;
+      case WhileL: Next(Comp, NULL), CompileWhile(Comp); break;
+      case DoL: Next(Comp, NULL), CompileDo(Comp); break;
+      case ForL: Next(Comp, NULL), CompileFor(Comp); break;
+      case SwitchL: Next(Comp, NULL), CompileSwitch(Comp); break;
+      case BreakL:
+         Next(Comp, NULL);
+         if (Comp->Exit == NULL)
+            Decline(Comp);
+         EmitJump(Comp, JmpC, 0, &Comp->Exit->Breaks);
+         Expect(Comp, SemiL);
+      break;
+      case ContinueL:
+      // The interpreter treats a continue in a switch like a break.
+         Next(Comp, NULL);
+         if (Comp->Exit == NULL || Comp->Exit->IsSwitch)
+            Decline(Comp);
+         EmitJump(Comp, JmpC, 0, &Comp->Exit->Continues);
+         Expect(Comp, SemiL);
+      break;
+      case ReturnL: Next(Comp, NULL), CompileReturn(Comp); break;
+      case IntL: case ShortL: case CharL: case LongL: case FloatL: case DoubleL:
+      case SignedL: case UnsignedL: case AutoL: case RegisterL:
+         if (!AllowDeclaration)
+            Decline(Comp);
+         CompileDeclaration(Comp);
+      break;
+      case IdL:
+      // Not a typedef or a goto label.
+         if (IsTypedef(Comp, LexValue->Val->Identifier) || PeekSecond(Comp) == ColonL)
+            Decline(Comp);
+      // Fall through.
+      case IncOpL: case DecOpL: case LParL:
+         CompileAssignment(Comp);
+         Expect(Comp, SemiL);
+      break;
+      default: Decline(Comp); break;
+   }
+}
+
+// Count the reads and writes of each temporary.
+static void CountUses(Compiler Comp, int *ReadCount, int *WriteCount) {
+   memset(ReadCount, '\0', Comp->NumTempIds*sizeof *ReadCount);
+   memset(WriteCount, '\0', Comp->NumTempIds*sizeof *WriteCount);
+   for (CodeOp Op = Comp->Ops; Op < Comp->Ops + Comp->NumOps; Op++) {
+      int Form = OpForm[Op->Code];
+      if ((Form&ReadA) && (Op->A&TempSlot))
+         ReadCount[Op->A&~TempSlot]++;
+      if ((Form&ReadB) && (Op->B&TempSlot))
+         ReadCount[Op->B&~TempSlot]++;
+      if ((Form&ReadC) && (Op->C&TempSlot))
+         ReadCount[Op->C&~TempSlot]++;
+      if ((Form&ReadArgs) && (Op->B&TempSlot)) {
+         for (int A = 0; A < Op->C; A++)
+            ReadCount[(Op->B&~TempSlot) + A]++;
+      }
+      if ((Form&WriteA) && Op->A != NoSlot && (Op->A&TempSlot))
+         WriteCount[Op->A&~TempSlot]++;
+   }
+}
+
+// Whether any operation from Top up to End writes Slot.
+static bool Written(Compiler Comp, int Top, int End, int Slot) {
+   for (CodeOp Op = &Comp->Ops[Top]; Op < &Comp->Ops[End]; Op++) {
+      if ((OpForm[Op->Code]&WriteA) && Op->A == Slot)
+         return true;
+      if (Op->Code == ClearC && Op->A <= Slot && Slot < Op->B)
+         return true;
+   }
+   return false;
+}
+
+// Whether Slot keeps its value all through the loop from Top up to End, given the temporaries already Moved out of it.
+static bool Invariant(Compiler Comp, int Top, int End, int Slot, const bool *Moved) {
+   return (Slot&TempSlot)? Moved[Slot&~TempSlot]: !Written(Comp, Top, End, Slot);
+}
+
+// Point every use of the temporary Temp at Slot.
+static void Rename(Compiler Comp, int Temp, int Slot) {
+   for (CodeOp Op = Comp->Ops; Op < Comp->Ops + Comp->NumOps; Op++) {
+      int Form = OpForm[Op->Code];
+      if ((Form&(ReadA|WriteA)) && Op->A == Temp)
+         Op->A = Slot;
+      if ((Form&ReadB) && Op->B == Temp)
+         Op->B = Slot;
+      if ((Form&ReadC) && Op->C == Temp)
+         Op->C = Slot;
+   }
+}
+
+// Move the operations in an innermost loop whose values don't change in it to just before it, each with a slot of its own for its result.
+// Moved marks the temporaries moved, and IsArg those passed as arguments, which stay together in their place.
+// A call carrying on in the loop from the interpreter skips what's before it, so it goes through a copy of the moved operations, added at the end.
+static void Hoist(Compiler Comp, CodeEntry Loop, bool *Moved, const bool *IsArg, const int *WriteCount) {
+   int Top = Loop->Top, End = Loop->End;
+// Loads can only be moved if nothing in the loop can store to memory.
+   bool Stores = false;
+   for (CodeOp Op = &Comp->Ops[Top]; Op < &Comp->Ops[End]; Op++)
+      Stores |= Op->Code == StoreC || Op->Code == StoreXC || Op->Code == CallC || Op->Code == TailCallC;
+// Only what can't fail is moved, since it may not have been done at all in the loop: not a load from an indexed address, nor a conversion of a double.
+   int NumMoved = 0;
+   for (bool Changed = true; Changed; ) {
+      Changed = false;
+      for (CodeOp Op = &Comp->Ops[Top]; Op < &Comp->Ops[End]; Op++) {
+         int Form = OpForm[Op->Code], T = Op->A&~TempSlot;
+         if (!(Form&Pure) || !(Op->A&TempSlot) || Moved[T] || IsArg[T] || WriteCount[T] != 1)
+            continue;
+         if (Op->Code == LoadXC || Op->Code == FixC || (Op->Code == LoadC && Stores))
+            continue;
+         if ((Form&ReadB) && !Invariant(Comp, Top, End, Op->B, Moved))
+            continue;
+         if ((Form&ReadC) && !Invariant(Comp, Top, End, Op->C, Moved))
+            continue;
+         Moved[T] = true, NumMoved++, Changed = true;
+      }
+   }
+#define IsMoved(Op) ((OpForm[(Op)->Code]&Pure) && ((Op)->A&TempSlot) && Moved[(Op)->A&~TempSlot])
+   CodeOp Ops = NULL;
+   int *NewIndex = NULL;
+   if (NumMoved > 0 && Comp->NumVars + NumMoved <= CodeLocalMax) {
+      Ops = HeapAllocMem(Comp->pc, (Comp->NumOps + 2*NumMoved + 1)*sizeof *Ops);
+      NewIndex = HeapAllocMem(Comp->pc, (Comp->NumOps + 1)*sizeof *NewIndex);
+   }
+   if (Ops == NULL || NewIndex == NULL) {
+      for (CodeOp Op = &Comp->Ops[Top]; Op < &Comp->Ops[End]; Op++) {
+         if (IsMoved(Op))
+            Moved[Op->A&~TempSlot] = false;
+      }
+      if (Ops != NULL)
+         HeapFreeMem(Comp->pc, Ops);
+      if (NewIndex != NULL)
+         HeapFreeMem(Comp->pc, NewIndex);
+      return;
+   }
+// Lay the code out again, with the moved operations before the loop, and their copy and a jump back into the loop after the end.
+   int N = 0;
+   for (int P = 0; P < Top; P++)
+      NewIndex[P] = N, Ops[N++] = Comp->Ops[P];
+   for (int P = Top; P < End; P++) {
+      if (IsMoved(&Comp->Ops[P]))
+         Ops[N++] = Comp->Ops[P];
+   }
+   for (int P = Top; P < End; P++) {
+      NewIndex[P] = N;
+      if (!IsMoved(&Comp->Ops[P]))
+         Ops[N++] = Comp->Ops[P];
+   }
+   for (int P = End; P < Comp->NumOps; P++)
+      NewIndex[P] = N, Ops[N++] = Comp->Ops[P];
+   NewIndex[Comp->NumOps] = N;
+   for (CodeOp Op = Ops; Op < Ops + N; Op++) {
+      if (OpForm[Op->Code]&IsJump)
+         Op->K.Integer = NewIndex[Op->K.Integer];
+   }
+   Comp->Entry = NewIndex[Comp->Entry];
+   for (CodeEntry Entry = Comp->Entries; Entry != NULL; Entry = Entry->Next)
+      Entry->Op = NewIndex[Entry->Op], Entry->Top = NewIndex[Entry->Top], Entry->End = NewIndex[Entry->End];
+   for (int P = Top; P < End; P++) {
+      if (IsMoved(&Comp->Ops[P]))
+         Ops[N++] = Comp->Ops[P];
+   }
+#undef IsMoved
+   memset(&Ops[N], '\0', sizeof Ops[N]);
+   Ops[N].Code = JmpC, Ops[N].K.Integer = Loop->Op, Loop->Op = N - NumMoved, N++;
+   HeapFreeMem(Comp->pc, Comp->Ops);
+   HeapFreeMem(Comp->pc, NewIndex);
+   Comp->Ops = Ops, Comp->NumOps = Comp->MaxOps = N;
+// Give each moved result a slot of its own, after the variables.
+   for (CodeOp Op = &Ops[Top]; Op < &Ops[Top + NumMoved]; Op++) {
+      int T = Op->A;
+      Moved[T&~TempSlot] = false;
+      Rename(Comp, T, 1 + Comp->Func->NumParams + Comp->NumVars++);
+   }
+   Loop->NumHoisted = NumMoved;
+}
+
+// Whether a jump, or a call carrying on from the interpreter, goes to operation N.
+static bool Targeted(Compiler Comp, int N) {
+   for (CodeOp Op = Comp->Ops; Op < Comp->Ops + Comp->NumOps; Op++) {
+      if ((OpForm[Op->Code]&IsJump) && Op->K.Integer == N)
+         return true;
+   }
+   for (CodeEntry Entry = Comp->Entries; Entry != NULL; Entry = Entry->Next) {
+      if (Entry->Op == N)
+         return true;
+   }
+   return N == Comp->Entry;
+}
+
+// Remove operation N, which nothing jumps to.
+static void Remove(Compiler Comp, int N) {
+   memmove(&Comp->Ops[N], &Comp->Ops[N + 1], (Comp->NumOps - N - 1)*sizeof *Comp->Ops);
+   Comp->NumOps--;
+   for (CodeOp Op = Comp->Ops; Op < Comp->Ops + Comp->NumOps; Op++) {
+      if ((OpForm[Op->Code]&IsJump) && Op->K.Integer > N)
+         Op->K.Integer--;
+   }
+   for (CodeEntry Entry = Comp->Entries; Entry != NULL; Entry = Entry->Next)
+      Entry->Op -= Entry->Op > N, Entry->Top -= Entry->Top > N, Entry->End -= Entry->End > N;
+   Comp->Entry -= Comp->Entry > N;
+}
+
+// Note whether a loop counts a variable up by one to a bound that doesn't change in it.
+// If its bound was worked out between the increment and the jump back before it was hoisted, those are now fused, as Tidy() fuses them.
+static void Count(Compiler Comp, CodeEntry Loop) {
+   if (Loop->End - Loop->Top < 2)
+      return;
+   CodeOp Back = &Comp->Ops[Loop->End - 1], Inc = Back - 1;
+   if (Back->Code == JLtC && Back->K.Integer == Loop->Top && Inc->Code == AddKC && Inc->A == Inc->B && Inc->K.Integer == 1 &&
+      !(Inc->A&TempSlot) && Back->B == Inc->A && !Targeted(Comp, Loop->End - 1)) {
+      Inc->Code = LoopC, Inc->C = Back->C, Inc->K = Back->K;
+      Remove(Comp, Loop->End - 1);
+      Back = Inc;
+   }
+   Loop->Counted = Back->Code == LoopC && Back->K.Integer == Loop->Top && !Written(Comp, Loop->Top, Loop->End, Back->C);
+}
+
+// The register of a kernel for Slot, which is Set in the loop, or else is filled from its slot before the loop's run.
+// Holds lists what each register holds. Return -1 if there's no room, or Slot is the count, or if it's Set, it's not a temporary, or else it's a temporary not set yet.
+static int KernelReg(CodeKernel Kernel, int *Holds, int *NumRegs, int Slot, bool Set) {
+   for (int R = 0; R < *NumRegs; R++) {
+      if (Holds[R] == Slot)
+         return R;
+   }
+   if (*NumRegs == KernelRegMax || Slot == Kernel->Index || ((Slot&TempSlot) != 0) != Set)
+      return -1;
+   if (!Set)
+      Kernel->Splat[Kernel->NumSplats].Reg = *NumRegs, Kernel->Splat[Kernel->NumSplats++].Slot = Slot;
+   Holds[*NumRegs] = Slot;
+   return (*NumRegs)++;
+}
+
+// Make the kernel of a counted loop that's element-wise, so that its iterations can be run in batches:
+// one with nothing in it but loads and stores of int or double array elements indexed by its count, and the arithmetic on them that can't fail.
+// Only its temporaries are set in it, each before it's read, and each element it stores is only read at the same count, in an array apart from the others,
+// so no iteration depends on another.
+static CodeKernel Vectorize(Compiler Comp, CodeEntry Loop) {
+   CodeOp Back = &Comp->Ops[Loop->End - 1];
+   int Index = Back->A, NumOps = Loop->End - 1 - Loop->Top;
+   if (Back->Base != IntT || (Back->C&TempSlot) || NumOps == 0)
+      return NULL;
+   CodeKernel Kernel = HeapAllocMem(Comp->pc, sizeof *Kernel + NumOps*sizeof Kernel->Ops[0]);
+   if (Kernel == NULL)
+      return NULL;
+   Kernel->Index = Index, Kernel->Bound = Back->C;
+// Holds is what each register holds; Counts are the temporaries holding a copy of the count.
+   int Holds[KernelRegMax], NumRegs = 0, Counts[KernelRegMax], NumCounts = 0;
+   enum { AnyK, IntK, RatK } Kind = AnyK;
+   bool Stores = false;
+   for (CodeOp Op = &Comp->Ops[Loop->Top]; Op < Back; Op++) {
+      int Form = OpForm[Op->Code], Want = AnyK;
+      bool Indexed = Op->Code == LoadXC || Op->Code == StoreXC;
+      switch (Op->Code) {
+         case MovC: case MovKC: break;
+         case LoadXC: case StoreXC:
+            if (Op->Base == IntT || Op->Base == NatT)
+               Want = IntK;
+#ifndef NO_FP
+            else if (Op->Base == RatT)
+               Want = RatK;
+#endif
+            else
+               goto Fail;
+            Stores |= Op->Code == StoreXC;
+         break;
+         case AddC: case SubC: case MulC: case AndC: case OrC: case XOrC: case AddKC: case NegC: case CplC: case ConvC:
+         // Only the low 32 bits of the results are stored, and the bits above don't carry into them.
+            if (Op->Base != IntT && Op->Base != NatT && Op->Base != LongIntT && Op->Base != LongNatT)
+               goto Fail;
+            Want = IntK;
+         break;
+#ifndef NO_FP
+         case FAddC: case FSubC: case FMulC: case FDivC: case FNegC: Want = RatK; break;
+#endif
+         default: goto Fail;
+      }
+      if (Want != AnyK && Kind != AnyK && Want != Kind)
+         goto Fail;
+      if (Want != AnyK)
+         Kind = Want;
+      bool FromCount = Op->B == Index;
+      for (int N = 0; N < NumCounts; N++)
+         FromCount |= Op->B == Counts[N];
+      if (Op->Code == MovC && FromCount) {
+         if (!(Op->A&TempSlot) || NumCounts == KernelRegMax)
+            goto Fail;
+         Counts[NumCounts++] = Op->A;
+         continue;
+      }
+      for (int N = 0; N < NumCounts; N++) {
+         if ((Form&WriteA) && Op->A == Counts[N])
+            goto Fail;
+      }
+      if (Indexed && !FromCount)
+         goto Fail;
+      int B = (Form&ReadB) && !Indexed? KernelReg(Kernel, Holds, &NumRegs, Op->B, false): 0;
+      int C = (Form&ReadC)? KernelReg(Kernel, Holds, &NumRegs, Op->C, false): 0;
+      int A = KernelReg(Kernel, Holds, &NumRegs, Op->A, !(Form&ReadA));
+      if (A < 0 || B < 0 || C < 0)
+         goto Fail;
+      CodeOp K = &Kernel->Ops[Kernel->NumOps++];
+      *K = *Op, K->A = A, K->B = B, K->C = C;
+   }
+   if (!Stores)
+      goto Fail;
+   Kernel->IsRat = Kind == RatK;
+   return Kernel;
+Fail:
+   HeapFreeMem(Comp->pc, Kernel);
+   return NULL;
+}
+
+// Put Op just before the body of a loop, where what comes into it goes through it, but not its jump back.
+// Return false if there's no room.
+static bool Prepend(Compiler Comp, CodeEntry Loop, const struct CodeOp *Op) {
+   int Top = Loop->Top, End = Loop->End;
+   CodeOp Ops = HeapAllocMem(Comp->pc, (Comp->NumOps + 1)*sizeof *Ops);
+   if (Ops == NULL)
+      return false;
+   memcpy(Ops, Comp->Ops, Top*sizeof *Ops);
+   Ops[Top] = *Op;
+   memcpy(&Ops[Top + 1], &Comp->Ops[Top], (Comp->NumOps - Top)*sizeof *Ops);
+   HeapFreeMem(Comp->pc, Comp->Ops);
+   Comp->Ops = Ops, Comp->NumOps = Comp->MaxOps = Comp->NumOps + 1;
+// An operation after it moves along, and so does the loop's body, even where it's jumped to from in the loop.
+#define Moved(P, InLoop) ((P) > Top || ((P) == Top && (InLoop)))
+   for (int P = 0; P < Comp->NumOps; P++) {
+      CodeOp Jump = &Comp->Ops[P];
+      if ((OpForm[Jump->Code]&IsJump) && Moved(Jump->K.Integer, P > Top && P <= End))
+         Jump->K.Integer++;
+   }
+   for (CodeEntry Entry = Comp->Entries; Entry != NULL; Entry = Entry->Next) {
+      Entry->Op += Moved(Entry->Op, Entry == Loop);
+      Entry->Top += Moved(Entry->Top, Entry == Loop);
+      Entry->End += Moved(Entry->End, Entry == Loop);
+   }
+   Comp->Entry += Moved(Comp->Entry, false);
+#undef Moved
+   return true;
+}
+
+// Hoist what doesn't change out of each innermost loop, note which loops are counted, and run the element-wise ones in batches.
+static void OptimizeLoops(Compiler Comp, int *ReadCount, int *WriteCount) {
+   CountUses(Comp, ReadCount, WriteCount);
+   bool *Moved = HeapAllocMem(Comp->pc, 2*(Comp->NumTempIds + 1)*sizeof *Moved), *IsArg = Moved + Comp->NumTempIds + 1;
+   if (Moved == NULL)
+      return;
+   for (CodeOp Op = Comp->Ops; Op < Comp->Ops + Comp->NumOps; Op++) {
+      if ((OpForm[Op->Code]&ReadArgs) && (Op->B&TempSlot)) {
+         for (int A = 0; A < Op->C; A++)
+            IsArg[(Op->B&~TempSlot) + A] = true;
+      }
+   }
+   for (CodeEntry Loop = Comp->Entries; Loop != NULL; Loop = Loop->Next) {
+      bool Inner = false;
+      for (CodeEntry Other = Comp->Entries; Other != NULL; Other = Other->Next)
+         Inner |= Other != Loop && Other->Top >= Loop->Top && Other->End <= Loop->End;
+      if (!Inner && Loop->Top < Loop->End)
+         Hoist(Comp, Loop, Moved, IsArg, WriteCount);
+      Count(Comp, Loop);
+      if (!Inner && Loop->Counted && (Loop->Kernel = Vectorize(Comp, Loop)) != NULL) {
+         struct CodeOp Vec = { VecC, IntT, Loop->Kernel->Index, 0, Loop->Kernel->Bound, { 0 } };
+         Vec.K.Pointer = Loop->Kernel;
+         if (!Prepend(Comp, Loop, &Vec))
+            HeapFreeMem(Comp->pc, Loop->Kernel), Loop->Kernel = NULL;
+      }
+   }
+   HeapFreeMem(Comp->pc, Moved);
+}
+
+// Tidy up the code:
+// remove the calculations of values that are never used,
+// write results straight to where they're moved or converted to, when nothing else reads them on the way,
+// fuse compares with the jumps on them, and increments with the jumps back of counted loops,
+// optimize the loops, and lay the temporaries out after the variables.
+static void Tidy(Compiler Comp) {
+   int *ReadCount = HeapAllocMem(Comp->pc, 2*(Comp->NumTempIds + 1)*sizeof *ReadCount), *WriteCount = ReadCount + Comp->NumTempIds + 1;
+   int *NewIndex = HeapAllocMem(Comp->pc, (Comp->NumOps + 1)*sizeof *NewIndex);
+   if (ReadCount == NULL || NewIndex == NULL) {
+      if (ReadCount != NULL)
+         HeapFreeMem(Comp->pc, ReadCount);
+      if (NewIndex != NULL)
+         HeapFreeMem(Comp->pc, NewIndex);
+      Decline(Comp);
+   }
+// Dead temporaries.
+   for (bool Changed = true; Changed; ) {
+      Changed = false;
+      CountUses(Comp, ReadCount, WriteCount);
+      for (CodeOp Op = Comp->Ops; Op < Comp->Ops + Comp->NumOps; Op++) {
+         int Form = OpForm[Op->Code];
+         if ((Form&WriteA) && (Form&Pure) && (Op->A&TempSlot) && ReadCount[Op->A&~TempSlot] == 0)
+            Op->Code = NopC, Changed = true;
+      }
+   }
+// Note the jump targets in NewIndex, for now.
+   memset(NewIndex, '\0', (Comp->NumOps + 1)*sizeof *NewIndex);
+   NewIndex[Comp->Entry] = 1;
+   for (CodeOp Op = Comp->Ops; Op < Comp->Ops + Comp->NumOps; Op++) {
+      if (OpForm[Op->Code]&IsJump)
+         NewIndex[Op->K.Integer] = 1;
+   }
+   for (CodeEntry Entry = Comp->Entries; Entry != NULL; Entry = Entry->Next)
+      NewIndex[Entry->Op] = 1;
+// Results moved or converted straight after they're made.
+   for (int P = 0; P < Comp->NumOps; P++) {
+      CodeOp Op = &Comp->Ops[P];
+      int T = Op->A;
+      if (!(OpForm[Op->Code]&WriteA) || T == NoSlot || !(T&TempSlot) || ReadCount[T&~TempSlot] != 1 || WriteCount[T&~TempSlot] != 1)
+         continue;
+      int N = P + 1;
+      while (N < Comp->NumOps && Comp->Ops[N].Code == NopC && !NewIndex[N])
+         N++;
+      if (N == Comp->NumOps || NewIndex[N] || Comp->Ops[N].B != T)
+         continue;
+      CodeOp Next = &Comp->Ops[N];
+      if (Next->Code == MovC)
+         Op->A = Next->A, Next->Code = NopC;
+      else if (Next->Code == ConvC && (Op->Base == LongIntT || Op->Base == LongNatT) &&
+         ((Op->Code >= AddC && Op->Code <= CplC)))
+         Op->A = Next->A, Op->Base = Next->Base, Next->Code = NopC;
+   }
+// Compares straight before the jumps that test them, fused into one jump on the compare.
+   static const OpCode JumpIf[] = { JEqC, JNeC, JLtC, JGtC, JLeC, JGeC };
+   for (int P = 0; P < Comp->NumOps; P++) {
+      CodeOp Op = &Comp->Ops[P];
+      int T = Op->A;
+      if (Op->Code < EqC || Op->Code > GeC || !(T&TempSlot) || ReadCount[T&~TempSlot] != 1)
+         continue;
+      int N = P + 1;
+      while (N < Comp->NumOps && Comp->Ops[N].Code == NopC && !NewIndex[N])
+         N++;
+      if (N == Comp->NumOps || NewIndex[N] || (Comp->Ops[N].Code != JzC && Comp->Ops[N].Code != JnzC) || Comp->Ops[N].A != T)
+         continue;
+      CodeOp Next = &Comp->Ops[N];
+      Op->Code = JumpIf[Op->Code - EqC];
+      if (Next->Code == JzC)
+         Op->Code = JEqC + ((Op->Code - JEqC)^1);
+      Op->A = 0, Op->K = Next->K, Next->Code = NopC;
+   }
+// Counted loops: a variable's increment, straight before the jump back while it's under its bound.
+   for (int P = 0; P < Comp->NumOps; P++) {
+      CodeOp Op = &Comp->Ops[P];
+      if (Op->Code != AddKC || Op->A != Op->B || Op->K.Integer != 1 || (Op->A&TempSlot))
+         continue;
+      int N = P + 1;
+      while (N < Comp->NumOps && Comp->Ops[N].Code == NopC && !NewIndex[N])
+         N++;
+      if (N == Comp->NumOps || NewIndex[N] || Comp->Ops[N].Code != JLtC || Comp->Ops[N].B != Op->A || Comp->Ops[N].K.Integer > P)
+         continue;
+      CodeOp Next = &Comp->Ops[N];
+      Op->Code = LoopC, Op->C = Next->C, Op->K = Next->K, Next->Code = NopC;
+   }
+// Squeeze out the operations left doing nothing.
+   int NumOps = 0;
+   for (int N = 0; N < Comp->NumOps; N++) {
+      NewIndex[N] = NumOps;
+      if (Comp->Ops[N].Code != NopC)
+         Comp->Ops[NumOps++] = Comp->Ops[N];
+   }
+   NewIndex[Comp->NumOps] = NumOps;
+   Comp->Entry = NewIndex[Comp->Entry];
+   for (CodeEntry Entry = Comp->Entries; Entry != NULL; Entry = Entry->Next)
+      Entry->Op = NewIndex[Entry->Op], Entry->Top = NewIndex[Entry->Top], Entry->End = NewIndex[Entry->End];
+   Comp->NumOps = NumOps;
+   for (CodeOp Op = Comp->Ops; Op < Comp->Ops + Comp->NumOps; Op++) {
+      if (OpForm[Op->Code]&IsJump)
+         Op->K.Integer = NewIndex[Op->K.Integer];
+   }
+   OptimizeLoops(Comp, ReadCount, WriteCount);
+// Lay out the temporaries.
+   int FirstTemp = 1 + Comp->Func->NumParams + Comp->NumVars;
+   for (CodeOp Op = Comp->Ops; Op < Comp->Ops + Comp->NumOps; Op++) {
+      int Form = OpForm[Op->Code];
+      if ((Form&(ReadA|WriteA)) && Op->A != NoSlot && (Op->A&TempSlot))
+         Op->A = FirstTemp + Comp->TempPlace[Op->A&~TempSlot];
+      if ((Form&(ReadB|ReadArgs)) && (Op->B&TempSlot))
+         Op->B = FirstTemp + Comp->TempPlace[Op->B&~TempSlot];
+      if ((Form&ReadC) && (Op->C&TempSlot))
+         Op->C = FirstTemp + Comp->TempPlace[Op->C&~TempSlot];
+   }
+   Comp->Ops[Comp->Entry].B = FirstTemp;
+   HeapFreeMem(Comp->pc, ReadCount);
+   HeapFreeMem(Comp->pc, NewIndex);
+}
+
+// Mark the slots whose addresses are taken: those that code other than the operations reaches through the slots.
+// These are the result, read by the caller, the arguments and results of calls, and the counts, bounds and constants of element-wise loops.
+// A variable whose address is taken in the source never gets this far: its function is left to the interpreter.
+// The rest are only read and written by the operations on them, so Jit.c can keep them in registers.
+static void Escape(CodeFunc Code) {
+   Code->Addressed[0] = true;
+   for (CodeOp Op = Code->Ops; Op < Code->Ops + Code->NumOps; Op++) {
+      switch ((OpCode)Op->Code) {
+         case CallC: case TailCallC:
+            for (int A = 0; A < Op->C; A++)
+               Code->Addressed[Op->B + A] = true;
+            if (Op->Code == CallC && Op->A != NoSlot)
+               Code->Addressed[Op->A] = true;
+         break;
+         case VecC: {
+            CodeKernel Kernel = Op->K.Pointer;
+            Code->Addressed[Kernel->Index] = Code->Addressed[Kernel->Bound] = true;
+            for (int S = 0; S < Kernel->NumSplats; S++)
+               Code->Addressed[Kernel->Splat[S].Slot] = true;
+         }
+         break;
+         default: break;
+      }
+   }
+}
+
+// Free what the compiler's made.
+static void CompileFree(State pc, CodeOp Ops, CodeSite Sites, CodeEntry Entries, CodeInlining Inlinings, int *TempPlace) {
+   if (Ops != NULL)
+      HeapFreeMem(pc, Ops);
+   if (TempPlace != NULL)
+      HeapFreeMem(pc, TempPlace);
+   while (Sites != NULL) {
+      CodeSite Next = Sites->Next;
+      HeapFreeMem(pc, Sites);
+      Sites = Next;
+   }
+   while (Entries != NULL) {
+      CodeEntry Next = Entries->Next;
+      if (Entries->Kernel != NULL)
+         HeapFreeMem(pc, Entries->Kernel);
+      HeapFreeMem(pc, Entries);
+      Entries = Next;
+   }
+   FreeInlinings(pc, Inlinings);
+}
+
+// Compile a function, returning NULL if it's beyond the compiler.
+static CodeFunc CompileFunction(State pc, Value FuncValue) {
+   struct Compiler C;
+   Compiler Comp = &C;
+   memset(Comp, '\0', sizeof *Comp);
+   Comp->pc = pc;
+   Comp->FuncValue = FuncValue;
+   Comp->Func = &FuncValue->Val->FuncDef;
+   ParserCopy(&Comp->Parser, &Comp->Func->Body);
+   Comp->Parser.Mode = SkipM;
+   if (setjmp(Comp->Fail)) {
+      CompileFree(pc, Comp->Ops, Comp->Sites, Comp->Entries, Comp->Inlinings, Comp->TempPlace);
+      return NULL;
+   }
+// The parameters are in slots 1 on, after the return value.
+   if (Comp->Func->NumParams > CodeLocalMax)
+      Decline(Comp);
+   for (int P = 0; P < Comp->Func->NumParams; P++) {
+      if (!IsScalar(pc, Comp->Func->ParamType[P]))
+         Decline(Comp);
+      CodeLocal Local = &Comp->Local[Comp->NumLocals++];
+      Local->Ident = Comp->Func->ParamName[P], Local->Typ = Comp->Func->ParamType[P], Local->Slot = 1 + P;
+   }
+   if (Comp->Func->ReturnType != &pc->VoidType && !IsScalar(pc, Comp->Func->ReturnType))
+      Decline(Comp);
+// The variables start out cleared, as they do in the interpreter.
+   Comp->Entry = Comp->NumOps;
+   Emit(Comp, ClearC, 1 + Comp->Func->NumParams, 0, 0);
+   Expect(Comp, LCurlL);
+   CompileBlock(Comp);
+   if (Comp->Func->ReturnType == &pc->VoidType)
+      Emit(Comp, RetC, 0, 0, 0);
+   else
+      Emit(Comp, FailC, 0, 0, 0)->K.Pointer = NewSite(Comp, FuncValue, NULL, 0);
+   Tidy(Comp);
+   int NumSlots = 1 + Comp->Func->NumParams + Comp->NumVars + Comp->MaxTemps;
+   CodeFunc Code = HeapAllocMem(pc, MemAlign(sizeof *Code) + Comp->NumOps*sizeof *Code->Ops + NumSlots*sizeof *Code->Addressed);
+   if (Code == NULL)
+      Decline(Comp);
+   Code->NumSlots = NumSlots;
+   Code->NumOps = Comp->NumOps;
+   Code->Ops = (CodeOp)AddAlign(Code, sizeof *Code);
+   memcpy(Code->Ops, Comp->Ops, Comp->NumOps*sizeof *Code->Ops);
+   Code->Addressed = (bool *)(Code->Ops + Code->NumOps);
+   Escape(Code);
+   Code->Sites = Comp->Sites;
+   Code->Entries = Comp->Entries;
+   Code->Inlinings = Comp->Inlinings;
+   for (CodeOp Op = Code->Ops; Op < Code->Ops + Code->NumOps; Op++)
+      Code->TailCalls |= Op->Code == TailCallC;
+   Code->Func = Comp->Func;
+   CompileFree(pc, Comp->Ops, NULL, NULL, NULL, Comp->TempPlace);
+   Code->Next = pc->CodeList, pc->CodeList = Code;
+   return Code;
+}
+
+// Copy a value to a slot, and back.
+static void CompileGetValue(Value Val, CodeSlot Slot) {
+#ifndef NO_FP
+   if (IsRat(Val->Typ)) {
+      Slot->FP = Val->Val->FP;
+      return;
+   }
+#endif
+   if (Val->Typ->Base == PointerT)
+      Slot->Pointer = Val->Val->Pointer;
+   else
+      Slot->Integer = ExpressionCoerceInteger(Val);
+}
+
+static void CompileSetValue(Value Val, CodeSlot Slot) {
+   switch (Val->Typ->Base) {
+      case IntT: Val->Val->Integer = Slot->Integer; break;
+      case ShortIntT: Val->Val->ShortInteger = Slot->Integer; break;
+      case CharT: Val->Val->Character = Slot->Integer; break;
+      case LongIntT: Val->Val->LongInteger = Slot->Integer; break;
+      case NatT: Val->Val->UnsignedInteger = Slot->Integer; break;
+      case ShortNatT: Val->Val->UnsignedShortInteger = Slot->Integer; break;
+      case ByteT: Val->Val->UnsignedCharacter = Slot->Integer; break;
+      case LongNatT: Val->Val->UnsignedLongInteger = Slot->Integer; break;
+#ifndef NO_FP
+      case RatT: Val->Val->FP = Slot->FP; break;
+#endif
+      case PointerT: Val->Val->Pointer = Slot->Pointer; break;
+      default: break;
+   }
+}
+
+// Set the default tiers: how long a function is interpreted before it's compiled, and run by Run.c before it's translated to machine code.
+void CompileInit(State pc) {
+   pc->CompileAfter = CompileAfterMin, pc->NativeAfter = NativeAfterMin;
+}
+
+// Translate compiled code to machine code, if it's not been already and can be.
+// Return true if it has been.
+static bool CompileNative(State pc, CodeFunc Code) {
+   if (Code->Native == NULL && !Code->NoNative && !JitTranslate(pc, Code))
+      Code->NoNative = true;
+   return Code->Native != NULL;
+}
+
+// Whether compiled code run by Run.c has been run enough, by the calls and loop iterations counted in its function, to translate it to machine code.
+static bool CompileIsHot(State pc, CodeFunc Code) {
+   return !Code->NoNative && pc->NativeAfter >= 0 && Code->Func->Calls + Code->Func->Loops >= pc->NativeAfter;
+}
+
+// Count a loop iteration of compiled code run by Run.c, translating it to machine code once it's hot.
+// Return true if it has been, for Run.c to carry on in the machine code.
+bool CompileLoop(State pc, CodeFunc Code) {
+   if (Code->NoNative || pc->NativeAfter < 0)
+      return false;
+   Code->Func->Loops++;
+   return CompileIsHot(pc, Code) && CompileNative(pc, Code);
+}
+
+// Run compiled code on its slots, from operation Start on: as C, if Aot.c's translated it, as machine code, if Jit.c has,
+// else by Run.c, counting the call toward translating it.
+static void CompileExecute(State pc, CodeFunc Code, CodeSlot Slots, int Start) {
+   if (Code->Aot != NULL) {
+      Code->Aot(Slots, Start);
+      return;
+   }
+   if (Code->Native == NULL && !Code->NoNative && pc->NativeAfter >= 0) {
+      Code->Func->Calls++;
+      if (CompileIsHot(pc, Code))
+         CompileNative(pc, Code);
+   }
+   if (Code->Native != NULL)
+      Code->Native(Slots, Code->NativeOps[Start]);
+   else
+      RunCode(pc, Code, Slots, Start);
+}
+
+// Whether a function can be run compiled, if it's been compiled or it compiles.
+bool CompileReady(State pc, Value FuncValue) {
+   struct FuncDef *Func = &FuncValue->Val->FuncDef;
+   if (Func->Compiled == NULL && (Func->Compiled = CompileFunction(pc, FuncValue)) == NULL)
+      Func->NoCompile = true;
+   return Func->Compiled != NULL;
+}
+
+// Count an iteration of the loop at Where in the tokens of an interpreted function and, once it's been called or looped enough,
+// compile it and carry on from the loop in the compiled code, to the function's return.
+// Return true if it has: the interpreter then skips the rest of the function, as it does after a return.
+bool CompileEnterLoop(ParseState Parser, const unsigned char *Where) {
+   State pc = Parser->pc;
+   StackFrame Frame = pc->TopStackFrame;
+   if (!pc->JitEnabled || Parser->Mode != RunM || Frame == NULL || Frame->FuncValue == NULL)
+      return false;
+   struct FuncDef *Func = &Frame->FuncValue->Val->FuncDef;
+   if (Func->NoCompile)
+      return false;
+#ifndef NO_DEBUGGER
+   if (pc->BreakpointCount != 0)
+      return false;
+#endif
+   if (Func->Compiled == NULL && ++Func->Loops + Func->Calls < pc->CompileAfter)
+      return false;
+   if (!CompileReady(pc, Frame->FuncValue) || Func->Compiled->TailCalls)
+      return false;
+   CodeFunc Code = Func->Compiled;
+   CodeEntry Entry = Code->Entries;
+   while (Entry != NULL && Entry->Where != Where)
+      Entry = Entry->Next;
+   if (Entry == NULL)
+      return false;
+// The variables not yet declared start out cleared.
+   CodeSlot Slots = HeapReserveStack(pc, Code->NumSlots*sizeof *Slots);
+   if (Slots == NULL)
+      ProgramFail(Parser, "out of memory");
+   memset(Slots, '\0', Code->NumSlots*sizeof *Slots);
+   for (int V = 0; V < Entry->NumVars; V++) {
+      Value Var = TableGet(&Frame->LocalTable, Entry->Var[V].Ident, NULL, NULL, NULL);
+      if (Var == NULL || Var->OutOfScope) {
+         HeapPopStack(pc, Slots, Code->NumSlots*sizeof *Slots);
+         return false;
+      }
+      CompileGetValue(Var, &Slots[Entry->Var[V].Slot]);
+   }
+   CompileExecute(pc, Code, Slots, Entry->Op);
+   if (Func->ReturnType != &pc->VoidType)
+      CompileSetValue(Frame->ReturnValue, &Slots[0]);
+   HeapPopStack(pc, Slots, Code->NumSlots*sizeof *Slots);
+   Parser->Mode = ReturnM;
+   return true;
+}
+
+// Run a user-defined function compiled, compiling it first if it's been called or looped enough:
+// in place of ExpressionCallFunction() running it, with its arguments in ParamArray and leaving its result in ReturnValue.
+// Return false if it's to be interpreted.
+bool CompileRun(ParseState Parser, Value FuncValue, Value ReturnValue, Value *ParamArray) {
+   State pc = Parser->pc;
+   struct FuncDef *Func = &FuncValue->Val->FuncDef;
+   if (!pc->JitEnabled || Func->NoCompile)
+      return false;
+#ifndef NO_DEBUGGER
+// Compiled code doesn't stop at breakpoints.
+   if (pc->BreakpointCount != 0)
+      return false;
+#endif
+   if (Func->Compiled == NULL && ++Func->Calls + Func->Loops < pc->CompileAfter)
+      return false;
+   if (!CompileReady(pc, FuncValue))
+      return false;
+   CodeFunc Code = Func->Compiled;
+   CodeSlot Slots = HeapReserveStack(pc, Code->NumSlots*sizeof *Slots);
+   if (Slots == NULL)
+      ProgramFail(Parser, "out of memory");
+   for (int P = 0; P < Func->NumParams; P++)
+      CompileGetValue(ParamArray[P], &Slots[1 + P]);
+   CompileExecute(pc, Code, Slots, 0);
+#ifdef TAIL_CALLS
+// A tail call's parameters are on the stack above the slots: the caller moves them down.
+   if (pc->TailCall.Func != NULL)
+      return true;
+#endif
+   if (Func->ReturnType != &pc->VoidType)
+      CompileSetValue(ReturnValue, &Slots[0]);
+   HeapPopStack(pc, Slots, Code->NumSlots*sizeof *Slots);
+   return true;
+}
+
+// Call a function from compiled code, with its arguments in Args, leaving its result, if any, in Result.
+// A compiled function is called directly, anything else through the interpreter.
+void CompileCall(CodeSite Site, CodeSlot Args, CodeSlot Result) {
+   State pc = Site->Where.pc;
+   struct FuncDef *Func = &Site->Func->Val->FuncDef;
+   CodeFunc Code = Func->Compiled;
+   if (pc->JitEnabled && Code != NULL && !Code->TailCalls) {
+      CodeSlot Slots = HeapReserveStack(pc, Code->NumSlots*sizeof *Slots);
+      if (Slots == NULL)
+         ProgramFail(&Site->Where, "out of memory");
+      memcpy(Slots + 1, Args, Site->NumArgs*sizeof *Slots);
+      CompileExecute(pc, Code, Slots, 0);
+      if (Result != NULL)
+         *Result = Slots[0];
+      HeapPopStack(pc, Slots, Code->NumSlots*sizeof *Slots);
+      return;
+   }
+   struct ParseState Parser;
+   ParserCopy(&Parser, &Site->Where);
+   HeapPushStackFrame(pc);
+   Value ReturnValue = VariableAllocValueFromType(pc, &Parser, Func->ReturnType, false, NULL, false);
+   Value *ParamArray = VariableAllocArguments(&Parser, Site->NumArgs, Site->ArgType);
+   for (int A = 0; A < Site->NumArgs; A++)
+      CompileSetValue(ParamArray[A], &Args[A]);
+   ExpressionCallFunction(&Parser, Site->FuncName, Site->Func, ReturnValue, ParamArray, Site->NumArgs);
+   if (Result != NULL)
+      CompileGetValue(ReturnValue, Result);
+   HeapPopStackFrame(pc);
+}
+
+#ifdef TAIL_CALLS
+// Set up a tail call from compiled code, as ExpressionParseTailCall() does, for the function's caller to make.
+void CompileTailCall(CodeSite Site, CodeSlot Args) {
+   struct ParseState Parser;
+   ParserCopy(&Parser, &Site->Where);
+   State pc = Parser.pc;
+   Value *ParamArray = VariableAllocArguments(&Parser, Site->NumArgs, Site->ArgType);
+   for (int A = 0; A < Site->NumArgs; A++)
+      CompileSetValue(ParamArray[A], &Args[A]);
+   pc->TailCall.Func = Site->Func;
+   pc->TailCall.FuncName = Site->FuncName;
+   pc->TailCall.Param = ParamArray;
+   pc->TailCall.NumArgs = Site->NumArgs;
+   pc->TailCall.Size = (char *)pc->HeapStackTop - (char *)ParamArray;
+}
+#endif
+
+// Compiled code ran off the end of a function that returns a value.
+void CompileFail(CodeSite Site) {
+   ProgramFail(&Site->Where, "no value returned from a function returning %t", Site->Func->Val->FuncDef.ReturnType);
+}
+
+// Free all the compiled code.
+void CompileCleanup(State pc) {
+   while (pc->CodeList != NULL) {
+      CodeFunc Next = pc->CodeList->Next;
+      JitFree(pc, pc->CodeList);
+      RunFree(pc, pc->CodeList);
+      CompileFree(pc, NULL, pc->CodeList->Sites, pc->CodeList->Entries, pc->CodeList->Inlinings, NULL);
+      HeapFreeMem(pc, pc->CodeList);
+      pc->CodeList = Next;
+   }
+   AotFree(pc);
+}
+#endif
+
+// Turn compilation on or off.
+void PicocEnableJit(State pc, bool On) {
+#ifndef NO_COMPILER
+   pc->JitEnabled = On;
+#endif
+}
+
+// Report on the loops of the compiled functions: whether each counts up by one to a bound that doesn't change in it,
+// the only counting that's recognized, and how many operations were hoisted out of it.
+void PicocShowLoops(State pc, OutFile Stream) {
+#ifndef NO_COMPILER
+   for (CodeFunc Code = pc->CodeList; Code != NULL; Code = Code->Next) {
+      for (CodeEntry Loop = Code->Entries; Loop != NULL; Loop = Loop->Next) {
+         PlatformPrintf(Stream, "%s:%d: a loop %s; operations hoisted out of it: %d",
+            Code->Func->Body.FileName, Loop->Line, Loop->Counted? "counting up by 1 to a fixed bound": "not counting up by 1 to a fixed bound", Loop->NumHoisted
+         );
+         if (Loop->Kernel != NULL)
+            PlatformPrintf(Stream, "; element-wise, run in batches of %d", VecLanes(Loop->Kernel));
+         PlatformPrintf(Stream, "\n");
+      }
+   }
+#endif
+}
+
+// Report on the calls of defined functions in the compiled functions: whether each was inlined, and if not, why not.
+void PicocShowInlining(State pc, OutFile Stream) {
+#ifndef NO_COMPILER
+   for (CodeFunc Code = pc->CodeList; Code != NULL; Code = Code->Next) {
+      for (CodeInlining Note = Code->Inlinings; Note != NULL; Note = Note->Next) {
+         if (Note->Reason == NULL)
+            PlatformPrintf(Stream, "%s:%d: the call of %s is inlined\n", Note->FileName, Note->Line, Note->FuncName);
+         else
+            PlatformPrintf(Stream, "%s:%d: the call of %s is not inlined, since %s\n", Note->FileName, Note->Line, Note->FuncName, Note->Reason);
+      }
+   }
+#endif
+}
+
+// Set the tiers: the calls and loop iterations before a function is compiled, and then translated to machine code (never, if negative).
+void PicocSetJitTiers(State pc, int CompileAfter, int NativeAfter) {
+#ifndef NO_COMPILER
+   pc->CompileAfter = CompileAfter, pc->NativeAfter = NativeAfter;
+#endif
+}
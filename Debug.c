@@ -12,13 +12,10 @@ void DebugInit(State pc) {
 }
 
 // Free the contents of the breakpoint table.
+// The entries are released in bulk with the entry pool by HeapCleanup().
 void DebugCleanup(State pc) {
-   for (int Count = 0; Count < pc->BreakpointTable.Size; Count++) {
-      for (TableEntry Entry = pc->BreakpointHashTable[Count], NextEntry; Entry != NULL; Entry = NextEntry) {
-         NextEntry = Entry->Next;
-         HeapFreeMem(pc, Entry);
-      }
-   }
+   TableInitTable(&pc->BreakpointTable, pc->BreakpointHashTable, DebugMax, true);
+   pc->BreakpointCount = 0;
 }
 
 // Search the table for a breakpoint.
@@ -40,7 +37,7 @@ void DebugSetBreakpoint(ParseState Parser) {
    State pc = Parser->pc;
    if (FoundEntry == NULL) {
    // Add it to the table.
-      TableEntry NewEntry = HeapAllocMem(pc, sizeof *NewEntry);
+      TableEntry NewEntry = HeapAllocNode(pc, &pc->EntryPool);
       if (NewEntry == NULL)
          ProgramFailNoParser(pc, "out of memory");
       NewEntry->p.b.FileName = Parser->FileName;
@@ -60,7 +57,7 @@ bool DebugClearBreakpoint(ParseState Parser) {
       TableEntry DeleteEntry = *EntryPtr;
       if (DeleteEntry->p.b.FileName == Parser->FileName && DeleteEntry->p.b.Line == Parser->Line && DeleteEntry->p.b.CharacterPos == Parser->CharacterPos) {
          *EntryPtr = DeleteEntry->Next;
-         HeapFreeMem(pc, DeleteEntry);
+         HeapFreeNode(&pc->EntryPool, DeleteEntry);
          pc->BreakpointCount--;
          return true;
       }
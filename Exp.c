@@ -4,7 +4,6 @@
 // Whether evaluation is left to right for a given precedence level.
 #define RightWard(P) ((P) != 2 && (P) != 14)
 static const unsigned short BracketLevel = 20;
-static const unsigned short DeepPrecedence = 1000*BracketLevel;
 
 #ifdef DEBUG_EXPRESSIONS
 #   define DebugF printf
@@ -297,17 +296,50 @@ static void ExpressionStackPushDereference(ParseState Parser, ExpressionStack *S
    ExpressionStackPushValueNode(Parser, StackTop, ValueLoc);
 }
 
+// Push a blank scalar value of a given type: its value, data and stack node are allocated in one piece, laid out as the separate allocations would be.
+static Value ExpressionStackPushScalar(ParseState Parser, ExpressionStack *StackTop, ValueType Typ) {
+   State pc = Parser->pc;
+   int DataSize = MemAlign(Typ->Sizeof);
+   int Size = MemAlign(sizeof(struct Value)) + DataSize + MemAlign(sizeof(struct ExpressionStack));
+   Value ValueLoc = HeapReserveStack(pc, Size);
+   if (ValueLoc == NULL)
+      ProgramFail(Parser, "out of memory");
+   if (pc->AllocTrace != NULL)
+      HeapTrace(pc, ValueA, Parser->FileName, Parser->Line, Size);
+   ValueLoc->Typ = Typ;
+   ValueLoc->Val = (AnyValue)AddAlign(ValueLoc, sizeof *ValueLoc);
+   memset((void *)ValueLoc->Val, '\0', DataSize);
+   ValueLoc->LValueFrom = NULL;
+   ValueLoc->ValOnHeap = false;
+   ValueLoc->ValOnStack = true;
+   ValueLoc->AnyValOnHeap = false;
+   ValueLoc->IsLValue = false;
+   ValueLoc->ScopeID = Parser->ScopeID;
+   ValueLoc->OutOfScope = false;
+   ExpressionStack StackNode = (ExpressionStack)((char *)ValueLoc->Val + DataSize);
+   StackNode->Next = *StackTop;
+   StackNode->Val = ValueLoc;
+   StackNode->Op = NoneL;
+   StackNode->Precedence = 0;
+   StackNode->Order = NoFix;
+   *StackTop = StackNode;
+#ifdef FANCY_ERROR_MESSAGES
+   StackNode->Line = Parser->Line;
+   StackNode->CharacterPos = Parser->CharacterPos;
+#endif
+#ifdef DEBUG_EXPRESSIONS
+   ExpressionStackShow(pc, *StackTop);
+#endif
+   return ValueLoc;
+}
+
 static void ExpressionPushInt(ParseState Parser, ExpressionStack *StackTop, long IntValue) {
-   Value ValueLoc = VariableAllocValueFromType(Parser->pc, Parser, &Parser->pc->IntType, false, NULL, false);
-   ValueLoc->Val->Integer = IntValue;
-   ExpressionStackPushValueNode(Parser, StackTop, ValueLoc);
+   ExpressionStackPushScalar(Parser, StackTop, &Parser->pc->IntType)->Val->Integer = IntValue;
 }
 
 #ifndef NO_FP
 void ExpressionPushFP(ParseState Parser, ExpressionStack *StackTop, double FPValue) {
-   Value ValueLoc = VariableAllocValueFromType(Parser->pc, Parser, &Parser->pc->FPType, false, NULL, false);
-   ValueLoc->Val->FP = FPValue;
-   ExpressionStackPushValueNode(Parser, StackTop, ValueLoc);
+   ExpressionStackPushScalar(Parser, StackTop, &Parser->pc->FPType)->Val->FP = FPValue;
 }
 #endif
 
@@ -430,6 +462,10 @@ static void ExpressionPrefixOperator(ParseState Parser, ExpressionStack *StackTo
       case AndL: {
          if (!TopValue->IsLValue)
             ProgramFail(Parser, "can't get the address of this");
+#ifdef TAIL_CALLS
+         if (Parser->pc->TopStackFrame != NULL)
+            Parser->pc->TopStackFrame->Addressed = true;
+#endif
          AnyValue ValPtr = TopValue->Val;
          Value Result = VariableAllocValueFromType(Parser->pc, Parser, TypeGetMatching(Parser->pc, Parser, TopValue->Typ, PointerT, 0, Parser->pc->StrEmpty, true), false, NULL, false);
          Result->Val->Pointer = (void *)ValPtr;
@@ -541,6 +577,80 @@ static void ExpressionPostfixOperator(ParseState Parser, ExpressionStack *StackT
       ProgramFail(Parser, "invalid operation");
 }
 
+// Evaluate an infix operator on integer operands, already coerced to long.
+// The result is an int.
+static void ExpressionIntOperator(ParseState Parser, ExpressionStack *StackTop, Lexical Op, Value BottomValue, long BottomInt, long TopInt) {
+   long ResultInt = 0;
+   switch (Op) {
+      case EquL: ResultInt = ExpressionAssignInt(Parser, BottomValue, TopInt, false); break;
+      case AddEquL: ResultInt = ExpressionAssignInt(Parser, BottomValue, BottomInt + TopInt, false); break;
+      case SubEquL: ResultInt = ExpressionAssignInt(Parser, BottomValue, BottomInt - TopInt, false); break;
+      case MulEquL: ResultInt = ExpressionAssignInt(Parser, BottomValue, BottomInt * TopInt, false); break;
+      case DivEquL: ResultInt = ExpressionAssignInt(Parser, BottomValue, BottomInt / TopInt, false); break;
+#ifndef NO_MODULUS
+      case ModEquL: ResultInt = ExpressionAssignInt(Parser, BottomValue, BottomInt % TopInt, false); break;
+#endif
+      case ShLEquL: ResultInt = ExpressionAssignInt(Parser, BottomValue, BottomInt << TopInt, false); break;
+      case ShREquL: ResultInt = ExpressionAssignInt(Parser, BottomValue, BottomInt >> TopInt, false); break;
+      case AndEquL: ResultInt = ExpressionAssignInt(Parser, BottomValue, BottomInt & TopInt, false); break;
+      case OrEquL: ResultInt = ExpressionAssignInt(Parser, BottomValue, BottomInt | TopInt, false); break;
+      case XOrEquL: ResultInt = ExpressionAssignInt(Parser, BottomValue, BottomInt ^ TopInt, false); break;
+      case OrOrL: ResultInt = BottomInt || TopInt; break;
+      case AndAndL: ResultInt = BottomInt && TopInt; break;
+      case OrL: ResultInt = BottomInt | TopInt; break;
+      case XOrL: ResultInt = BottomInt ^ TopInt; break;
+      case AndL: ResultInt = BottomInt & TopInt; break;
+      case RelEqL: ResultInt = BottomInt == TopInt; break;
+      case RelNeL: ResultInt = BottomInt != TopInt; break;
+      case RelLtL: ResultInt = BottomInt < TopInt; break;
+      case RelGtL: ResultInt = BottomInt > TopInt; break;
+      case RelLeL: ResultInt = BottomInt <= TopInt; break;
+      case RelGeL: ResultInt = BottomInt >= TopInt; break;
+      case ShLL: ResultInt = BottomInt << TopInt; break;
+      case ShRL: ResultInt = BottomInt >> TopInt; break;
+      case AddL: ResultInt = BottomInt + TopInt; break;
+      case SubL: ResultInt = BottomInt - TopInt; break;
+      case StarL: ResultInt = BottomInt * TopInt; break;
+      case DivL: ResultInt = BottomInt / TopInt; break;
+#ifndef NO_MODULUS
+      case ModL: ResultInt = BottomInt % TopInt; break;
+#endif
+      default: ProgramFail(Parser, "invalid operation"); break;
+   }
+   ExpressionPushInt(Parser, StackTop, ResultInt);
+}
+
+#ifndef NO_FP
+// Evaluate an infix operator on floating point operands, or on a mix of floating point and integer operands, already coerced to double.
+static void ExpressionFPOperator(ParseState Parser, ExpressionStack *StackTop, Lexical Op, Value BottomValue, double BottomFP, double TopFP) {
+   double ResultFP = 0.0;
+   long ResultInt = 0;
+   bool ResultIsInt = false;
+   switch (Op) {
+      case EquL: SetRatOrInt(Parser, ResultFP, ResultInt, BottomValue, ResultIsInt, TopFP); break;
+      case AddEquL: SetRatOrInt(Parser, ResultFP, ResultInt, BottomValue, ResultIsInt, BottomFP + TopFP); break;
+      case SubEquL: SetRatOrInt(Parser, ResultFP, ResultInt, BottomValue, ResultIsInt, BottomFP - TopFP); break;
+      case MulEquL: SetRatOrInt(Parser, ResultFP, ResultInt, BottomValue, ResultIsInt, BottomFP * TopFP); break;
+      case DivEquL: SetRatOrInt(Parser, ResultFP, ResultInt, BottomValue, ResultIsInt, BottomFP / TopFP); break;
+      case RelEqL: ResultInt = BottomFP == TopFP, ResultIsInt = true; break;
+      case RelNeL: ResultInt = BottomFP != TopFP, ResultIsInt = true; break;
+      case RelLtL: ResultInt = BottomFP < TopFP, ResultIsInt = true; break;
+      case RelGtL: ResultInt = BottomFP > TopFP, ResultIsInt = true; break;
+      case RelLeL: ResultInt = BottomFP <= TopFP, ResultIsInt = true; break;
+      case RelGeL: ResultInt = BottomFP >= TopFP, ResultIsInt = true; break;
+      case AddL: ResultFP = BottomFP + TopFP; break;
+      case SubL: ResultFP = BottomFP - TopFP; break;
+      case StarL: ResultFP = BottomFP * TopFP; break;
+      case DivL: ResultFP = BottomFP / TopFP; break;
+      default: ProgramFail(Parser, "invalid operation"); break;
+   }
+   if (ResultIsInt)
+      ExpressionPushInt(Parser, StackTop, ResultInt);
+   else
+      ExpressionPushFP(Parser, StackTop, ResultFP);
+}
+#endif
+
 // Evaluate an infix operator.
 static void ExpressionInfixOperator(ParseState Parser, ExpressionStack *StackTop, Lexical Op, Value BottomValue, Value TopValue) {
    DebugF("ExpressionInfixOperator()\n");
@@ -563,81 +673,11 @@ static void ExpressionInfixOperator(ParseState Parser, ExpressionStack *StackTop
       ExpressionQuestionMarkOperator(Parser, StackTop, TopValue, BottomValue);
    else if (Op == ColonL)
       ExpressionColonOperator(Parser, StackTop, TopValue, BottomValue);
-#ifndef NO_FP
-   else if ((TopValue->Typ == &Parser->pc->FPType && BottomValue->Typ == &Parser->pc->FPType) || (TopValue->Typ == &Parser->pc->FPType && IsNumVal(BottomValue)) || (IsNumVal(TopValue) && BottomValue->Typ == &Parser->pc->FPType)) {
-   // Floating point infix arithmetic.
-      double TopFP = TopValue->Typ == &Parser->pc->FPType? TopValue->Val->FP: (double)ExpressionCoerceInteger(TopValue);
-      double BottomFP = BottomValue->Typ == &Parser->pc->FPType? BottomValue->Val->FP: (double)ExpressionCoerceInteger(BottomValue);
-      double ResultFP = 0.0;
-      long ResultInt = 0;
-      bool ResultIsInt = false;
-      switch (Op) {
-         case EquL: SetRatOrInt(Parser, ResultFP, ResultInt, BottomValue, ResultIsInt, TopFP); break;
-         case AddEquL: SetRatOrInt(Parser, ResultFP, ResultInt, BottomValue, ResultIsInt, BottomFP + TopFP); break;
-         case SubEquL: SetRatOrInt(Parser, ResultFP, ResultInt, BottomValue, ResultIsInt, BottomFP - TopFP); break;
-         case MulEquL: SetRatOrInt(Parser, ResultFP, ResultInt, BottomValue, ResultIsInt, BottomFP * TopFP); break;
-         case DivEquL: SetRatOrInt(Parser, ResultFP, ResultInt, BottomValue, ResultIsInt, BottomFP / TopFP); break;
-         case RelEqL: ResultInt = BottomFP == TopFP, ResultIsInt = true; break;
-         case RelNeL: ResultInt = BottomFP != TopFP, ResultIsInt = true; break;
-         case RelLtL: ResultInt = BottomFP < TopFP, ResultIsInt = true; break;
-         case RelGtL: ResultInt = BottomFP > TopFP, ResultIsInt = true; break;
-         case RelLeL: ResultInt = BottomFP <= TopFP, ResultIsInt = true; break;
-         case RelGeL: ResultInt = BottomFP >= TopFP, ResultIsInt = true; break;
-         case AddL: ResultFP = BottomFP + TopFP; break;
-         case SubL: ResultFP = BottomFP - TopFP; break;
-         case StarL: ResultFP = BottomFP * TopFP; break;
-         case DivL: ResultFP = BottomFP / TopFP; break;
-         default: ProgramFail(Parser, "invalid operation"); break;
-      }
-      if (ResultIsInt)
-         ExpressionPushInt(Parser, StackTop, ResultInt);
-      else
-         ExpressionPushFP(Parser, StackTop, ResultFP);
-   }
-#endif
-   else if (IsNumVal(TopValue) && IsNumVal(BottomValue)) {
-   // Integer operation.
-      long TopInt = ExpressionCoerceInteger(TopValue);
-      long BottomInt = ExpressionCoerceInteger(BottomValue);
-      long ResultInt = 0;
-      switch (Op) {
-         case EquL: ResultInt = ExpressionAssignInt(Parser, BottomValue, TopInt, false); break;
-         case AddEquL: ResultInt = ExpressionAssignInt(Parser, BottomValue, BottomInt + TopInt, false); break;
-         case SubEquL: ResultInt = ExpressionAssignInt(Parser, BottomValue, BottomInt - TopInt, false); break;
-         case MulEquL: ResultInt = ExpressionAssignInt(Parser, BottomValue, BottomInt * TopInt, false); break;
-         case DivEquL: ResultInt = ExpressionAssignInt(Parser, BottomValue, BottomInt / TopInt, false); break;
-#ifndef NO_MODULUS
-         case ModEquL: ResultInt = ExpressionAssignInt(Parser, BottomValue, BottomInt % TopInt, false); break;
-#endif
-         case ShLEquL: ResultInt = ExpressionAssignInt(Parser, BottomValue, BottomInt << TopInt, false); break;
-         case ShREquL: ResultInt = ExpressionAssignInt(Parser, BottomValue, BottomInt >> TopInt, false); break;
-         case AndEquL: ResultInt = ExpressionAssignInt(Parser, BottomValue, BottomInt & TopInt, false); break;
-         case OrEquL: ResultInt = ExpressionAssignInt(Parser, BottomValue, BottomInt | TopInt, false); break;
-         case XOrEquL: ResultInt = ExpressionAssignInt(Parser, BottomValue, BottomInt ^ TopInt, false); break;
-         case OrOrL: ResultInt = BottomInt || TopInt; break;
-         case AndAndL: ResultInt = BottomInt && TopInt; break;
-         case OrL: ResultInt = BottomInt | TopInt; break;
-         case XOrL: ResultInt = BottomInt ^ TopInt; break;
-         case AndL: ResultInt = BottomInt & TopInt; break;
-         case RelEqL: ResultInt = BottomInt == TopInt; break;
-         case RelNeL: ResultInt = BottomInt != TopInt; break;
-         case RelLtL: ResultInt = BottomInt < TopInt; break;
-         case RelGtL: ResultInt = BottomInt > TopInt; break;
-         case RelLeL: ResultInt = BottomInt <= TopInt; break;
-         case RelGeL: ResultInt = BottomInt >= TopInt; break;
-         case ShLL: ResultInt = BottomInt << TopInt; break;
-         case ShRL: ResultInt = BottomInt >> TopInt; break;
-         case AddL: ResultInt = BottomInt + TopInt; break;
-         case SubL: ResultInt = BottomInt - TopInt; break;
-         case StarL: ResultInt = BottomInt * TopInt; break;
-         case DivL: ResultInt = BottomInt / TopInt; break;
-#ifndef NO_MODULUS
-         case ModL: ResultInt = BottomInt % TopInt; break;
-#endif
-         default: ProgramFail(Parser, "invalid operation"); break;
-      }
-      ExpressionPushInt(Parser, StackTop, ResultInt);
-   } else if (BottomValue->Typ->Base == PointerT && IsNumVal(TopValue)) {
+   else if (TopValue->Typ == BottomValue->Typ && TopValue->Typ->Base == IntT)
+      ExpressionIntOperator(Parser, StackTop, Op, BottomValue, BottomValue->Val->Integer, TopValue->Val->Integer); // The fast path for int/int.
+   else if (TopValue->Typ == BottomValue->Typ && TopValue->Typ->Base == LongIntT)
+      ExpressionIntOperator(Parser, StackTop, Op, BottomValue, BottomValue->Val->LongInteger, TopValue->Val->LongInteger); // The fast path for long/long.
+   else if (BottomValue->Typ->Base == PointerT && IsNumVal(TopValue)) {
    // Pointer/integer infix arithmetic.
       long TopInt = ExpressionCoerceInteger(TopValue);
       if (Op == RelEqL || Op == RelNeL) {
@@ -671,6 +711,20 @@ static void ExpressionInfixOperator(ParseState Parser, ExpressionStack *StackTop
          ExpressionStackPushValueNode(Parser, StackTop, BottomValue);
       } else
          ProgramFail(Parser, "invalid operation");
+   }
+#ifndef NO_FP
+   else if (TopValue->Typ == &Parser->pc->FPType && BottomValue->Typ == &Parser->pc->FPType)
+      ExpressionFPOperator(Parser, StackTop, Op, BottomValue, BottomValue->Val->FP, TopValue->Val->FP); // The fast path for double/double.
+   else if ((TopValue->Typ == &Parser->pc->FPType && IsNumVal(BottomValue)) || (IsNumVal(TopValue) && BottomValue->Typ == &Parser->pc->FPType)) {
+   // Floating point infix arithmetic.
+      double TopFP = TopValue->Typ == &Parser->pc->FPType? TopValue->Val->FP: (double)ExpressionCoerceInteger(TopValue);
+      double BottomFP = BottomValue->Typ == &Parser->pc->FPType? BottomValue->Val->FP: (double)ExpressionCoerceInteger(BottomValue);
+      ExpressionFPOperator(Parser, StackTop, Op, BottomValue, BottomFP, TopFP);
+   }
+#endif
+   else if (IsNumVal(TopValue) && IsNumVal(BottomValue)) {
+   // Integer operation.
+      ExpressionIntOperator(Parser, StackTop, Op, BottomValue, ExpressionCoerceInteger(BottomValue), ExpressionCoerceInteger(TopValue));
    } else if (BottomValue->Typ->Base == PointerT && TopValue->Typ->Base == PointerT && Op != EquL) {
    // Pointer/pointer operations.
       char *TopLoc = (char *)TopValue->Val->Pointer;
@@ -696,7 +750,7 @@ static void ExpressionInfixOperator(ParseState Parser, ExpressionStack *StackTop
 }
 
 // Take the contents of the expression stack and compute the top until there's nothing greater than the given precedence.
-static void ExpressionStackCollapse(ParseState Parser, ExpressionStack *StackTop, int Precedence, int *IgnorePrecedence) {
+static void ExpressionStackCollapse(ParseState Parser, ExpressionStack *StackTop, int Precedence) {
    DebugF("ExpressionStackCollapse(%d):\n", Precedence);
    ExpressionStack TopStackNode = *StackTop;
 #ifdef DEBUG_EXPRESSIONS
@@ -720,7 +774,7 @@ static void ExpressionStackCollapse(ParseState Parser, ExpressionStack *StackTop
                HeapPopStack(Parser->pc, TopOperatorNode, sizeof *TopStackNode);
                *StackTop = TopOperatorNode->Next;
             // Do the prefix operation.
-               if (Parser->Mode == RunM/* && FoundPrecedence < *IgnorePrecedence*/) {
+               if (Parser->Mode == RunM) {
                // Run the operator.
                   ExpressionPrefixOperator(Parser, StackTop, TopOperatorNode->Op, TopValue);
                } else {
@@ -738,7 +792,7 @@ static void ExpressionStackCollapse(ParseState Parser, ExpressionStack *StackTop
                HeapPopStack(Parser->pc, TopValue, sizeof *TopStackNode + sizeof *TopValue + TypeStackSizeValue(TopValue));
                *StackTop = TopStackNode->Next->Next;
             // Do the postfix operation.
-               if (Parser->Mode == RunM/* && FoundPrecedence < *IgnorePrecedence*/) {
+               if (Parser->Mode == RunM) {
                // Run the operator.
                   ExpressionPostfixOperator(Parser, StackTop, TopOperatorNode->Op, TopValue);
                } else {
@@ -759,7 +813,7 @@ static void ExpressionStackCollapse(ParseState Parser, ExpressionStack *StackTop
                   HeapPopStack(Parser->pc, BottomValue, sizeof *TopOperatorNode + sizeof *BottomValue + TypeStackSizeValue(BottomValue));
                   *StackTop = TopOperatorNode->Next->Next;
                // Do the infix operation.
-                  if (Parser->Mode == RunM/* && FoundPrecedence <= *IgnorePrecedence*/) {
+                  if (Parser->Mode == RunM) {
                   // Run the operator.
                      ExpressionInfixOperator(Parser, StackTop, TopOperatorNode->Op, BottomValue, TopValue);
                   } else {
@@ -773,9 +827,6 @@ static void ExpressionStackCollapse(ParseState Parser, ExpressionStack *StackTop
          // This should never happen.
             case NoFix: assert(TopOperatorNode->Order != NoFix); break;
          }
-      // If we've returned above the ignored precedence level turn ignoring off.
-         if (FoundPrecedence <= *IgnorePrecedence)
-            *IgnorePrecedence = DeepPrecedence;
       }
 #ifdef DEBUG_EXPRESSIONS
       ExpressionStackShow(Parser->pc, *StackTop);
@@ -823,18 +874,126 @@ static void ExpressionGetStructElement(ParseState Parser, ExpressionStack *Stack
          DerefDataLoc = VariableDereferencePointer(Parser, ParamVal, &StructVal, NULL, &StructType, NULL);
       if (StructType->Base != StructT && StructType->Base != UnionT)
          ProgramFail(Parser, "can't use '%s' on something that's not a struct or union %s: it's a %t", Token == DotL? ".": "->", Token == ArrowL? "pointer": "", ParamVal->Typ);
-      Value MemberValue = TableGet(StructType->Members, Ident->Val->Identifier, NULL, NULL, NULL);
-      if (MemberValue == NULL)
-         ProgramFail(Parser, "doesn't have a member called '%s'", Ident->Val->Identifier);
+   // The same site usually sees the same type, so try the cache slot for this site before the member table.
+      MemberCache Cache = &Parser->pc->MemberCache[((unsigned long)Parser->Pos >> 1)&(MemberCacheMax - 1)];
+      Value MemberValue = Cache->Member;
+      if (Cache->Type != StructType || Cache->Name != Ident->Val->Identifier) {
+         MemberValue = TableGet(StructType->Members, Ident->Val->Identifier, NULL, NULL, NULL);
+         if (MemberValue == NULL)
+            ProgramFail(Parser, "doesn't have a member called '%s'", Ident->Val->Identifier);
+         Cache->Type = StructType, Cache->Name = Ident->Val->Identifier, Cache->Member = MemberValue;
+      }
    // Pop the value - assume it'll still be there until we're done.
       HeapPopStack(Parser->pc, ParamVal, sizeof **StackTop + sizeof *StructVal + TypeStackSizeValue(StructVal));
       *StackTop = (*StackTop)->Next;
    // Make the result value for this member only.
-      Value Result = VariableAllocValueFromExistingData(Parser, MemberValue->Typ, (void *)(DerefDataLoc + MemberValue->Val->Integer), true, StructVal != NULL? StructVal->LValueFrom: NULL);
+      AnyValue MemberLoc = (AnyValue)(DerefDataLoc + MemberValue->Val->Integer);
+      Value LValueFrom = StructVal != NULL? StructVal->LValueFrom: NULL;
+      Value Result;
+      if (ParamVal->ValOnStack)
+         Result = VariableAllocValueFromExistingData(Parser, MemberValue->Typ, MemberLoc, true, LValueFrom);
+      else {
+      // The operand's data isn't on the stack, so its value is all that was popped: reuse it for the member.
+         HeapUnpopStack(Parser->pc, sizeof(struct Value));
+         Result = ParamVal;
+         Result->Typ = MemberValue->Typ, Result->Val = MemberLoc;
+         Result->ValOnHeap = Result->AnyValOnHeap = false;
+         Result->IsLValue = true, Result->LValueFrom = LValueFrom;
+      }
       ExpressionStackPushValueNode(Parser, StackTop, Result);
    }
 }
 
+// Is the expression in a macro body made only of literals, operators, type names and already folded macros?
+// If so its value can't change from one evaluation to the next, so long as none of the macros it names is shadowed by a local variable:
+// Named is set if it names any.
+static bool ExpressionIsConstant(ParseState Body, bool *Named) {
+   struct ParseState Parser;
+   ParserCopy(&Parser, Body);
+   Value LexValue;
+   for (Lexical Token; (Token = LexGetToken(&Parser, &LexValue, true)) != EndFnL; ) {
+      switch (Token) {
+      // Assignments and side effects.
+         case EquL: case AddEquL: case SubEquL: case MulEquL: case DivEquL: case ModEquL:
+         case ShLEquL: case ShREquL: case AndEquL: case OrEquL: case XOrEquL:
+         case IncOpL: case DecOpL:
+         return false;
+      // Struct, union and enum tags.
+         case StructL: case UnionL: case EnumL:
+            if (LexGetToken(&Parser, NULL, true) != IdL)
+               return false;
+         break;
+         case IdL: {
+            char *Identifier = LexValue->Val->Identifier;
+            if (LexGetToken(&Parser, NULL, false) == LParL)
+               return false;
+            Value MacroValue = TableGet(&Parser.pc->GlobalTable, Identifier, NULL, NULL, NULL);
+            if (MacroValue == NULL || MacroValue->Typ->Base != MacroT || MacroValue->Val->MacroDef.Folded == NULL)
+               return false;
+            *Named = true;
+         }
+         break;
+         case IntLitL: case RatLitL: case CharLitL:
+         case IntL: case CharL: case FloatL: case DoubleL: case VoidL: case LongL: case SignedL: case ShortL: case UnsignedL:
+         break;
+         default:
+            if ((int)Token < QuestL || (int)Token > RParL)
+               return false;
+         break;
+      }
+   }
+   return true;
+}
+
+// Does an identifier in a macro body, or in the bodies of the macros it names, resolve to a local variable here?
+// The body then means something else here than it does elsewhere.
+static bool ExpressionIsShadowed(State pc, ParseState Body) {
+   if (pc->TopStackFrame == NULL)
+      return false;
+   struct ParseState Parser;
+   ParserCopy(&Parser, Body);
+   Value LexValue;
+   for (Lexical Token; (Token = LexGetToken(&Parser, &LexValue, true)) != EndFnL; ) {
+      if (Token == StructL || Token == UnionL || Token == EnumL)
+         LexGetToken(&Parser, NULL, true);
+      else if (Token == IdL) {
+         char *Identifier = LexValue->Val->Identifier;
+         if (TableGet(&pc->TopStackFrame->LocalTable, Identifier, NULL, NULL, NULL) != NULL)
+            return true;
+         Value MacroValue = TableGet(&pc->GlobalTable, Identifier, NULL, NULL, NULL);
+         if (MacroValue != NULL && MacroValue->Typ->Base == MacroT && ExpressionIsShadowed(pc, &MacroValue->Val->MacroDef.Body))
+            return true;
+      }
+   }
+   return false;
+}
+
+// Skip over the right hand operand of Op without evaluating it, or even looking at anything but its tokens.
+// It ends before the first operator, outside any brackets, which binds no tighter than Op does,
+// except that the operand of a '?' or ':' takes in whole any x ? y : z nested in it.
+static void ExpressionSkipOperand(ParseState Parser, Lexical Op) {
+   for (int Depth = 0, Nested = 0; ; ) {
+      struct ParseCursor PreState;
+      ParserCopyPos(&PreState, Parser);
+      Lexical Token = LexGetToken(Parser, NULL, true);
+      if (Token == LParL || Token == LBrL)
+         Depth++;
+      else if (Depth == 0 && Token == QuestL && (Op == QuestL || Op == ColonL))
+         Nested++;
+      else if (Depth == 0 && Token == ColonL && Nested > 0)
+         Nested--;
+      else if (Token == RParL || Token == RBrL) {
+         if (Depth-- == 0) {
+            ParserCopyPos(Parser, &PreState);
+            return;
+         }
+      } else if (Token == EofL || Token == EndFnL || (Depth == 0 && (Token == CommaL || (int)Token > CharLitL || ((int)Token < LParL && OperatorPrecedence[(int)Token].InfixPrecedence != 0 && OperatorPrecedence[(int)Token].InfixPrecedence <= OperatorPrecedence[(int)Op].InfixPrecedence)))) {
+         ParserCopyPos(Parser, &PreState);
+         return;
+      }
+   }
+}
+
 // Parse an expression with operator precedence.
 Value ExpressionParse(ParseState Parser) {
    DebugF("ExpressionParse():\n");
@@ -842,12 +1001,12 @@ Value ExpressionParse(ParseState Parser) {
    bool Done = false;
    int BracketPrecedence = 0;
    int Precedence = 0;
-   int IgnorePrecedence = DeepPrecedence;
    ExpressionStack StackTop = NULL;
    int TernaryDepth = 0;
+   unsigned long TernaryTrue = 0; // A stack of bits, one for each '?' awaiting its ':', set if its condition held.
    do {
-      struct ParseState PreState;
-      ParserCopy(&PreState, Parser);
+      struct ParseCursor PreState;
+      ParserCopyPos(&PreState, Parser);
       Value LexValue;
       Lexical Token = LexGetToken(Parser, &LexValue, true);
       if ((((int)Token > CommaL && (int)Token <= (int)LParL) || (Token == RParL && BracketPrecedence != 0)) && (Token != ColonL || TernaryDepth > 0)) {
@@ -869,7 +1028,7 @@ Value ExpressionParse(ParseState Parser) {
                      ProgramFail(Parser, "brackets not closed");
                // Scan and collapse the stack to the precedence of this infix cast operator, then push.
                   Precedence = BracketPrecedence + OperatorPrecedence[(int)CastL].PrefixPrecedence;
-                  ExpressionStackCollapse(Parser, &StackTop, Precedence + 1, &IgnorePrecedence);
+                  ExpressionStackCollapse(Parser, &StackTop, Precedence + 1);
                   Value CastTypeValue = VariableAllocValueFromType(Parser->pc, Parser, &Parser->pc->TypeType, false, NULL, false);
                   CastTypeValue->Val->Typ = CastType;
                   ExpressionStackPushValueNode(Parser, &StackTop, CastTypeValue);
@@ -891,7 +1050,7 @@ Value ExpressionParse(ParseState Parser) {
                   if (LocalPrecedence == NextPrecedence)
                      TempPrecedenceBoost = -1;
                }
-               ExpressionStackCollapse(Parser, &StackTop, Precedence, &IgnorePrecedence);
+               ExpressionStackCollapse(Parser, &StackTop, Precedence);
                ExpressionStackPushOperator(Parser, &StackTop, PreFix, Token, Precedence + TempPrecedenceBoost);
             }
          } else {
@@ -901,18 +1060,18 @@ Value ExpressionParse(ParseState Parser) {
                   case RParL: case RBrL:
                      if (BracketPrecedence == 0) {
                      // Assume this bracket is after the end of the expression.
-                        ParserCopy(Parser, &PreState);
+                        ParserCopyPos(Parser, &PreState);
                         Done = true;
                      } else {
                      // Collapse to the bracket precedence.
-                        ExpressionStackCollapse(Parser, &StackTop, BracketPrecedence, &IgnorePrecedence);
+                        ExpressionStackCollapse(Parser, &StackTop, BracketPrecedence);
                         BracketPrecedence -= BracketLevel;
                      }
                   break;
                   default:
                   // Scan and collapse the stack to the precedence of this operator, then push.
                      Precedence = BracketPrecedence + OperatorPrecedence[(int)Token].PostfixPrecedence;
-                     ExpressionStackCollapse(Parser, &StackTop, Precedence, &IgnorePrecedence);
+                     ExpressionStackCollapse(Parser, &StackTop, Precedence);
                      ExpressionStackPushOperator(Parser, &StackTop, PostFix, Token, Precedence);
                   break;
                }
@@ -921,24 +1080,37 @@ Value ExpressionParse(ParseState Parser) {
                Precedence = BracketPrecedence + OperatorPrecedence[(int)Token].InfixPrecedence;
             // For right to left order, only go down to the next higher precedence so we evaluate it in reverse order.
             // For left to right order, collapse down to this precedence so we evaluate it in forward order.
-               ExpressionStackCollapse(Parser, &StackTop, RightWard(OperatorPrecedence[(int)Token].InfixPrecedence)? Precedence: Precedence + 1, &IgnorePrecedence);
+               ExpressionStackCollapse(Parser, &StackTop, RightWard(OperatorPrecedence[(int)Token].InfixPrecedence)? Precedence: Precedence + 1);
                if (Token == DotL || Token == ArrowL) {
                   ExpressionGetStructElement(Parser, &StackTop, Token); // This operator is followed by a struct element so handle it as a special case.
                } else {
-               // If it's a && or || operator we may not need to evaluate the right hand side of the expression.
-                  if ((Token == OrOrL || Token == AndAndL) && IsNumVal(StackTop->Val)) {
-                     long LHSInt = ExpressionCoerceInteger(StackTop->Val);
-                     if (((Token == OrOrL && LHSInt) || (Token == AndAndL && !LHSInt)) && IgnorePrecedence > Precedence)
-                        IgnorePrecedence = Precedence;
+                  // A &&, ||, ? or : may have already decided the value, making its right hand side unneeded.
+                  bool SkipOperand = false;
+                  if (Parser->Mode == RunM) switch (Token) {
+                     case AndAndL: SkipOperand = IsNumVal(StackTop->Val) && !ExpressionCoerceInteger(StackTop->Val); break;
+                     case OrOrL: SkipOperand = IsNumVal(StackTop->Val) && ExpressionCoerceInteger(StackTop->Val); break;
+                     case QuestL: SkipOperand = IsNumVal(StackTop->Val) && !ExpressionCoerceInteger(StackTop->Val); break;
+                     case ColonL: SkipOperand = TernaryTrue&1; break;
+                     default: break;
                   }
                // Push the operator on the stack.
                   ExpressionStackPushOperator(Parser, &StackTop, InFix, Token, Precedence);
                   PrefixState = true;
                   switch (Token) {
-                     case QuestL: TernaryDepth++; break;
-                     case ColonL: TernaryDepth--; break;
+                     case QuestL:
+                        if (++TernaryDepth > 8*sizeof TernaryTrue)
+                           ProgramFail(Parser, "'?' nested too deeply");
+                        TernaryTrue = TernaryTrue << 1 | (Parser->Mode == RunM && !SkipOperand);
+                     break;
+                     case ColonL: TernaryDepth--, TernaryTrue >>= 1; break;
                      default: break;
                   }
+                  if (SkipOperand) {
+                  // Jump over the unneeded operand and stand a dummy value in for it.
+                     ExpressionSkipOperand(Parser, Token);
+                     ExpressionPushInt(Parser, &StackTop, 0);
+                     PrefixState = false;
+                  }
                }
             // Treat an open square bracket as an infix array index operator followed by an open bracket.
                if (Token == LBrL) {
@@ -953,21 +1125,33 @@ Value ExpressionParse(ParseState Parser) {
          if (!PrefixState)
             ProgramFail(Parser, "identifier not expected here");
          if (LexGetToken(Parser, NULL, false) == LParL) {
-            ExpressionParseFunctionCall(Parser, &StackTop, LexValue->Val->Identifier, Parser->Mode == RunM && Precedence < IgnorePrecedence);
+            ExpressionParseFunctionCall(Parser, &StackTop, LexValue->Val->Identifier, Parser->Mode == RunM);
          } else {
-            if (Parser->Mode == RunM/* && Precedence < IgnorePrecedence*/) {
+            if (Parser->Mode == RunM) {
                Value VariableValue = VariableGet(Parser->pc, Parser, LexValue->Val->Identifier);
                if (VariableValue->Typ->Base == MacroT) {
-               // Evaluate a macro as a kind of simple subroutine.
-                  struct ParseState MacroParser;
-                  ParserCopy(&MacroParser, &VariableValue->Val->MacroDef.Body);
-                  MacroParser.Mode = Parser->Mode;
-                  if (VariableValue->Val->MacroDef.NumParams != 0)
-                     ProgramFail(&MacroParser, "macro arguments missing");
-                  Value MacroResult = ExpressionParse(&MacroParser);
-                  if (MacroResult == NULL || LexGetToken(&MacroParser, NULL, false) != EndFnL)
-                     ProgramFail(&MacroParser, "expression expected");
-                  ExpressionStackPushValueNode(Parser, &StackTop, MacroResult);
+                  MacroDef MDef = &VariableValue->Val->MacroDef;
+                  if (MDef->Folded != NULL && !(MDef->Named && ExpressionIsShadowed(Parser->pc, &MDef->Body)))
+                     ExpressionStackPushValue(Parser, &StackTop, MDef->Folded); // A constant macro, already folded.
+                  else {
+                  // Evaluate a macro as a kind of simple subroutine.
+                     struct ParseState MacroParser;
+                     ParserCopy(&MacroParser, &MDef->Body);
+                     MacroParser.Mode = Parser->Mode;
+                     if (MDef->NumParams != 0)
+                        ProgramFail(&MacroParser, "macro arguments missing");
+                     Value MacroResult = ExpressionParse(&MacroParser);
+                     if (MacroResult == NULL || LexGetToken(&MacroParser, NULL, false) != EndFnL)
+                        ProgramFail(&MacroParser, "expression expected");
+                  // The first time through where no local variable shadows what it names,
+                  // keep the value of a constant body so later references skip the evaluation.
+                     if (!MDef->Evaluated && !ExpressionIsShadowed(Parser->pc, &MDef->Body)) {
+                        MDef->Evaluated = true;
+                        if (ExpressionIsConstant(&MDef->Body, &MDef->Named))
+                           MDef->Folded = VariableAllocValueAndCopy(Parser->pc, NULL, MacroResult, true);
+                     }
+                     ExpressionStackPushValueNode(Parser, &StackTop, MacroResult);
+                  }
                } else if (VariableValue->Typ == &Parser->pc->VoidType)
                   ProgramFail(Parser, "a void value isn't much use here");
                else
@@ -975,9 +1159,6 @@ Value ExpressionParse(ParseState Parser) {
             } else // Push a dummy value.
                ExpressionPushInt(Parser, &StackTop, 0);
          }
-      // If we've successfully ignored the RHS turn ignoring off.
-         if (Precedence <= IgnorePrecedence)
-            IgnorePrecedence = DeepPrecedence;
          PrefixState = false;
       } else if ((int)Token > RParL && (int)Token <= CharLitL) {
       // It's a value of some sort, push it.
@@ -992,7 +1173,7 @@ Value ExpressionParse(ParseState Parser) {
          if (!PrefixState)
             ProgramFail(Parser, "type not expected here");
          PrefixState = false;
-         ParserCopy(Parser, &PreState);
+         ParserCopyPos(Parser, &PreState);
          char *Identifier;
          ValueType Typ = TypeParse(Parser, &Identifier, NULL);
          Value TypeValue = VariableAllocValueFromType(Parser->pc, Parser, &Parser->pc->TypeType, false, NULL, false);
@@ -1000,7 +1181,7 @@ Value ExpressionParse(ParseState Parser) {
          ExpressionStackPushValueNode(Parser, &StackTop, TypeValue);
       } else {
       // It isn't a token from an expression.
-         ParserCopy(Parser, &PreState);
+         ParserCopyPos(Parser, &PreState);
          Done = true;
       }
    } while (!Done);
@@ -1008,7 +1189,7 @@ Value ExpressionParse(ParseState Parser) {
    if (BracketPrecedence > 0)
       ProgramFail(Parser, "brackets not closed");
 // Scan and collapse the stack to precedence 0.
-   ExpressionStackCollapse(Parser, &StackTop, 0, &IgnorePrecedence);
+   ExpressionStackCollapse(Parser, &StackTop, 0);
 // Fix up the stack and return the result if we're in run mode.
    Value Result = StackTop == NULL? NULL: StackTop->Val;
    if (StackTop != NULL) {
@@ -1029,33 +1210,34 @@ Value ExpressionParse(ParseState Parser) {
 
 // Do a parameterized macro call.
 static void ExpressionParseMacroCall(ParseState Parser, ExpressionStack *StackTop, const char *MacroName, MacroDef MDef) {
-   Value ReturnValue = NULL;
-   Value *ParamArray = NULL;
-   if (Parser->Mode == RunM) {
-   // Create a stack frame for this macro.
-#ifndef NO_FP
-      ExpressionStackPushValueByType(Parser, StackTop, &Parser->pc->FPType); // Largest return type there is.
-#else
-      ExpressionStackPushValueByType(Parser, StackTop, &Parser->pc->IntType); // Largest return type there is.
-#endif
-      ReturnValue = (*StackTop)->Val;
-      HeapPushStackFrame(Parser->pc);
-      ParamArray = HeapAllocStack(Parser->pc, MDef->NumParams*sizeof *ParamArray);
-      if (ParamArray == NULL)
-         ProgramFail(Parser, "out of memory");
-   } else
-      ExpressionPushInt(Parser, StackTop, 0);
-// Parse arguments.
+// Evaluate the macro's expansion in place, as if it were a bracketed expression.
+   struct ParseState MacroParser;
+   ParserCopy(&MacroParser, &MDef->Body);
+   MacroParser.Pos = LexExpandMacro(Parser, MacroName, MDef);
+   MacroParser.Mode = Parser->Mode;
+   Value Result = ExpressionParse(&MacroParser);
+   if (Result == NULL || LexGetToken(&MacroParser, NULL, false) != EndFnL)
+      ProgramFail(&MacroParser, "expression expected");
+   ExpressionStackPushValueNode(Parser, StackTop, Result);
+}
+
+// Parse the arguments of a function call, up to and including the close bracket.
+// If FuncValue isn't NULL, assign them to the function's parameters in ParamArray.
+// Return the number of arguments.
+static int ExpressionParseArguments(ParseState Parser, const char *FuncName, Value FuncValue, Value *ParamArray) {
    int ArgCount = 0;
    Lexical Token;
    do {
       Value Param = ExpressionParse(Parser);
       if (Param != NULL) {
-         if (Parser->Mode == RunM) {
-            if (ArgCount < MDef->NumParams)
-               ParamArray[ArgCount] = Param;
-            else
-               ProgramFail(Parser, "too many arguments to %s()", MacroName);
+         if (FuncValue != NULL) {
+            if (ArgCount < FuncValue->Val->FuncDef.NumParams) {
+               ExpressionAssign(Parser, ParamArray[ArgCount], Param, true, FuncName, ArgCount + 1, false);
+               VariableStackPop(Parser, Param);
+            } else {
+               if (!FuncValue->Val->FuncDef.VarArgs)
+                  ProgramFail(Parser, "too many arguments to %s()", FuncName);
+            }
          }
          ArgCount++;
          Token = LexGetToken(Parser, NULL, true);
@@ -1068,30 +1250,81 @@ static void ExpressionParseMacroCall(ParseState Parser, ExpressionStack *StackTo
             ProgramFail(Parser, "bad argument");
       }
    } while (Token != RParL);
-   if (Parser->Mode == RunM) {
-   // Evaluate the macro.
-      if (ArgCount < MDef->NumParams)
-         ProgramFail(Parser, "not enough arguments to '%s'", MacroName);
-      if (MDef->Body.Pos == NULL)
-         ProgramFail(Parser, "'%s' is undefined", MacroName);
-      struct ParseState MacroParser;
-      ParserCopy(&MacroParser, &MDef->Body);
-      MacroParser.Mode = Parser->Mode;
-      VariableStackFrameAdd(Parser, MacroName, 0);
-      Parser->pc->TopStackFrame->NumParams = ArgCount;
-      Parser->pc->TopStackFrame->ReturnValue = ReturnValue;
-      for (int Count = 0; Count < MDef->NumParams; Count++)
-         VariableDefine(Parser->pc, Parser, MDef->ParamName[Count], ParamArray[Count], NULL, true);
-      Value EvalValue = ExpressionParse(&MacroParser);
-      ExpressionAssign(Parser, ReturnValue, EvalValue, true, MacroName, 0, false);
-      VariableStackFramePop(Parser);
-      HeapPopStackFrame(Parser->pc);
+   if (FuncValue != NULL && ArgCount < FuncValue->Val->FuncDef.NumParams)
+      ProgramFail(Parser, "not enough arguments to '%s'", FuncName);
+   return ArgCount;
+}
+
+// Interpret a user-defined function whose arguments are in ParamArray, leaving its result in ReturnValue.
+static void ExpressionRunFunction(ParseState Parser, const char *FuncName, Value FuncValue, Value ReturnValue, Value *ParamArray, int ArgCount) {
+   State pc = Parser->pc;
+   struct ParseState FuncParser;
+   ParserCopy(&FuncParser, &FuncValue->Val->FuncDef.Body);
+   VariableStackFrameAdd(Parser, FuncName, 0, FuncValue->Val->FuncDef.NumLocals);
+   pc->TopStackFrame->NumParams = ArgCount;
+   pc->TopStackFrame->ReturnValue = ReturnValue;
+#ifndef NO_COMPILER
+   pc->TopStackFrame->FuncValue = FuncValue;
+#endif
+   for (int Count = 0; Count < FuncValue->Val->FuncDef.NumParams; Count++)
+      VariableDefineParameter(Parser, FuncValue->Val->FuncDef.ParamName[Count], ParamArray[Count]);
+   if (ParseStatement(&FuncParser, true) != OkSyn)
+      ProgramFail(&FuncParser, "function body expected");
+   if (FuncParser.Mode == RunM && FuncValue->Val->FuncDef.ReturnType != &pc->VoidType)
+      ProgramFail(&FuncParser, "no value returned from a function returning %t", FuncValue->Val->FuncDef.ReturnType);
+   else if (FuncParser.Mode == GotoM)
+      ProgramFail(&FuncParser, "couldn't find goto label '%s'", FuncParser.SearchGotoLabel);
+// Size the next call's local table to fit.
+   if (pc->TopStackFrame->LocalTable.Count > FuncValue->Val->FuncDef.NumLocals)
+      FuncValue->Val->FuncDef.NumLocals = pc->TopStackFrame->LocalTable.Count;
+   VariableStackFramePop(Parser);
+}
+
+// Run a function whose arguments are in ParamArray, leaving its result in ReturnValue.
+void ExpressionCallFunction(ParseState Parser, const char *FuncName, Value FuncValue, Value ReturnValue, Value *ParamArray, int ArgCount) {
+#ifdef TAIL_CALLS
+   State pc = Parser->pc;
+#endif
+   if (FuncValue->Val->FuncDef.Intrinsic != NULL) {
+      FuncValue->Val->FuncDef.Intrinsic(Parser, ReturnValue, ParamArray, ArgCount);
+      return;
+   }
+   while (true) {
+   // Run a user-defined function: compiled, if it can be, else interpreted.
+      if (FuncValue->Val->FuncDef.Body.Pos == NULL)
+         ProgramFail(Parser, "'%s' is undefined", FuncName);
+#ifndef NO_COMPILER
+      if (!CompileRun(Parser, FuncValue, ReturnValue, ParamArray))
+#endif
+         ExpressionRunFunction(Parser, FuncName, FuncValue, ReturnValue, ParamArray, ArgCount);
+#ifdef TAIL_CALLS
+      if (pc->TailCall.Func == NULL)
+         break;
+   // It returned by a tail call: move the new parameters down over the old ones and run the callee in the same place.
+      int Offset = (char *)ParamArray - (char *)pc->TailCall.Param;
+      memmove(ParamArray, pc->TailCall.Param, pc->TailCall.Size);
+      for (int Count = 0; Count < pc->TailCall.Func->Val->FuncDef.NumParams; Count++) {
+         ParamArray[Count] = (Value)((char *)ParamArray[Count] + Offset);
+         ParamArray[Count]->Val = (AnyValue)((char *)ParamArray[Count]->Val + Offset);
+      }
+      char *NewTop = AddAlign(ParamArray, pc->TailCall.Size);
+      if (NewTop > (char *)pc->HeapStackTop)
+         HeapUnpopStack(pc, NewTop - (char *)pc->HeapStackTop);
+      else
+         HeapPopStack(pc, NULL, (char *)pc->HeapStackTop - NewTop);
+      FuncName = pc->TailCall.FuncName;
+      FuncValue = pc->TailCall.Func;
+      ArgCount = pc->TailCall.NumArgs;
+      pc->TailCall.Func = NULL;
+#else
+      break;
+#endif
    }
 }
 
 // Do a function call.
 static void ExpressionParseFunctionCall(ParseState Parser, ExpressionStack *StackTop, const char *FuncName, bool RunIt) {
-   Lexical Token = LexGetToken(Parser, NULL, true); // Open bracket.
+   LexGetToken(Parser, NULL, true); // Open bracket.
    RunMode OldMode = Parser->Mode;
    Value ReturnValue = NULL;
    Value *ParamArray = NULL;
@@ -1108,75 +1341,87 @@ static void ExpressionParseFunctionCall(ParseState Parser, ExpressionStack *Stac
       ExpressionStackPushValueByType(Parser, StackTop, FuncValue->Val->FuncDef.ReturnType);
       ReturnValue = (*StackTop)->Val;
       HeapPushStackFrame(Parser->pc);
-      ParamArray = HeapAllocStack(Parser->pc, FuncValue->Val->FuncDef.NumParams*sizeof *ParamArray);
-      if (ParamArray == NULL)
-         ProgramFail(Parser, "out of memory");
+      ParamArray = VariableAllocParameters(Parser, &FuncValue->Val->FuncDef);
    } else {
       ExpressionPushInt(Parser, StackTop, 0);
       Parser->Mode = SkipM;
    }
-// Parse arguments.
-   int ArgCount = 0;
-   do {
-      if (RunIt && ArgCount < FuncValue->Val->FuncDef.NumParams)
-         ParamArray[ArgCount] = VariableAllocValueFromType(Parser->pc, Parser, FuncValue->Val->FuncDef.ParamType[ArgCount], false, NULL, false);
-      Value Param = ExpressionParse(Parser);
-      if (Param != NULL) {
-         if (RunIt) {
-            if (ArgCount < FuncValue->Val->FuncDef.NumParams) {
-               ExpressionAssign(Parser, ParamArray[ArgCount], Param, true, FuncName, ArgCount + 1, false);
-               VariableStackPop(Parser, Param);
-            } else {
-               if (!FuncValue->Val->FuncDef.VarArgs)
-                  ProgramFail(Parser, "too many arguments to %s()", FuncName);
-            }
-         }
-         ArgCount++;
-         Token = LexGetToken(Parser, NULL, true);
-         if (Token != CommaL && Token != RParL)
-            ProgramFail(Parser, "comma expected");
-      } else {
-      // End of argument list?
-         Token = LexGetToken(Parser, NULL, true);
-         if (!RParL)
-            ProgramFail(Parser, "bad argument");
-      }
-   } while (Token != RParL);
+   int ArgCount = ExpressionParseArguments(Parser, FuncName, FuncValue, ParamArray);
    if (RunIt) {
-   // Run the function.
-      if (ArgCount < FuncValue->Val->FuncDef.NumParams)
-         ProgramFail(Parser, "not enough arguments to '%s'", FuncName);
-      if (FuncValue->Val->FuncDef.Intrinsic == NULL) {
-      // Run a user-defined function.
-         int OldScopeID = Parser->ScopeID;
-         if (FuncValue->Val->FuncDef.Body.Pos == NULL)
-            ProgramFail(Parser, "'%s' is undefined", FuncName);
-         struct ParseState FuncParser;
-         ParserCopy(&FuncParser, &FuncValue->Val->FuncDef.Body);
-         VariableStackFrameAdd(Parser, FuncName, FuncValue->Val->FuncDef.Intrinsic? FuncValue->Val->FuncDef.NumParams: 0);
-         Parser->pc->TopStackFrame->NumParams = ArgCount;
-         Parser->pc->TopStackFrame->ReturnValue = ReturnValue;
-      // Function parameters should not go out of scope.
-         Parser->ScopeID = -1;
-         for (int Count = 0; Count < FuncValue->Val->FuncDef.NumParams; Count++)
-            VariableDefine(Parser->pc, Parser, FuncValue->Val->FuncDef.ParamName[Count], ParamArray[Count], NULL, true);
-         Parser->ScopeID = OldScopeID;
-         if (ParseStatement(&FuncParser, true) != OkSyn)
-            ProgramFail(&FuncParser, "function body expected");
-         if (RunIt) {
-            if (FuncParser.Mode == RunM && FuncValue->Val->FuncDef.ReturnType != &Parser->pc->VoidType)
-               ProgramFail(&FuncParser, "no value returned from a function returning %t", FuncValue->Val->FuncDef.ReturnType);
-            else if (FuncParser.Mode == GotoM)
-               ProgramFail(&FuncParser, "couldn't find goto label '%s'", FuncParser.SearchGotoLabel);
-         }
-         VariableStackFramePop(Parser);
-      } else
-         FuncValue->Val->FuncDef.Intrinsic(Parser, ReturnValue, ParamArray, ArgCount);
+      ExpressionCallFunction(Parser, FuncName, FuncValue, ReturnValue, ParamArray, ArgCount);
       HeapPopStackFrame(Parser->pc);
    }
    Parser->Mode = OldMode;
 }
 
+#ifdef TAIL_CALLS
+// Parser is at the value of a return statement: if it's "return f(...);", for a user-defined f, set up a tail call.
+// The arguments are evaluated here, but f is run by the returning function's caller, in the place of the returning function.
+// So the host stack and the interpreter's stack stay flat, however long a chain of tail calls gets.
+// Return false if it's not a tail call, leaving Parser where it was.
+bool ExpressionParseTailCall(ParseState Parser) {
+   State pc = Parser->pc;
+   StackFrame Frame = pc->TopStackFrame;
+   if (Frame == NULL)
+      return false;
+// Look for the call.
+   struct ParseState Scan;
+   ParserCopy(&Scan, Parser);
+   Value LexValue;
+   if (LexGetToken(&Scan, &LexValue, true) != IdL)
+      return false;
+   char *FuncName = LexValue->Val->Identifier;
+   if (LexGetToken(&Scan, NULL, true) != LParL)
+      return false;
+   Value FuncValue = VariableGet(pc, Parser, FuncName);
+   if (FuncValue->Typ != &pc->FunctionType)
+      return false;
+   struct FuncDef *Func = &FuncValue->Val->FuncDef;
+// The result goes straight back to our caller, so it must need no conversion.
+   if (Func->Intrinsic != NULL || Func->VarArgs || Func->ReturnType != Frame->ReturnValue->Typ)
+      return false;
+// A struct could be carrying a pointer into the frame that's about to be reused.
+   for (int Count = 0; Count < Func->NumParams; Count++) {
+      if (Func->ParamType[Count]->Base == StructT || Func->ParamType[Count]->Base == UnionT)
+         return false;
+   }
+// The call must be the whole of the return value.
+   for (int Depth = 0; Depth >= 0; ) {
+      switch (LexGetToken(&Scan, NULL, true)) {
+         case LParL: case LBrL: Depth++; break;
+         case RParL: case RBrL: Depth--; break;
+         case EofL: case EndFnL: return false;
+         default: break;
+      }
+   }
+   if (LexGetToken(&Scan, NULL, false) != SemiL)
+      return false;
+// Evaluate the arguments.
+   LexGetToken(Parser, NULL, true), LexGetToken(Parser, NULL, true);
+   char *FrameBase = *(char **)pc->StackFrame; // Where this function's parameters and frame start.
+   Value *ParamArray = VariableAllocParameters(Parser, Func);
+   int ArgCount = ExpressionParseArguments(Parser, FuncName, FuncValue, ParamArray);
+// If an argument points into this frame, or something else might, having been given the address of one of its variables, it has to stay:
+// make an ordinary call instead.
+// The compiler never compiles a function that uses '&' or has arrays, structs or unions of its own, so compiled tail calls need no such check.
+   bool Stays = Frame->Addressed;
+   for (int Count = 0; Count < Func->NumParams && !Stays; Count++) {
+      char *Pointer = ParamArray[Count]->Typ->Base == PointerT? ParamArray[Count]->Val->Pointer: NULL;
+      Stays = Pointer >= FrameBase && Pointer < (char *)pc->HeapStackTop;
+   }
+   if (Stays) {
+      ExpressionCallFunction(Parser, FuncName, FuncValue, Frame->ReturnValue, ParamArray, ArgCount);
+      return true;
+   }
+   pc->TailCall.Func = FuncValue;
+   pc->TailCall.FuncName = FuncName;
+   pc->TailCall.Param = ParamArray;
+   pc->TailCall.NumArgs = ArgCount;
+   pc->TailCall.Size = (char *)pc->HeapStackTop - (char *)ParamArray;
+   return true;
+}
+#endif
+
 // Parse an expression.
 long ExpressionParseInt(ParseState Parser) {
    Value Val = ExpressionParse(Parser);
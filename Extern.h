@@ -72,6 +72,46 @@ struct AllocNode {
    AllocNode NextFree;
 };
 
+// Heap and stack usage statistics.
+typedef struct HeapStats *HeapStats;
+struct HeapStats {
+   long Allocs, Frees; // The number of heap allocations and frees.
+   long BytesAllocated; // The total size of all the heap allocations.
+   long BytesLive, BytesPeak; // The size of the live heap blocks: now and at most.
+   long LiveBlocks[SizeClassMax]; // Live heap blocks by size class: class N holds blocks up to 16 << N bytes, the last class the rest.
+   long StackUsed, StackPeak, StackSize; // The stack in use: now and at most, and the room it has to grow into.
+   long FreeBlocks, FreeBytes, FreeLargest; // Blocks in the built-in allocator's free lists: their number, total and largest size.
+};
+
+// What an allocation is for, as told apart by the allocation tracer.
+typedef enum AllocKind {
+   TokensA,	// A token buffer.
+   ValueA,	// A value.
+   EntryA,	// A hash table entry.
+   TypeA,	// A derived type.
+   UserA,	// A program's own malloc(), calloc() or realloc().
+   AllocKindN
+} AllocKind;
+
+// The allocations traced to one source location.
+typedef struct AllocSite *AllocSite;
+struct AllocSite {
+   const char *Chain; // The registered chain of calling functions, outermost first.
+   AllocKind Kind;
+   const char *FileName; // The source location.
+   int Line;
+   long Count, Bytes; // The number and total size of the allocations.
+   AllocSite Next;
+};
+
+// A pool of fixed-size nodes carved from larger heap chunks.
+typedef struct SlabPool *SlabPool;
+struct SlabPool {
+   int Size; // The size of each node.
+   void *FreeList; // Free nodes, linked through their first word.
+   void *Chunks; // The chunks allocated so far, linked through their first word.
+};
+
 // Whether we're running or skipping code.
 typedef enum RunMode {
    RunM,	// We're running code as we parse it.
@@ -100,6 +140,30 @@ typedef struct ParseState {
    int ScopeID; // For keeping track of local variables (free them after they go out of scope).
 } *ParseState;
 
+// Where a parser is in its token stream: all that's needed to back up to it, without the rest of the parser state.
+typedef struct ParseCursor {
+   const unsigned char *Pos;
+   short Line;
+   short CharacterPos;
+   short HashIfLevel;
+   short HashIfEvaluateToLevel;
+} *ParseCursor;
+
+// Copy where we're at in the parsing, between parsers and cursors in any combination.
+#define ParserCopyPos(To, From) ( \
+   (To)->Pos = (From)->Pos, (To)->Line = (From)->Line, (To)->CharacterPos = (From)->CharacterPos, \
+   (To)->HashIfLevel = (From)->HashIfLevel, (To)->HashIfEvaluateToLevel = (From)->HashIfEvaluateToLevel \
+)
+
+// The expansion of a parameterized macro at one call site: the body with the arguments' tokens spliced in for its parameters.
+typedef struct MacroExpansion *MacroExpansion;
+struct MacroExpansion {
+   MacroExpansion Next; // Next expansion in this hash chain.
+   const unsigned char *Site; // The call site: just past the call's open bracket.
+   struct ParseCursor After; // Just past the call's close bracket.
+   unsigned char Tokens[2]; // The expanded tokens, terminated with an EndFnL.
+};
+
 // Values.
 typedef enum BaseType {
    VoidT,	// Empty list.
@@ -136,11 +200,136 @@ struct ValueType {
    ValueType FromType; // The type we're derived from (or NULL).
    ValueType DerivedTypeList; // First in a list of types derived from this one.
    ValueType Next; // Next item in the derived type list.
+   ValueType HashNext; // Next item in this chain of the derived type index.
    Table Members; // Members of a struct or union.
    bool OnHeap; // True if allocated on the heap.
    bool StaticQualifier; // True if it's a static.
 };
 
+#ifndef NO_COMPILER
+// Compiled code: see Comp.c.
+// A function is compiled into operations on an array of slots: its return value, then its parameters, variables and temporaries.
+typedef union CodeSlot {
+   long Integer;
+#ifndef NO_FP
+   double FP;
+#endif
+   void *Pointer;
+} *CodeSlot;
+
+// NOTE: the order of the operations must correspond exactly to the order of their entries in OpForm[] in Comp.c.
+typedef enum OpCode {
+   NopC,	// Nothing.
+   ClearC,	// Clear slots A up to B.
+   MovKC,	// A = K.
+   MovC,	// A = B.
+   ConvC,	// A = B converted to the integer type Base.
+   FloatC,	// A = (double)B.
+   FixC,	// A = (long)B.
+   AddC, SubC, MulC, DivC, ModC, ShLC, ShRC, AndC, OrC, XOrC,	// A = B op C, converted to Base.
+   AddKC,	// A = B + K, converted to Base.
+   NegC, CplC,	// A = op B, converted to Base.
+   NotC,	// A = !B.
+   EqC, NeC, LtC, GtC, LeC, GeC,	// A = B rel C.
+   FAddC, FSubC, FMulC, FDivC,	// A = B op C in floating point.
+   FNegC, FNotC,	// A = op B in floating point.
+   FEqC, FNeC, FLtC, FGtC, FLeC, FGeC,	// A = B rel C in floating point.
+   LoadC,	// A = the Base at address K.
+   LoadXC,	// A = the Base at address K, indexed by (int)B.
+   StoreC,	// The Base at address K = A.
+   StoreXC,	// The Base at address K, indexed by (int)B, = A.
+   JmpC,	// Go to operation K.
+   JzC, JnzC,	// Go to operation K if A is zero / non-zero.
+   JEqC, JNeC, JLtC, JGeC, JGtC, JLeC,	// Go to operation K if B rel C: in pairs, each the opposite of the other.
+   LoopC,	// A = A + 1, converted to Base; go to operation K if A < C.
+   VecC,	// Run the element-wise loop counting A up to C through the kernel K, a batch of iterations at a time, short of its last.
+   CallC,	// A = the call at site K, with C arguments from slot B on (or no result, if A is NoSlot).
+   TailCallC,	// Set up the tail call at site K, with C arguments from slot B on.
+   RetC,	// Return.
+   FailC	// Fail at site K: no value was returned.
+} OpCode;
+
+// An operation.
+typedef struct CodeOp {
+   unsigned char Code, Base; // The OpCode, and the BaseType it works on.
+   unsigned short A, B, C; // Slot numbers.
+   union CodeSlot K; // A constant, address, operation number or site.
+} *CodeOp;
+#define NoSlot 0xffff // No slot: the index of a global that isn't an array element, or the result of a void call.
+
+// A call out of compiled code, or a place where it fails.
+typedef struct CodeSite *CodeSite;
+struct CodeSite {
+   CodeSite Next;
+   struct ParseState Where; // Where the call is, to report errors from.
+   struct Value *Func; // The function called.
+   const char *FuncName;
+   int NumArgs;
+   ValueType ArgType[1]; // The types of the arguments, as they're passed.
+};
+
+// The body of an element-wise loop, run by Vec.c a batch of iterations at a time.
+// Its operations work on registers, each holding a batch of values; LoadXC and StoreXC are indexed by the loop's count.
+typedef struct CodeKernel *CodeKernel;
+struct CodeKernel {
+   int Index, Bound; // The slots of the count and of its bound.
+   bool IsRat; // Whether it works on doubles, else on ints.
+   int NumSplats; // The registers filled from slots that don't change in the loop, before it's run.
+   struct CodeSplat { int Reg, Slot; } Splat[KernelRegMax];
+   int NumOps;
+   struct CodeOp Ops[1];
+};
+
+// A loop in a compiled function, where a call of it that's being interpreted can carry on in the compiled code.
+typedef struct CodeEntry *CodeEntry;
+struct CodeEntry {
+   CodeEntry Next;
+   const unsigned char *Where; // Where the loop is in the function's tokens.
+   int Line; // The line it's on, for the report on loops.
+   int Top, End; // Where its body starts, and where it ends: just after its jump back.
+   int Op; // The operation to carry on from.
+   bool Counted; // Set if it counts a variable up by one to a bound that doesn't change in it.
+   int NumHoisted; // The operations moved out of it, since their values don't change in it.
+   CodeKernel Kernel; // Its body, if it's element-wise and run in batches.
+   int NumVars;
+   struct CodeVar { const char *Ident; int Slot; } Var[1]; // The parameters and variables in scope there, to copy into their slots.
+};
+
+// Whether a call of a defined function in a compiled function was inlined, or why not, for the report on inlining.
+typedef struct CodeInlining *CodeInlining;
+struct CodeInlining {
+   CodeInlining Next;
+   const char *FileName; // Where the call is.
+   int Line;
+   const char *FuncName; // The function called.
+   const char *Reason; // Why it wasn't inlined, or NULL if it was.
+};
+
+// A trace of a loop, in Run.c.
+typedef struct CodeTrace *CodeTrace;
+
+// A compiled function.
+typedef struct CodeFunc *CodeFunc;
+struct CodeFunc {
+   CodeFunc Next; // The next in the list of compiled functions.
+   int NumSlots, NumOps;
+   CodeOp Ops;
+   CodeSite Sites; // The sites referred to by the operations.
+   CodeEntry Entries; // Its loops.
+   CodeInlining Inlinings; // The calls in it of defined functions, and whether each was inlined.
+   CodeTrace Traces; // The traces of its loops.
+   void **Thread; // The handler of each operation in Run.c, when it's direct-threaded.
+   bool TailCalls; // Whether it makes tail calls to other functions: it can then only be run where they can be made.
+   bool *Addressed; // Set for each slot reached through the slots by code other than the operations, which must keep it in memory.
+   struct FuncDef *Func; // The function it's compiled from, whose counters it adds to.
+   void (*Aot)(CodeSlot Slots, int Start); // The code translated to C by Aot.c, entered at operation Start.
+   void (*Native)(CodeSlot Slots, void *Start); // The machine code, from Jit.c, entered at Start.
+   void **NativeOps; // Where each operation starts in the machine code.
+   int NativeSize;
+   bool NoNative; // Set if it can't be translated to machine code.
+};
+#endif
+
 // Function definition.
 struct FuncDef {
    ValueType ReturnType; // The return value type.
@@ -150,6 +339,12 @@ struct FuncDef {
    char **ParamName; // Array of parameter names.
    void (*Intrinsic)(); // Intrinsic call address or NULL.
    struct ParseState Body; // Lexical tokens of the function body if not intrinsic.
+   int NumLocals; // The most locals seen in a call (or -1 if not called yet): sizes the local table of the next frame.
+#ifndef NO_COMPILER
+   struct CodeFunc *Compiled; // The compiled code, if it's been compiled.
+   bool NoCompile; // Set if it can't be compiled.
+   int Calls, Loops; // The calls and loop iterations counted toward compiling it, then translating it to machine code.
+#endif
 };
 
 // Macro definition.
@@ -157,6 +352,9 @@ typedef struct MacroDef {
    int NumParams; // The number of parameters.
    char **ParamName; // Array of parameter names.
    struct ParseState Body; // Lexical tokens of the function body if not intrinsic.
+   bool Evaluated; // Set once a parameterless macro has been evaluated and its body checked for constancy.
+   struct Value *Folded; // The value of a parameterless macro whose body is a constant expression, or NULL.
+   bool Named; // Set if the folded body names other macros: it's evaluated afresh where a local variable shadows one of them.
 } *MacroDef;
 
 // Values.
@@ -217,22 +415,39 @@ struct TableEntry {
 struct Table {
    short Size;
    bool OnHeap;
+   int Count; // The number of entries added by TableSet() and not yet deleted.
    TableEntry *HashTable;
 };
 
 // Stack frame for function calls.
 typedef struct StackFrame *StackFrame;
 struct StackFrame {
-   struct ParseState ReturnParser; // How we got here.
+   struct ParseCursor ReturnPos; // How we got here.
    const char *FuncName; // The name of the function we're in.
    Value ReturnValue; // Copy the return value here.
    Value *Parameter; // Array of parameter values.
    int NumParams; // The number of parameters.
-   struct Table LocalTable; // The local variables and parameters.
-   TableEntry LocalHashTable[LocTabMax];
+   struct Table LocalTable; // The local variables and parameters: its hash table follows the frame on the stack.
    StackFrame PreviousStackFrame; // The next lower stack frame.
+#ifndef NO_COMPILER
+   Value FuncValue; // The function being interpreted in the frame, whose loop iterations are counted.
+#endif
+#ifdef TAIL_CALLS
+   bool Addressed; // Set once the function has used '&' or defined an array, struct or union: a pointer into the frame may then outlive it.
+#endif
 };
 
+#ifdef TAIL_CALLS
+// A tail call, set up by a return statement and made by the returning function's caller.
+struct TailCall {
+   Value Func; // The function to call, or NULL if there's no tail call pending.
+   const char *FuncName; // Its name.
+   Value *Param; // Its parameters, evaluated into a block on top of the stack.
+   int NumArgs; // The number of arguments.
+   int Size; // The size of the parameter block.
+};
+#endif
+
 // Library function definition.
 typedef struct LibraryFunction {
    void (*Func)(ParseState Parser, Value, Value *, int);
@@ -281,6 +496,24 @@ struct IncludeLibrary {
    IncludeLibrary NextLib;
 };
 
+// A static local variable, bound to its global store by where it's declared.
+typedef struct StaticSite *StaticSite;
+struct StaticSite {
+   StaticSite Next; // Next static in this hash chain.
+   const unsigned char *Site; // Where it's declared: just past the variable's name.
+   const char *FileName, *FuncName, *Ident; // What the store's name is mangled from.
+   Value Static; // The store in the global table.
+   Value Mirror; // Its stand-in, sharing its store, put in the local table of each frame whose function visits it.
+};
+
+// A struct or union member lookup, cached for the member access sites that hash to its slot.
+typedef struct MemberCache *MemberCache;
+struct MemberCache {
+   ValueType Type; // The struct or union type.
+   const char *Name; // The member's name (a registered string).
+   Value Member; // The member: its type, and its offset as an int.
+};
+
 #define BucketMax 8 // Freelists for 4, 8, 12 ... 32 byte allocs.
 #define DebugMax 21
 
@@ -290,6 +523,7 @@ struct State {
    struct Table GlobalTable;
    CleanupTokenNode CleanupTokenList;
    TableEntry GlobalHashTable[GloTabMax];
+   StaticSite StaticHashTable[StaTabMax]; // Static local variables, by declaration site.
 // Lexer global data.
    TokenLine InteractiveHead;
    TokenLine InteractiveTail;
@@ -299,11 +533,25 @@ struct State {
    struct Value LexValue;
    struct Table ReservedWordTable;
    TableEntry ReservedWordHashTable[KeyTabMax];
+   MacroExpansion ExpansionHashTable[ExpTabMax]; // Parameterized macro expansions, by call site.
+// The cache of struct and union member lookups, indexed by where they're accessed.
+   struct MemberCache MemberCache[MemberCacheMax];
 // The table of string literal values.
    struct Table StringLiteralTable;
    TableEntry StringLiteralHashTable[LitTabMax];
 // The stack.
    StackFrame TopStackFrame;
+#ifdef TAIL_CALLS
+   struct TailCall TailCall; // A call waiting to replace the function returning.
+#endif
+#ifndef NO_COMPILER
+// Compiled code.
+   CodeFunc CodeList;
+   bool JitEnabled;
+   int CompileAfter, NativeAfter; // The calls and loop iterations before a function is compiled, and then translated to machine code.
+   void *AotLibrary; // The program translated to C and built by the system's C compiler.
+   bool TraceLoops; // Whether loops run by Run.c are traced.
+#endif
 // The value passed to exit().
    int PicocExitValue;
 // A list of libraries we can include.
@@ -330,7 +578,20 @@ struct State {
 #endif
    AllocNode FreeListBucket[BucketMax]; // We keep a pool of freelist buckets to reduce fragmentation.
    AllocNode FreeListBig; // Free memory which doesn't fit in a bucket.
+   bool HeapArena; // True if interpreter-owned memory is all released together, in bulk, at cleanup.
+#ifdef USE_MALLOC_HEAP
+   void *ArenaRegions; // The regions allocated in arena mode, linked through their first word.
+   char *ArenaFree, *ArenaEnd; // The unused part of the current region.
+   AllocNode ArenaBucket[ArenaBucketMax]; // Freed blocks in arena mode, by size.
+   AllocNode ArenaLarge; // Freed blocks in arena mode too big for a bucket.
+#endif
+   struct HeapStats HeapStats; // The running heap counters.
+   void *HeapStackPeak; // The stack's high-water mark.
+   AllocSite *AllocTrace; // The allocation tracer's hash table of sites, or NULL if tracing is off.
+   struct SlabPool EntryPool; // Heap-resident hash table entries.
+   struct SlabPool TypePool; // Derived types.
 // Types.
+   ValueType TypeHashTable[TypeTabMax]; // The derived type index: every type, hashed on its parent, base, array size and identifier.
    struct ValueType UberType;
    struct ValueType IntType;
    struct ValueType ShortType;
@@ -396,6 +657,8 @@ Lexical LexGetToken(ParseState Parser, Value *ValP, int IncPos);
 Lexical LexRawPeekToken(ParseState Parser);
 void LexToEndOfLine(ParseState Parser);
 void *LexCopyTokens(ParseState StartParser, ParseState EndParser);
+const unsigned char *LexExpandMacro(ParseState Parser, const char *MacroName, MacroDef MDef);
+void LexForgetExpansions(State pc);
 void LexInteractiveClear(State pc, ParseState Parser);
 void LexInteractiveCompleted(State pc, ParseState Parser);
 void LexInteractiveStatementPrompt(State pc);
@@ -421,6 +684,40 @@ double ExpressionCoerceFP(Value Val);
 void ExpressionAssign(ParseState Parser, Value DestValue, Value SourceValue, bool Force, const char *FuncName, int ParamNo, bool AllowPointerCoercion);
 Value ExpressionParse(ParseState Parser);
 long ExpressionParseInt(ParseState Parser);
+#ifdef TAIL_CALLS
+bool ExpressionParseTailCall(ParseState Parser);
+#endif
+void ExpressionCallFunction(ParseState Parser, const char *FuncName, Value FuncValue, Value ReturnValue, Value *ParamArray, int ArgCount);
+
+#ifndef NO_COMPILER
+// Comp.c:
+void CompileInit(State pc);
+bool CompileEnterLoop(ParseState Parser, const unsigned char *Where);
+bool CompileLoop(State pc, CodeFunc Code);
+bool CompileReady(State pc, Value FuncValue);
+bool CompileRun(ParseState Parser, Value FuncValue, Value ReturnValue, Value *ParamArray);
+void CompileCall(CodeSite Site, CodeSlot Args, CodeSlot Result);
+#   ifdef TAIL_CALLS
+void CompileTailCall(CodeSite Site, CodeSlot Args);
+#   endif
+void CompileFail(CodeSite Site);
+void CompileCleanup(State pc);
+
+// Jit.c:
+bool JitTranslate(State pc, CodeFunc Code);
+void JitFree(State pc, CodeFunc Code);
+
+// Run.c:
+void RunCode(State pc, CodeFunc Code, CodeSlot Slots, int Start);
+void RunFree(State pc, CodeFunc Code);
+
+// Aot.c:
+void AotFree(State pc);
+
+// Vec.c:
+int VecLanes(CodeKernel Kernel);
+void VecRun(CodeKernel Kernel, CodeSlot Slots);
+#endif
 
 // Type.c:
 void TypeInit(State pc);
@@ -442,6 +739,7 @@ bool TypeIsForwardDeclared(ParseState Parser, ValueType Typ);
 // Heap.c:
 void HeapInit(State pc, int StackOrHeapSize);
 void HeapCleanup(State pc);
+void *HeapReserveStack(State pc, int Size);
 void *HeapAllocStack(State pc, int Size);
 void HeapUnpopStack(State pc, int Size);
 bool HeapPopStack(State pc, void *Addr, int Size);
@@ -449,6 +747,9 @@ void HeapPushStackFrame(State pc);
 bool HeapPopStackFrame(State pc);
 void *HeapAllocMem(State pc, int Size);
 void HeapFreeMem(State pc, void *Mem);
+void *HeapAllocNode(State pc, SlabPool Pool);
+void HeapFreeNode(SlabPool Pool, void *Node);
+void HeapTrace(State pc, AllocKind Kind, const char *FileName, int Line, int Size);
 
 // Var.c:
 void VariableInit(State pc);
@@ -458,6 +759,8 @@ void VariableCleanup(State pc);
 void *VariableAlloc(State pc, ParseState Parser, int Size, bool OnHeap);
 Value VariableAllocValueAndData(State pc, ParseState Parser, int DataSize, bool IsLValue, Value LValueFrom, bool OnHeap);
 Value VariableAllocValueFromType(State pc, ParseState Parser, ValueType Typ, bool IsLValue, Value LValueFrom, bool OnHeap);
+Value *VariableAllocArguments(ParseState Parser, int NumArgs, ValueType *ArgType);
+Value *VariableAllocParameters(ParseState Parser, struct FuncDef *Func);
 Value VariableAllocValueAndCopy(State pc, ParseState Parser, Value FromValue, bool OnHeap);
 Value VariableAllocValueFromExistingData(ParseState Parser, ValueType Typ, AnyValue FromValue, bool IsLValue, Value LValueFrom);
 Value VariableAllocValueShared(ParseState Parser, Value FromValue);
@@ -466,12 +769,13 @@ int VariableScopeBegin(ParseState Parser, int *OldScopeID);
 void VariableScopeEnd(ParseState Parser, int ScopeID, int PrevScopeID);
 bool VariableDefinedAndOutOfScope(State pc, const char *Ident);
 Value VariableDefine(State pc, ParseState Parser, char *Ident, Value InitValue, ValueType Typ, bool MakeWritable);
+void VariableDefineParameter(ParseState Parser, char *Ident, Value Param);
 Value VariableDefineButIgnoreIdentical(ParseState Parser, char *Ident, ValueType Typ, bool IsStatic, bool *FirstVisit);
 bool VariableDefined(State pc, const char *Ident);
 Value VariableGet(State pc, ParseState Parser, const char *Ident);
 void VariableDefinePlatformVar(State pc, ParseState Parser, char *Ident, ValueType Typ, AnyValue FromValue, bool IsWritable);
 void VariableStackPop(ParseState Parser, Value Var);
-void VariableStackFrameAdd(ParseState Parser, const char *FuncName, int NumParams);
+void VariableStackFrameAdd(ParseState Parser, const char *FuncName, int NumParams, int NumLocals);
 void VariableStackFramePop(ParseState Parser);
 Value VariableStringLiteralGet(State pc, char *Ident);
 void VariableStringLiteralDefine(State pc, char *Ident, Value Val);
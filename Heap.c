@@ -3,6 +3,7 @@
 // Alternatively you can define USE_MALLOC_HEAP to use your system's own malloc() allocator.
 
 // Stack grows up from the bottom and heap grows down from the top of heap space.
+#include "Main.h"
 #include "Extern.h"
 
 #ifdef DEBUG_HEAP
@@ -14,6 +15,56 @@ static void ShowBigList(State pc) {
 }
 #endif
 
+// Raise the stack's high-water mark to the top of the stack.
+static void HeapNoteStackTop(State pc) {
+   if ((char *)pc->HeapStackTop > (char *)pc->HeapStackPeak)
+      pc->HeapStackPeak = pc->HeapStackTop;
+}
+
+// The statistics size class of a heap block.
+static int HeapSizeClass(int Size) {
+   int Class = 0;
+   for (int ClassSize = 0x10; ClassSize < Size && Class < SizeClassMax - 1; ClassSize <<= 1)
+      Class++;
+   return Class;
+}
+
+// Count a heap block as allocated.
+static void HeapNoteAlloc(State pc, int Size) {
+   HeapStats Stats = &pc->HeapStats;
+   Stats->Allocs++;
+   Stats->BytesAllocated += Size;
+   Stats->BytesLive += Size;
+   if (Stats->BytesLive > Stats->BytesPeak)
+      Stats->BytesPeak = Stats->BytesLive;
+   Stats->LiveBlocks[HeapSizeClass(Size)]++;
+}
+
+// Count a heap block as freed.
+static void HeapNoteFree(State pc, int Size) {
+   HeapStats Stats = &pc->HeapStats;
+   Stats->Frees++;
+   Stats->BytesLive -= Size;
+   Stats->LiveBlocks[HeapSizeClass(Size)]--;
+}
+
+// Initialize a slab pool of nodes of a given size.
+static void HeapInitPool(SlabPool Pool, int Size) {
+   Pool->Size = MemAlign(Size);
+   Pool->FreeList = NULL;
+   Pool->Chunks = NULL;
+}
+
+// Free all the chunks of a slab pool, along with every node carved from them.
+static void HeapCleanupPool(State pc, SlabPool Pool) {
+   for (void *Chunk = Pool->Chunks, *NextChunk; Chunk != NULL; Chunk = NextChunk) {
+      NextChunk = *(void **)Chunk;
+      HeapFreeMem(pc, Chunk);
+   }
+   Pool->FreeList = NULL;
+   Pool->Chunks = NULL;
+}
+
 // Initialize the stack and heap storage.
 void HeapInit(State pc, int StackOrHeapSize) {
 #ifdef USE_MALLOC_STACK
@@ -44,27 +95,62 @@ void HeapInit(State pc, int StackOrHeapSize) {
    pc->FreeListBig = NULL;
    for (int Count = 0; Count < BucketMax; Count++)
       pc->FreeListBucket[Count] = NULL;
+#ifdef USE_MALLOC_HEAP
+   pc->ArenaRegions = NULL;
+   pc->ArenaFree = pc->ArenaEnd = NULL;
+   for (int Count = 0; Count < ArenaBucketMax; Count++)
+      pc->ArenaBucket[Count] = NULL;
+   pc->ArenaLarge = NULL;
+#endif
+   memset(&pc->HeapStats, '\0', sizeof pc->HeapStats);
+   pc->HeapStackPeak = pc->HeapStackTop;
+   pc->AllocTrace = NULL;
+   HeapInitPool(&pc->EntryPool, sizeof(struct TableEntry));
+   HeapInitPool(&pc->TypePool, sizeof(struct ValueType));
 }
 
 void HeapCleanup(State pc) {
+   if (pc->HeapArena) {
+   // Everything on the heap goes at once: with its regions, if it has any, else with the heap memory itself.
+#ifdef USE_MALLOC_HEAP
+      for (void *Region = pc->ArenaRegions, *NextRegion; Region != NULL; Region = NextRegion) {
+         NextRegion = *(void **)Region;
+         free(Region);
+      }
+#endif
+   } else {
+      PicocTraceAllocs(pc, false);
+   // Release the slab pools in bulk: their nodes aren't freed one at a time at cleanup.
+      HeapCleanupPool(pc, &pc->EntryPool);
+      HeapCleanupPool(pc, &pc->TypePool);
+   }
 #ifdef USE_MALLOC_STACK
    free(pc->HeapMemory);
 #endif
 }
 
 // Allocate some space on the stack, in the current stack frame.
-// Clears memory.
+// Doesn't clear memory.
 // Can return NULL if out of stack space.
-void *HeapAllocStack(State pc, int Size) {
+void *HeapReserveStack(State pc, int Size) {
    char *NewMem = pc->HeapStackTop;
 #ifdef DEBUG_HEAP
-   printf("HeapAllocStack(%ld) at 0x%lx\n", (unsigned long)MemAlign(Size), (unsigned long)NewMem);
+   printf("HeapReserveStack(%ld) at 0x%lx\n", (unsigned long)MemAlign(Size), (unsigned long)NewMem);
 #endif
    char *NewTop = AddAlign(NewMem, Size);
    if (NewTop > (char *)pc->HeapBottom)
       return NULL;
    pc->HeapStackTop = (void *)NewTop;
-   memset((void *)NewMem, '\0', Size);
+   HeapNoteStackTop(pc);
+   return NewMem;
+}
+
+// Allocate some cleared space on the stack, in the current stack frame.
+// Can return NULL if out of stack space.
+void *HeapAllocStack(State pc, int Size) {
+   void *NewMem = HeapReserveStack(pc, Size);
+   if (NewMem != NULL)
+      memset(NewMem, '\0', Size);
    return NewMem;
 }
 
@@ -74,6 +160,7 @@ void HeapUnpopStack(State pc, int Size) {
    printf("HeapUnpopStack(%ld) at 0x%lx\n", (unsigned long)MemAlign(Size), (unsigned long)pc->HeapStackTop);
 #endif
    pc->HeapStackTop = (void *)AddAlign(pc->HeapStackTop, Size);
+   HeapNoteStackTop(pc);
 }
 
 // Free some space at the top of the stack.
@@ -97,6 +184,7 @@ void HeapPushStackFrame(State pc) {
    *(void **)pc->HeapStackTop = pc->StackFrame;
    pc->StackFrame = pc->HeapStackTop;
    pc->HeapStackTop = (void *)AddAlign(pc->HeapStackTop, AlignSize);
+   HeapNoteStackTop(pc);
 }
 
 // Pop the current stack frame, freeing all memory in the frame.
@@ -113,12 +201,77 @@ bool HeapPopStackFrame(State pc) {
       return false;
 }
 
+#ifdef USE_MALLOC_HEAP
+// Keep a freed block of Size bytes at Node in arena mode for reuse: in the bucket for its size, if it's small, else with the large blocks.
+static void HeapArenaFree(State pc, AllocNode Node, int Size) {
+   AllocNode *List = Size/AlignSize < ArenaBucketMax? &pc->ArenaBucket[Size/AlignSize]: &pc->ArenaLarge;
+   Node->Size = Size;
+   Node->NextFree = *List, *List = Node;
+}
+
+// Allocate an aligned block of *SizeP bytes in arena mode: reusing a freed block of the same size, if it's small and there is one,
+// or the first freed block big enough, if it's large, with what's left over freed again, if there's enough for a block;
+// else carving it from the current region, else from a new one.
+// *SizeP is set to the size of the block given.
+// Memory is cleared.
+// Can return NULL if out of memory.
+static void *HeapArenaAlloc(State pc, int *SizeP) {
+   char *NewMem;
+   int Size = *SizeP;
+   int Bucket = Size/AlignSize;
+   AllocNode *Large = &pc->ArenaLarge;
+   if (Bucket >= ArenaBucketMax)
+      while (*Large != NULL && (*Large)->Size < Size)
+         Large = &(*Large)->NextFree;
+   if (Bucket < ArenaBucketMax && pc->ArenaBucket[Bucket] != NULL) {
+      NewMem = (char *)pc->ArenaBucket[Bucket];
+      pc->ArenaBucket[Bucket] = pc->ArenaBucket[Bucket]->NextFree;
+   } else if (Bucket >= ArenaBucketMax && *Large != NULL) {
+      NewMem = (char *)*Large;
+      int Left = (*Large)->Size - Size;
+      *Large = (*Large)->NextFree;
+      if (Left >= MemAlign(sizeof(struct AllocNode)))
+         HeapArenaFree(pc, (AllocNode)(NewMem + Size), Left);
+      else
+         *SizeP += Left;
+   } else if (Size <= pc->ArenaEnd - pc->ArenaFree) {
+      NewMem = pc->ArenaFree;
+      pc->ArenaFree += Size;
+   } else {
+   // Blocks too big for a region get one of their own.
+      int RegionSize = MemAlign(sizeof(void *)) + (Size > ArenaMax/4? Size: ArenaMax);
+      char *Region = malloc(RegionSize);
+      if (Region == NULL)
+         return NULL;
+      *(void **)Region = pc->ArenaRegions;
+      pc->ArenaRegions = Region;
+      NewMem = AddAlign(Region, sizeof(void *));
+      if (Size <= ArenaMax/4) {
+         pc->ArenaFree = NewMem + Size;
+         pc->ArenaEnd = Region + RegionSize;
+      }
+   }
+   memset(NewMem, '\0', Size);
+   return NewMem;
+}
+#endif
+
 // Allocate some dynamically allocated memory.
 // Memory is cleared.
 // Can return NULL if out of memory.
 void *HeapAllocMem(State pc, int Size) {
 #ifdef USE_MALLOC_HEAP
-   return calloc(Size, 1);
+// Keep the block size in front of the block, as the built-in allocator does, for the statistics and for arena mode.
+   AllocNode NewMem = NULL;
+   int AllocSize = MemAlign(sizeof NewMem->Size) + MemAlign(Size);
+   if (AllocSize < sizeof *NewMem)
+      AllocSize = sizeof *NewMem;
+   NewMem = pc->HeapArena? HeapArenaAlloc(pc, &AllocSize): calloc(AllocSize, 1);
+   if (NewMem == NULL)
+      return NULL;
+   NewMem->Size = AllocSize;
+   HeapNoteAlloc(pc, AllocSize);
+   return (void *)AddAlign(NewMem, sizeof NewMem->Size);
 #else
    const size_t SplitMemThreshold = 0x10; // Don't split memory which is close in size.
    if (Size == 0)
@@ -179,8 +332,9 @@ void *HeapAllocMem(State pc, int Size) {
       NewMem = pc->HeapBottom;
       NewMem->Size = AllocSize;
    }
-   void *ReturnMem = (void *)AddAlign(NewMem, (sizeof NewMem->Size);
+   void *ReturnMem = (void *)AddAlign(NewMem, sizeof NewMem->Size);
    memset(ReturnMem, '\0', AllocSize - MemAlign(sizeof NewMem->Size));
+   HeapNoteAlloc(pc, AllocSize);
 #   ifdef DEBUG_HEAP
    printf(" = %lx\n", (unsigned long)ReturnMem);
 #   endif
@@ -191,7 +345,14 @@ void *HeapAllocMem(State pc, int Size) {
 // Free some dynamically allocated memory.
 void HeapFreeMem(State pc, void *Mem) {
 #ifdef USE_MALLOC_HEAP
-   free(Mem);
+   if (Mem == NULL)
+      return;
+   AllocNode MemNode = (AllocNode)SubAlign(Mem, sizeof MemNode->Size);
+   HeapNoteFree(pc, MemNode->Size);
+   if (!pc->HeapArena)
+      free(MemNode);
+   else
+      HeapArenaFree(pc, MemNode, MemNode->Size);
 #else
 #   ifdef DEBUG_HEAP
    printf("HeapFreeMem(0x%lx)\n", (unsigned long)Mem);
@@ -201,6 +362,7 @@ void HeapFreeMem(State pc, void *Mem) {
       return;
    AllocNode MemNode = (AllocNode)SubAlign(Mem, sizeof MemNode->Size);
    assert(MemNode->Size < HEAP_SIZE && MemNode->Size > 0);
+   HeapNoteFree(pc, MemNode->Size);
    int Bucket = MemNode->Size >> 2;
    if ((void *)MemNode == pc->HeapBottom) {
    // Pop it off the bottom of the heap, reducing the heap size.
@@ -216,7 +378,7 @@ void HeapFreeMem(State pc, void *Mem) {
 #   ifdef DEBUG_HEAP
       printf("freeing %d to bucket\n", MemNode->Size);
 #   endif
-      assert(pc->FreeListBucket[Bucket] == NULL || ((unsigned long)pc->FreeListBucket[Bucket] >= (unsigned long)pc->HeapMemory && (unsigned char *)FreeListBucket[Bucket] - HeapMemory < HEAP_SIZE));
+      assert(pc->FreeListBucket[Bucket] == NULL || ((unsigned long)pc->FreeListBucket[Bucket] >= (unsigned long)pc->HeapMemory && (unsigned char *)pc->FreeListBucket[Bucket] - pc->HeapMemory < HEAP_SIZE));
       *(AllocNode *)MemNode = pc->FreeListBucket[Bucket];
       pc->FreeListBucket[Bucket] = (AllocNode)MemNode;
    } else {
@@ -226,10 +388,159 @@ void HeapFreeMem(State pc, void *Mem) {
 #   endif
       assert(pc->FreeListBig == NULL || ((unsigned long)pc->FreeListBig >= (unsigned long)pc->HeapMemory && (unsigned char *)pc->FreeListBig - pc->HeapMemory < HEAP_SIZE));
       MemNode->NextFree = pc->FreeListBig;
-      FreeListBig = MemNode;
+      pc->FreeListBig = MemNode;
 #   ifdef DEBUG_HEAP
       ShowBigList(pc);
 #   endif
    }
 #endif
 }
+
+// Allocate a node from a slab pool, taking a new chunk from the heap if the pool is empty.
+// Memory is cleared.
+// Can return NULL if out of memory.
+void *HeapAllocNode(State pc, SlabPool Pool) {
+   if (Pool->FreeList == NULL) {
+      char *Chunk = HeapAllocMem(pc, MemAlign(sizeof(void *)) + SlabMax*Pool->Size);
+      if (Chunk == NULL)
+         return NULL;
+      *(void **)Chunk = Pool->Chunks;
+      Pool->Chunks = Chunk;
+   // Thread the new nodes onto the free list in address order.
+      for (char *Node = AddAlign(Chunk, sizeof(void *)) + (SlabMax - 1)*Pool->Size; Node > Chunk; Node -= Pool->Size) {
+         *(void **)Node = Pool->FreeList;
+         Pool->FreeList = Node;
+      }
+   }
+   void *NewNode = Pool->FreeList;
+   Pool->FreeList = *(void **)NewNode;
+   memset(NewNode, '\0', Pool->Size);
+   return NewNode;
+}
+
+// Return a node to its slab pool.
+void HeapFreeNode(SlabPool Pool, void *Node) {
+   *(void **)Node = Pool->FreeList;
+   Pool->FreeList = Node;
+}
+
+// Get the heap and stack usage statistics.
+void PicocGetHeapStats(State pc, HeapStats Stats) {
+   *Stats = pc->HeapStats;
+   Stats->StackUsed = (char *)pc->HeapStackTop - (char *)pc->HeapMemory;
+   Stats->StackPeak = (char *)pc->HeapStackPeak - (char *)pc->HeapMemory;
+   Stats->StackSize = (char *)pc->HeapBottom - (char *)pc->HeapMemory;
+#ifndef USE_MALLOC_HEAP
+// Bucket freelists are linked through their first word and hold blocks of their bucket's size.
+   for (int Bucket = 0; Bucket < BucketMax; Bucket++) {
+      for (AllocNode Node = pc->FreeListBucket[Bucket]; Node != NULL; Node = *(AllocNode *)Node) {
+         Stats->FreeBlocks++;
+         Stats->FreeBytes += Bucket << 2;
+         if (Bucket << 2 > Stats->FreeLargest)
+            Stats->FreeLargest = Bucket << 2;
+      }
+   }
+   for (AllocNode Node = pc->FreeListBig; Node != NULL; Node = Node->NextFree) {
+      Stats->FreeBlocks++;
+      Stats->FreeBytes += Node->Size;
+      if (Node->Size > Stats->FreeLargest)
+         Stats->FreeLargest = Node->Size;
+   }
+#endif
+}
+
+// Show the heap and stack usage statistics.
+void PicocShowHeapStats(State pc, OutFile Stream) {
+   struct HeapStats Stats;
+   PicocGetHeapStats(pc, &Stats);
+   long LiveBlocks = 0;
+   for (int Class = 0; Class < SizeClassMax; Class++)
+      LiveBlocks += Stats.LiveBlocks[Class];
+   PlatformPrintf(Stream, "heap: %l allocations (%l bytes), %l frees\n", Stats.Allocs, Stats.BytesAllocated, Stats.Frees);
+   PlatformPrintf(Stream, "heap: %l blocks live (%l bytes), peak %l bytes\n", LiveBlocks, Stats.BytesLive, Stats.BytesPeak);
+   PlatformPrintf(Stream, "heap: live blocks by size:");
+   for (int Class = 0; Class < SizeClassMax; Class++) {
+      if (Stats.LiveBlocks[Class] != 0)
+         PlatformPrintf(Stream, Class < SizeClassMax - 1? " <=%l:%l": " >%l:%l", Class < SizeClassMax - 1? 0x10L << Class: 0x10L << (Class - 1), Stats.LiveBlocks[Class]);
+   }
+   PlatformPrintf(Stream, "\n");
+#ifndef USE_MALLOC_HEAP
+   PlatformPrintf(Stream, "heap: %l free blocks (%l bytes), largest %l bytes\n", Stats.FreeBlocks, Stats.FreeBytes, Stats.FreeLargest);
+#endif
+   PlatformPrintf(Stream, "stack: %l bytes used, peak %l of %l bytes\n", Stats.StackUsed, Stats.StackPeak, Stats.StackSize);
+}
+
+// Turn the allocation tracer on or off.
+// Turning it off discards the sites it has gathered.
+void PicocTraceAllocs(State pc, bool On) {
+   if (On && pc->AllocTrace == NULL) {
+      pc->AllocTrace = HeapAllocMem(pc, TraceTabMax*sizeof *pc->AllocTrace);
+      if (pc->AllocTrace == NULL)
+         ProgramFailNoParser(pc, "out of memory");
+   } else if (!On && pc->AllocTrace != NULL) {
+      for (int Count = 0; Count < TraceTabMax; Count++) {
+         for (AllocSite Site = pc->AllocTrace[Count], NextSite; Site != NULL; Site = NextSite) {
+            NextSite = Site->Next;
+            HeapFreeMem(pc, Site);
+         }
+      }
+      HeapFreeMem(pc, pc->AllocTrace);
+      pc->AllocTrace = NULL;
+   }
+}
+
+// Append a name to a chain of them, separated by ';'s, truncating the chain to fit a line buffer.
+static int HeapTraceAppend(char *Chain, int Len, const char *Name) {
+   if (Len > 0 && Len < LineBufMax - 1)
+      Chain[Len++] = ';';
+   while (*Name != '\0' && Len < LineBufMax - 1)
+      Chain[Len++] = *Name++;
+   Chain[Len] = '\0';
+   return Len;
+}
+
+// Record an allocation with the allocation tracer, against the calling functions and source location that made it.
+// Only called when the tracer is on.
+void HeapTrace(State pc, AllocKind Kind, const char *FileName, int Line, int Size) {
+// Name the calling functions outermost first, eliding all but the innermost TraceDepthMax.
+   const char *Callers[TraceDepthMax];
+   int Depth = 0;
+   StackFrame Frame = pc->TopStackFrame;
+   for (; Frame != NULL && Depth < TraceDepthMax; Frame = Frame->PreviousStackFrame)
+      Callers[Depth++] = Frame->FuncName;
+   char Chain[LineBufMax];
+   int Len = HeapTraceAppend(Chain, 0, Frame != NULL? "...": Depth == 0? "-": "");
+   while (Depth > 0)
+      Len = HeapTraceAppend(Chain, Len, Callers[--Depth]);
+   const char *ChainKey = TableStrRegister2(pc, Chain, Len);
+// Add it to the site's tally.
+   int HashValue = ((unsigned long)ChainKey ^ (unsigned long)FileName ^ (unsigned long)Line << 4 ^ Kind)%TraceTabMax;
+   AllocSite Site = pc->AllocTrace[HashValue];
+   while (Site != NULL && (Site->Chain != ChainKey || Site->Kind != Kind || Site->FileName != FileName || Site->Line != Line))
+      Site = Site->Next;
+   if (Site == NULL) {
+      Site = HeapAllocMem(pc, sizeof *Site);
+      if (Site == NULL)
+         return;
+      Site->Chain = ChainKey;
+      Site->Kind = Kind;
+      Site->FileName = FileName;
+      Site->Line = Line;
+      Site->Next = pc->AllocTrace[HashValue];
+      pc->AllocTrace[HashValue] = Site;
+   }
+   Site->Count++;
+   Site->Bytes += Size;
+}
+
+// Show what the allocation tracer has gathered, as folded stacks for flame graph tools:
+// one "callers;kind;file:line bytes" line per site.
+void PicocShowAllocTrace(State pc, OutFile Stream) {
+   static const char *KindName[AllocKindN] = { "tokens", "value", "entry", "type", "malloc" };
+   if (pc->AllocTrace == NULL)
+      return;
+   for (int Count = 0; Count < TraceTabMax; Count++) {
+      for (AllocSite Site = pc->AllocTrace[Count]; Site != NULL; Site = Site->Next)
+         PlatformPrintf(Stream, "%s;%s;%s:%d %l\n", Site->Chain, KindName[Site->Kind], Site->FileName != NULL? Site->FileName: "-", Site->Line, Site->Bytes);
+   }
+}
@@ -0,0 +1,458 @@
+// PicoC JIT:
+// This turns a function compiled by Comp.c into x86-64 machine code.
+// The code keeps the slots in memory, addressed off rbx, and works in rax, rcx, rdx, xmm0 and xmm1,
+// calling back into Comp.c for calls out and failures, and into Vec.c for element-wise loops.
+// The slots used most, of those only the operations reach, are kept in r12 to r15 instead, which the calls out leave alone;
+// and in r8 to r11 too, if there are no calls out that return.
+// It can be entered at any operation, so that Run.c can hand a loop over to it part way through.
+#include "Extern.h"
+
+#ifndef NO_COMPILER
+#if defined __x86_64__ && defined UNIX_HOST
+#include <sys/mman.h>
+
+#define OpSizeMax 48 // The most bytes of machine code any one operation makes, besides ClearC.
+#define RegMax 8 // The most slots kept in registers: r12 to r15, then r8 to r11.
+
+// A jump waiting for the address of its target.
+typedef struct JitFixup {
+   unsigned char *Pos; // Where the 32-bit displacement goes.
+   int Target; // The operation jumped to.
+} *JitFixup;
+
+// The state of the translator.
+typedef struct Jit {
+   unsigned char *Pos; // Where the next byte goes.
+   void **Offsets; // Where each operation's code starts.
+   JitFixup Fixups;
+   int NumFixups;
+   unsigned char *Reg; // The register each slot is kept in, r8 to r15, or 0 if it's in memory.
+   int NumRegs;
+   long *Uses; // The uses of each slot, weighed by the loops they're in, while they're being counted.
+   long Weight; // The weight of the operation being translated.
+} *Jit;
+
+// Put N bytes of code.
+static void Put(Jit J, int N, ...) {
+   va_list Args;
+   va_start(Args, N);
+   while (N-- > 0)
+      *J->Pos++ = va_arg(Args, int);
+   va_end(Args);
+}
+
+static void Put32(Jit J, int Word) {
+   memcpy(J->Pos, &Word, sizeof Word), J->Pos += sizeof Word;
+}
+
+static void Put64(Jit J, long Word) {
+   memcpy(J->Pos, &Word, sizeof Word), J->Pos += sizeof Word;
+}
+
+// An instruction on a slot: its opcode bytes addressing the slot as [rbx + disp32], N of them,
+// and those with the slot in a register, M of them, the last of which takes the register's number shifted up by Shift.
+typedef const struct SlotForm {
+   int N; unsigned char Mem[4];
+   int M; unsigned char Reg[5]; int Shift;
+} SlotForm[1];
+
+// Put an instruction on a slot, in memory or in its register.
+static void PutSlot(Jit J, SlotForm Form, int Slot) {
+   if (J->Uses != NULL)
+      J->Uses[Slot] += J->Weight;
+   int Reg = J->Reg[Slot];
+   if (Reg == 0) {
+      memcpy(J->Pos, Form->Mem, Form->N), J->Pos += Form->N;
+      Put32(J, Slot*(int)sizeof(union CodeSlot));
+   } else {
+      memcpy(J->Pos, Form->Reg, Form->M), J->Pos += Form->M;
+      J->Pos[-1] |= (Reg&7) << Form->Shift;
+   }
+}
+
+static SlotForm LoadRAX = {{ 3, { 0x48, 0x8b, 0x83 }, 3, { 0x4c, 0x89, 0xc0 }, 3 }}; // mov rax, [rbx + d] / mov rax, r
+static SlotForm LoadRCX = {{ 3, { 0x48, 0x8b, 0x8b }, 3, { 0x4c, 0x89, 0xc1 }, 3 }}; // mov rcx, [rbx + d] / mov rcx, r
+static SlotForm StoreRAX = {{ 3, { 0x48, 0x89, 0x83 }, 3, { 0x49, 0x89, 0xc0 }, 0 }}; // mov [rbx + d], rax / mov r, rax
+static SlotForm LoadIndex = {{ 3, { 0x48, 0x63, 0x93 }, 3, { 0x49, 0x63, 0xd0 }, 0 }}; // movsxd rdx, dword [rbx + d] / movsxd rdx, r
+static SlotForm LoadXMM0 = {{ 4, { 0xf2, 0x0f, 0x10, 0x83 }, 5, { 0x66, 0x49, 0x0f, 0x6e, 0xc0 }, 0 }}; // movsd xmm0, [rbx + d] / movq xmm0, r
+static SlotForm LoadXMM1 = {{ 4, { 0xf2, 0x0f, 0x10, 0x8b }, 5, { 0x66, 0x49, 0x0f, 0x6e, 0xc8 }, 0 }}; // movsd xmm1, [rbx + d] / movq xmm1, r
+static SlotForm StoreXMM0 = {{ 4, { 0xf2, 0x0f, 0x11, 0x83 }, 5, { 0x66, 0x49, 0x0f, 0x7e, 0xc0 }, 0 }}; // movsd [rbx + d], xmm0 / movq r, xmm0
+static SlotForm StoreImm = {{ 3, { 0x48, 0xc7, 0x83 }, 3, { 0x49, 0xc7, 0xc0 }, 0 }}; // mov qword [rbx + d], imm32 / mov r, imm32
+// Only for the slots whose addresses are taken, which are never in registers.
+static SlotForm ArgsRSI = {{ 3, { 0x48, 0x8d, 0xb3 } }}; // lea rsi, [rbx + d]
+static SlotForm ResultRDX = {{ 3, { 0x48, 0x8d, 0x93 } }}; // lea rdx, [rbx + d]
+
+static bool IsImm32(long Word) {
+   return Word == (int)Word;
+}
+
+// Convert rax to the integer type Base.
+static void Narrow(Jit J, BaseType Base) {
+   switch (Base) {
+      case IntT: Put(J, 3, 0x48, 0x63, 0xc0); break; // movsxd rax, eax
+      case ShortIntT: Put(J, 4, 0x48, 0x0f, 0xbf, 0xc0); break; // movsx rax, ax
+      case CharT: Put(J, 4, 0x48, 0x0f, 0xbe, 0xc0); break; // movsx rax, al
+      case NatT: Put(J, 2, 0x89, 0xc0); break; // mov eax, eax
+      case ShortNatT: Put(J, 3, 0x0f, 0xb7, 0xc0); break; // movzx eax, ax
+      case ByteT: Put(J, 3, 0x0f, 0xb6, 0xc0); break; // movzx eax, al
+      default: break;
+   }
+}
+
+// The size of the Base at an address.
+static int BaseSize(BaseType Base) {
+   switch (Base) {
+      case CharT: case ByteT: return 1;
+      case ShortIntT: case ShortNatT: return 2;
+      case IntT: case NatT: return 4;
+      default: return 8;
+   }
+}
+
+// Point rcx at the address K, indexed by the int in slot Index, if it's not NoSlot.
+static void Address(Jit J, CodeOp Op, int Index) {
+   Put(J, 2, 0x48, 0xb9), Put64(J, (long)Op->K.Pointer); // mov rcx, imm64
+   if (Index != -1) {
+      static const unsigned char Scale[] = { 0, 0x11, 0x51, 0, 0x91, 0, 0, 0, 0xd1 };
+      PutSlot(J, LoadIndex, Index);
+      Put(J, 3, 0x48, 0x8d, 0x0c), Put(J, 1, Scale[BaseSize(Op->Base)]); // lea rcx, [rcx + rdx*size]
+   }
+}
+
+// Load rax from the Base at rcx.
+static void Load(Jit J, BaseType Base) {
+   switch (Base) {
+      case CharT: Put(J, 4, 0x48, 0x0f, 0xbe, 0x01); break; // movsx rax, byte [rcx]
+      case ByteT: Put(J, 3, 0x0f, 0xb6, 0x01); break; // movzx eax, byte [rcx]
+      case ShortIntT: Put(J, 4, 0x48, 0x0f, 0xbf, 0x01); break; // movsx rax, word [rcx]
+      case ShortNatT: Put(J, 3, 0x0f, 0xb7, 0x01); break; // movzx eax, word [rcx]
+      case IntT: Put(J, 3, 0x48, 0x63, 0x01); break; // movsxd rax, dword [rcx]
+      case NatT: Put(J, 2, 0x8b, 0x01); break; // mov eax, [rcx]
+      default: Put(J, 3, 0x48, 0x8b, 0x01); break; // mov rax, [rcx]
+   }
+}
+
+// Store rax to the Base at rcx.
+static void Store(Jit J, BaseType Base) {
+   switch (BaseSize(Base)) {
+      case 1: Put(J, 2, 0x88, 0x01); break; // mov [rcx], al
+      case 2: Put(J, 3, 0x66, 0x89, 0x01); break; // mov [rcx], ax
+      case 4: Put(J, 2, 0x89, 0x01); break; // mov [rcx], eax
+      default: Put(J, 3, 0x48, 0x89, 0x01); break; // mov [rcx], rax
+   }
+}
+
+// Call a function in Comp.c or Vec.c.
+static void CallOut(Jit J, void (*Func)()) {
+   Put(J, 2, 0x48, 0xb8), Put64(J, (long)Func); // mov rax, imm64
+   Put(J, 2, 0xff, 0xd0); // call rax
+}
+
+// A jump, with the 32-bit displacement to fill in.
+static void Jump(Jit J, int Target) {
+   J->Fixups[J->NumFixups].Pos = J->Pos, J->Fixups[J->NumFixups].Target = Target, J->NumFixups++;
+   Put32(J, 0);
+}
+
+// Put the compare of xmm0 with xmm1 into al as a boolean, for the floating point relation Code.
+static void RatCompare(Jit J, OpCode Code) {
+   switch (Code) {
+      case FEqC: case FNotC:
+         Put(J, 4, 0x66, 0x0f, 0x2e, 0xc1); // ucomisd xmm0, xmm1
+         Put(J, 3, 0x0f, 0x94, 0xc0), Put(J, 3, 0x0f, 0x9b, 0xc1), Put(J, 2, 0x20, 0xc8); // sete al; setnp cl; and al, cl
+      break;
+      case FNeC:
+         Put(J, 4, 0x66, 0x0f, 0x2e, 0xc1); // ucomisd xmm0, xmm1
+         Put(J, 3, 0x0f, 0x95, 0xc0), Put(J, 3, 0x0f, 0x9a, 0xc1), Put(J, 2, 0x08, 0xc8); // setne al; setp cl; or al, cl
+      break;
+      case FGtC: Put(J, 4, 0x66, 0x0f, 0x2e, 0xc1), Put(J, 3, 0x0f, 0x97, 0xc0); break; // ucomisd xmm0, xmm1; seta al
+      case FGeC: Put(J, 4, 0x66, 0x0f, 0x2e, 0xc1), Put(J, 3, 0x0f, 0x93, 0xc0); break; // ucomisd xmm0, xmm1; setae al
+      case FLtC: Put(J, 4, 0x66, 0x0f, 0x2e, 0xc8), Put(J, 3, 0x0f, 0x97, 0xc0); break; // ucomisd xmm1, xmm0; seta al
+      case FLeC: Put(J, 4, 0x66, 0x0f, 0x2e, 0xc8), Put(J, 3, 0x0f, 0x93, 0xc0); break; // ucomisd xmm1, xmm0; setae al
+      default: break;
+   }
+   Put(J, 3, 0x0f, 0xb6, 0xc0); // movzx eax, al
+}
+
+// Translate an operation.
+static void Translate(Jit J, CodeOp Op) {
+   switch ((OpCode)Op->Code) {
+      case NopC: break;
+      case ClearC:
+         if (Op->A < Op->B) {
+            Put(J, 2, 0x31, 0xc0); // xor eax, eax
+            for (int Slot = Op->A; Slot < Op->B; Slot++)
+               PutSlot(J, StoreRAX, Slot);
+         }
+      break;
+      case MovKC:
+         if (IsImm32(Op->K.Integer))
+            PutSlot(J, StoreImm, Op->A), Put32(J, Op->K.Integer);
+         else
+            Put(J, 2, 0x48, 0xb8), Put64(J, Op->K.Integer), PutSlot(J, StoreRAX, Op->A); // mov rax, imm64
+      break;
+      case MovC: case ConvC:
+         PutSlot(J, LoadRAX, Op->B);
+         if (Op->Code == ConvC)
+            Narrow(J, Op->Base);
+         PutSlot(J, StoreRAX, Op->A);
+      break;
+      case FloatC:
+         PutSlot(J, LoadRAX, Op->B);
+         Put(J, 5, 0xf2, 0x48, 0x0f, 0x2a, 0xc0); // cvtsi2sd xmm0, rax
+         PutSlot(J, StoreXMM0, Op->A);
+      break;
+      case FixC:
+         PutSlot(J, LoadXMM0, Op->B);
+         Put(J, 5, 0xf2, 0x48, 0x0f, 0x2c, 0xc0); // cvttsd2si rax, xmm0
+         PutSlot(J, StoreRAX, Op->A);
+      break;
+      case AddC: case SubC: case MulC: case DivC: case ModC: case ShLC: case ShRC: case AndC: case OrC: case XOrC:
+         PutSlot(J, LoadRAX, Op->B), PutSlot(J, LoadRCX, Op->C);
+         switch (Op->Code) {
+            case AddC: Put(J, 3, 0x48, 0x01, 0xc8); break; // add rax, rcx
+            case SubC: Put(J, 3, 0x48, 0x29, 0xc8); break; // sub rax, rcx
+            case MulC: Put(J, 4, 0x48, 0x0f, 0xaf, 0xc1); break; // imul rax, rcx
+            case DivC: Put(J, 2, 0x48, 0x99), Put(J, 3, 0x48, 0xf7, 0xf9); break; // cqo; idiv rcx
+            case ModC: Put(J, 2, 0x48, 0x99), Put(J, 3, 0x48, 0xf7, 0xf9), Put(J, 3, 0x48, 0x89, 0xd0); break; // cqo; idiv rcx; mov rax, rdx
+            case ShLC: Put(J, 3, 0x48, 0xd3, 0xe0); break; // shl rax, cl
+            case ShRC: Put(J, 3, 0x48, 0xd3, 0xf8); break; // sar rax, cl
+            case AndC: Put(J, 3, 0x48, 0x21, 0xc8); break; // and rax, rcx
+            case OrC: Put(J, 3, 0x48, 0x09, 0xc8); break; // or rax, rcx
+            default: Put(J, 3, 0x48, 0x31, 0xc8); break; // xor rax, rcx
+         }
+         Narrow(J, Op->Base);
+         PutSlot(J, StoreRAX, Op->A);
+      break;
+      case AddKC:
+         PutSlot(J, LoadRAX, Op->B);
+         if (IsImm32(Op->K.Integer))
+            Put(J, 2, 0x48, 0x05), Put32(J, Op->K.Integer); // add rax, imm32
+         else
+            Put(J, 2, 0x48, 0xb9), Put64(J, Op->K.Integer), Put(J, 3, 0x48, 0x01, 0xc8); // mov rcx, imm64; add rax, rcx
+         Narrow(J, Op->Base);
+         PutSlot(J, StoreRAX, Op->A);
+      break;
+      case NegC: case CplC:
+         PutSlot(J, LoadRAX, Op->B);
+         Put(J, 3, 0x48, 0xf7, Op->Code == NegC? 0xd8: 0xd0); // neg rax / not rax
+         Narrow(J, Op->Base);
+         PutSlot(J, StoreRAX, Op->A);
+      break;
+      case NotC:
+         PutSlot(J, LoadRAX, Op->B);
+         Put(J, 3, 0x48, 0x85, 0xc0), Put(J, 3, 0x0f, 0x94, 0xc0), Put(J, 3, 0x0f, 0xb6, 0xc0); // test rax, rax; sete al; movzx eax, al
+         PutSlot(J, StoreRAX, Op->A);
+      break;
+      case EqC: case NeC: case LtC: case GtC: case LeC: case GeC: {
+         static const unsigned char SetCC[] = { 0x94, 0x95, 0x9c, 0x9f, 0x9e, 0x9d }; // sete, setne, setl, setg, setle, setge
+         PutSlot(J, LoadRAX, Op->B), PutSlot(J, LoadRCX, Op->C);
+         Put(J, 3, 0x48, 0x39, 0xc8); // cmp rax, rcx
+         Put(J, 3, 0x0f, SetCC[Op->Code - EqC], 0xc0), Put(J, 3, 0x0f, 0xb6, 0xc0); // setcc al; movzx eax, al
+         PutSlot(J, StoreRAX, Op->A);
+      }
+      break;
+#ifndef NO_FP
+      case FAddC: case FSubC: case FMulC: case FDivC: {
+         static const unsigned char Arith[] = { 0x58, 0x5c, 0x59, 0x5e }; // addsd, subsd, mulsd, divsd
+         PutSlot(J, LoadXMM0, Op->B), PutSlot(J, LoadXMM1, Op->C);
+         Put(J, 4, 0xf2, 0x0f, Arith[Op->Code - FAddC], 0xc1); // op xmm0, xmm1
+         PutSlot(J, StoreXMM0, Op->A);
+      }
+      break;
+      case FNegC:
+         PutSlot(J, LoadRAX, Op->B);
+         Put(J, 5, 0x48, 0x0f, 0xba, 0xf8, 0x3f); // btc rax, 63
+         PutSlot(J, StoreRAX, Op->A);
+      break;
+      case FNotC:
+         PutSlot(J, LoadXMM0, Op->B);
+         Put(J, 4, 0x66, 0x0f, 0x57, 0xc9); // xorpd xmm1, xmm1
+         RatCompare(J, FNotC);
+         Put(J, 5, 0xf2, 0x48, 0x0f, 0x2a, 0xc0); // cvtsi2sd xmm0, rax
+         PutSlot(J, StoreXMM0, Op->A);
+      break;
+      case FEqC: case FNeC: case FLtC: case FGtC: case FLeC: case FGeC:
+         PutSlot(J, LoadXMM0, Op->B), PutSlot(J, LoadXMM1, Op->C);
+         RatCompare(J, Op->Code);
+         PutSlot(J, StoreRAX, Op->A);
+      break;
+#endif
+      case LoadC: case LoadXC:
+         Address(J, Op, Op->Code == LoadXC? Op->B: -1);
+         Load(J, Op->Base);
+         PutSlot(J, StoreRAX, Op->A);
+      break;
+      case StoreC: case StoreXC:
+         PutSlot(J, LoadRAX, Op->A);
+         Address(J, Op, Op->Code == StoreXC? Op->B: -1);
+         Store(J, Op->Base);
+      break;
+      case JmpC: Put(J, 1, 0xe9), Jump(J, Op->K.Integer); break; // jmp rel32
+      case JzC: case JnzC:
+         PutSlot(J, LoadRAX, Op->A);
+         Put(J, 3, 0x48, 0x85, 0xc0); // test rax, rax
+         Put(J, 2, 0x0f, Op->Code == JzC? 0x84: 0x85), Jump(J, Op->K.Integer); // jz/jnz rel32
+      break;
+      case JEqC: case JNeC: case JLtC: case JGeC: case JGtC: case JLeC: {
+         static const unsigned char JumpCC[] = { 0x84, 0x85, 0x8c, 0x8d, 0x8f, 0x8e }; // je, jne, jl, jge, jg, jle
+         PutSlot(J, LoadRAX, Op->B), PutSlot(J, LoadRCX, Op->C);
+         Put(J, 3, 0x48, 0x39, 0xc8); // cmp rax, rcx
+         Put(J, 2, 0x0f, JumpCC[Op->Code - JEqC]), Jump(J, Op->K.Integer); // jcc rel32
+      }
+      break;
+      case LoopC:
+         PutSlot(J, LoadRAX, Op->A);
+         Put(J, 4, 0x48, 0x83, 0xc0, 0x01); // add rax, 1
+         Narrow(J, Op->Base);
+         PutSlot(J, StoreRAX, Op->A), PutSlot(J, LoadRCX, Op->C);
+         Put(J, 3, 0x48, 0x39, 0xc8); // cmp rax, rcx
+         Put(J, 2, 0x0f, 0x8c), Jump(J, Op->K.Integer); // jl rel32
+      break;
+      case VecC:
+         Put(J, 2, 0x48, 0xbf), Put64(J, (long)Op->K.Pointer); // mov rdi, imm64
+         Put(J, 3, 0x48, 0x89, 0xde); // mov rsi, rbx
+         CallOut(J, (void (*)())VecRun);
+      break;
+      case CallC:
+      case TailCallC:
+         Put(J, 2, 0x48, 0xbf), Put64(J, (long)Op->K.Pointer); // mov rdi, imm64
+         PutSlot(J, ArgsRSI, Op->B);
+#ifdef TAIL_CALLS
+         if (Op->Code == TailCallC) {
+            CallOut(J, (void (*)())CompileTailCall);
+            break;
+         }
+#endif
+         if (Op->A == NoSlot)
+            Put(J, 2, 0x31, 0xd2); // xor edx, edx
+         else
+            PutSlot(J, ResultRDX, Op->A);
+         CallOut(J, (void (*)())CompileCall);
+      break;
+      case FailC:
+         Put(J, 2, 0x48, 0xbf), Put64(J, (long)Op->K.Pointer); // mov rdi, imm64
+         CallOut(J, (void (*)())CompileFail);
+      // Fall through: it doesn't return.
+      case RetC:
+         if (J->NumRegs > 0)
+            Put(J, 8, 0x41, 0x5f, 0x41, 0x5e, 0x41, 0x5d, 0x41, 0x5c); // pop r15; pop r14; pop r13; pop r12
+         Put(J, 2, 0x5b, 0xc3); // pop rbx; ret
+      break;
+      default: break;
+   }
+}
+
+// The weight of operation N, for counting the uses of the slots: a use in a loop counts for more.
+static long Weight(CodeFunc Code, int N) {
+   long Weight = 1;
+   for (CodeEntry Loop = Code->Entries; Loop != NULL; Loop = Loop->Next) {
+      if (Loop->Top <= N && N < Loop->End && Weight < 0x1000)
+         Weight *= 8;
+   }
+   return Weight;
+}
+
+// Translate the operations into Mem, after code to save the registers used, load the slots kept in them, and go to the operation to start at.
+static void TranslateOps(Jit J, CodeFunc Code, unsigned char *Mem) {
+   J->Pos = Mem, J->NumFixups = 0;
+   Put(J, 1, 0x53); // push rbx
+   if (J->NumRegs > 0)
+      Put(J, 8, 0x41, 0x54, 0x41, 0x55, 0x41, 0x56, 0x41, 0x57); // push r12; push r13; push r14; push r15
+   Put(J, 3, 0x48, 0x89, 0xfb); // mov rbx, rdi
+   for (int Slot = 0; Slot < Code->NumSlots; Slot++) {
+      if (J->Reg[Slot] != 0)
+         Put(J, 3, 0x4c, 0x8b, 0x83 | (J->Reg[Slot]&7) << 3), Put32(J, Slot*(int)sizeof(union CodeSlot)); // mov r, [rbx + d]
+   }
+   Put(J, 2, 0xff, 0xe6); // jmp rsi
+   for (int N = 0; N < Code->NumOps; N++) {
+      J->Offsets[N] = J->Pos, J->Weight = Weight(Code, N);
+      Translate(J, &Code->Ops[N]);
+   }
+}
+
+// Translate a compiled function into machine code.
+// Return false if it can't be.
+bool JitTranslate(State pc, CodeFunc Code) {
+   int Size = 0x40 + Code->NumOps*OpSizeMax;
+   for (CodeOp Op = Code->Ops; Op < Code->Ops + Code->NumOps; Op++) {
+      if (Op->Code == ClearC && Op->A < Op->B)
+         Size += 7*(Op->B - Op->A);
+   }
+   long PageSize = sysconf(_SC_PAGESIZE);
+   Size = (Size + PageSize - 1)/PageSize*PageSize;
+   struct Jit JS;
+   Jit J = &JS;
+   J->Offsets = HeapAllocMem(pc, Code->NumOps*sizeof *J->Offsets);
+   J->Fixups = HeapAllocMem(pc, Code->NumOps*sizeof *J->Fixups);
+   J->Reg = HeapAllocMem(pc, Code->NumSlots*sizeof *J->Reg);
+   long *Uses = HeapAllocMem(pc, Code->NumSlots*sizeof *Uses);
+   J->NumRegs = 0;
+   unsigned char *Mem = mmap(NULL, Size, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+   bool Ok = J->Offsets != NULL && J->Fixups != NULL && J->Reg != NULL && Uses != NULL && Mem != MAP_FAILED;
+   if (Ok) {
+   // Count the uses of the slots, translating once with them all in memory; then translate again, with those used most in registers.
+      J->Uses = Uses;
+      TranslateOps(J, Code, Mem);
+      J->Uses = NULL;
+      bool Calls = false;
+      for (CodeOp Op = Code->Ops; Op < Code->Ops + Code->NumOps; Op++)
+         Calls |= Op->Code == CallC || Op->Code == TailCallC || Op->Code == VecC;
+      for (; J->NumRegs < (Calls? RegMax/2: RegMax); J->NumRegs++) {
+         int Most = -1;
+         for (int Slot = 0; Slot < Code->NumSlots; Slot++) {
+            if (!Code->Addressed[Slot] && J->Reg[Slot] == 0 && Uses[Slot] > 1 && (Most < 0 || Uses[Slot] > Uses[Most]))
+               Most = Slot;
+         }
+         if (Most < 0)
+            break;
+         J->Reg[Most] = J->NumRegs < RegMax/2? 12 + J->NumRegs: 8 + J->NumRegs - RegMax/2;
+      }
+      TranslateOps(J, Code, Mem);
+      for (JitFixup Fix = J->Fixups; Fix < J->Fixups + J->NumFixups; Fix++) {
+         int Disp = (unsigned char *)J->Offsets[Fix->Target] - (Fix->Pos + 4);
+         memcpy(Fix->Pos, &Disp, sizeof Disp);
+      }
+      Ok = mprotect(Mem, Size, PROT_READ|PROT_EXEC) == 0;
+   }
+   if (J->Fixups != NULL)
+      HeapFreeMem(pc, J->Fixups);
+   if (J->Reg != NULL)
+      HeapFreeMem(pc, J->Reg);
+   if (Uses != NULL)
+      HeapFreeMem(pc, Uses);
+   if (!Ok) {
+      if (J->Offsets != NULL)
+         HeapFreeMem(pc, J->Offsets);
+      if (Mem != MAP_FAILED)
+         munmap(Mem, Size);
+      return false;
+   }
+   union { void *Mem; void (*Native)(CodeSlot Slots, void *Start); } Entry;
+   Entry.Mem = Mem;
+   Code->Native = Entry.Native;
+   Code->NativeOps = J->Offsets;
+   Code->NativeSize = Size;
+   return true;
+}
+
+// Free a function's machine code.
+void JitFree(State pc, CodeFunc Code) {
+   if (Code->Native != NULL) {
+      union { void *Mem; void (*Native)(CodeSlot Slots, void *Start); } Entry;
+      Entry.Native = Code->Native;
+      munmap(Entry.Mem, Code->NativeSize);
+      HeapFreeMem(pc, Code->NativeOps);
+      Code->Native = NULL, Code->NativeOps = NULL;
+   }
+}
+#else
+// No machine code for this host: compiled code is run by Run.c.
+bool JitTranslate(State pc, CodeFunc Code) {
+   return false;
+}
+
+void JitFree(State pc, CodeFunc Code) {
+}
+#endif
+#endif
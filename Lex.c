@@ -455,6 +455,8 @@ static void *LexTokenize(State pc, LexState Lexer, int *TokenLen) {
    void *HeapMem = HeapAllocMem(pc, MemUsed);
    if (HeapMem == NULL)
       LexError(pc, Lexer, "out of memory");
+   if (pc->AllocTrace != NULL)
+      HeapTrace(pc, TokensA, Lexer->FileName, 0, MemUsed);
    assert(ReserveSpace >= MemUsed);
    memcpy(HeapMem, TokenSpace, MemUsed);
    HeapPopStack(pc, TokenSpace, ReserveSpace);
@@ -767,8 +769,119 @@ void *LexCopyTokens(ParseState StartParser, ParseState EndParser) {
    return NewTokens;
 }
 
+// Get the next token and return its size in the token stream, copying it to *ToP if ToP isn't NULL.
+static int LexCopyToken(ParseState Parser, Lexical *TokenP, unsigned char **ToP) {
+   Lexical Token = LexGetToken(Parser, NULL, true);
+   int Size = TokenDataOffset + LexTokenSize(Token);
+   if (Token == EofL || Token == EndFnL)
+      ProgramFail(Parser, "')' expected");
+   if (ToP != NULL)
+      memcpy(*ToP, Parser->Pos - Size, Size), *ToP += Size;
+   *TokenP = Token;
+   return Size;
+}
+
+// Expand a call to a parameterized macro, with Parser just past the call's open bracket.
+// The argument tokens are spliced into the body in place of its parameters, once for each call site.
+// Later calls from the same site reuse the expansion.
+// Return the expanded tokens and move Parser past the call's close bracket.
+const unsigned char *LexExpandMacro(ParseState Parser, const char *MacroName, MacroDef MDef) {
+   State pc = Parser->pc;
+   const unsigned char *Site = Parser->Pos;
+   int HashValue = (unsigned long)Site%ExpTabMax;
+   for (MacroExpansion Expansion = pc->ExpansionHashTable[HashValue]; Expansion != NULL; Expansion = Expansion->Next) {
+      if (Expansion->Site == Site) {
+         ParserCopyPos(Parser, &Expansion->After);
+         return Expansion->Tokens;
+      }
+   }
+// Find where each argument starts and how many bytes of tokens it has.
+   struct ParseCursor ArgStart[ParameterMax];
+   int ArgSize[ParameterMax];
+   int ArgCount = 0;
+   ParserCopyPos(&ArgStart[0], Parser);
+   ArgSize[0] = 0;
+   for (int Depth = 0; ; ) {
+      Lexical Token;
+      int Size = LexCopyToken(Parser, &Token, NULL);
+      if (Depth == 0 && (Token == CommaL || Token == RParL)) {
+         if (Token == RParL && ArgCount == 0 && ArgSize[0] == 0)
+            break; // No arguments.
+         if (++ArgCount > MDef->NumParams)
+            ProgramFail(Parser, "too many arguments to %s()", MacroName);
+         if (Token == RParL)
+            break;
+         ParserCopyPos(&ArgStart[ArgCount], Parser);
+         ArgSize[ArgCount] = 0;
+      } else {
+         if (Token == LParL)
+            Depth++;
+         else if (Token == RParL)
+            Depth--;
+         ArgSize[ArgCount] += Size;
+      }
+   }
+   if (ArgCount < MDef->NumParams)
+      ProgramFail(Parser, "not enough arguments to '%s'", MacroName);
+   if (MDef->Body.Pos == NULL)
+      ProgramFail(Parser, "'%s' is undefined", MacroName);
+// Size the expansion.
+   struct ParseState BodyParser;
+   ParserCopy(&BodyParser, &MDef->Body);
+   int ExpansionSize = 0;
+   Lexical Token;
+   Value LexValue;
+   while ((Token = LexGetRawToken(&BodyParser, &LexValue, true)) != EndFnL) {
+      int Param = MDef->NumParams;
+      if (Token == IdL)
+         for (Param = 0; Param < MDef->NumParams && MDef->ParamName[Param] != LexValue->Val->Identifier; Param++);
+      ExpansionSize += Param < MDef->NumParams? ArgSize[Param]: TokenDataOffset + LexTokenSize(Token);
+   }
+   MacroExpansion Expansion = HeapAllocMem(pc, sizeof *Expansion + ExpansionSize);
+   if (Expansion == NULL)
+      ProgramFail(Parser, "out of memory");
+   if (pc->AllocTrace != NULL)
+      HeapTrace(pc, TokensA, Parser->FileName, Parser->Line, sizeof *Expansion + ExpansionSize);
+// Splice the arguments into the body.
+   unsigned char *To = Expansion->Tokens;
+   ParserCopy(&BodyParser, &MDef->Body);
+   while ((Token = LexGetRawToken(&BodyParser, &LexValue, true)) != EndFnL) {
+      int Param = MDef->NumParams;
+      if (Token == IdL)
+         for (Param = 0; Param < MDef->NumParams && MDef->ParamName[Param] != LexValue->Val->Identifier; Param++);
+      if (Param < MDef->NumParams) {
+         struct ParseState ArgParser;
+         ParserCopy(&ArgParser, Parser);
+         ParserCopyPos(&ArgParser, &ArgStart[Param]);
+         for (int Left = ArgSize[Param]; Left > 0; )
+            Left -= LexCopyToken(&ArgParser, &Token, &To);
+      } else {
+         int Size = TokenDataOffset + LexTokenSize(Token);
+         memcpy(To, BodyParser.Pos - Size, Size), To += Size;
+      }
+   }
+   To[0] = (unsigned char)EndFnL, To[1] = 0;
+   Expansion->Site = Site;
+   ParserCopyPos(&Expansion->After, Parser);
+   Expansion->Next = pc->ExpansionHashTable[HashValue];
+   pc->ExpansionHashTable[HashValue] = Expansion;
+   return Expansion->Tokens;
+}
+
+// Free the macro expansions: the call sites they're kept for may be in token buffers which are about to go.
+void LexForgetExpansions(State pc) {
+   for (int Count = 0; Count < ExpTabMax; Count++) {
+      while (pc->ExpansionHashTable[Count] != NULL) {
+         MacroExpansion Next = pc->ExpansionHashTable[Count]->Next;
+         HeapFreeMem(pc, pc->ExpansionHashTable[Count]);
+         pc->ExpansionHashTable[Count] = Next;
+      }
+   }
+}
+
 // Indicate that we've completed up to this point in the interactive input and free expired tokens.
 void LexInteractiveClear(State pc, ParseState Parser) {
+   LexForgetExpansions(pc);
    while (pc->InteractiveHead != NULL) {
       TokenLine NextLine = pc->InteractiveHead->Next;
       HeapFreeMem(pc, pc->InteractiveHead->Tokens);
@@ -784,6 +897,7 @@ void LexInteractiveClear(State pc, ParseState Parser) {
 void LexInteractiveCompleted(State pc, ParseState Parser) {
    while (pc->InteractiveHead != NULL && !(Parser->Pos >= pc->InteractiveHead->Tokens && Parser->Pos < &pc->InteractiveHead->Tokens[pc->InteractiveHead->NumBytes])) {
    // This token line is no longer needed - free it.
+      LexForgetExpansions(pc);
       TokenLine NextLine = pc->InteractiveHead->Next;
       HeapFreeMem(pc, pc->InteractiveHead->Tokens);
       HeapFreeMem(pc, pc->InteractiveHead);
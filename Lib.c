@@ -356,17 +356,23 @@ static void LibFloor(ParseState Parser, Value ReturnValue, Value *Param, int Num
 #ifndef NO_STRING_FUNCTIONS
 static void LibMalloc(ParseState Parser, Value ReturnValue, Value *Param, int NumArgs) {
    ReturnValue->Val->Pointer = malloc(Param[0]->Val->Integer);
+   if (Parser->pc->AllocTrace != NULL)
+      HeapTrace(Parser->pc, UserA, Parser->FileName, Parser->Line, Param[0]->Val->Integer);
 }
 
 #   ifndef NO_CALLOC
 static void LibCalloc(ParseState Parser, Value ReturnValue, Value *Param, int NumArgs) {
    ReturnValue->Val->Pointer = calloc(Param[0]->Val->Integer, Param[1]->Val->Integer);
+   if (Parser->pc->AllocTrace != NULL)
+      HeapTrace(Parser->pc, UserA, Parser->FileName, Parser->Line, Param[0]->Val->Integer*Param[1]->Val->Integer);
 }
 #   endif
 
 #   ifndef NO_REALLOC
 static void LibRealloc(ParseState Parser, Value ReturnValue, Value *Param, int NumArgs) {
    ReturnValue->Val->Pointer = realloc(Param[0]->Val->Pointer, Param[1]->Val->Integer);
+   if (Parser->pc->AllocTrace != NULL)
+      HeapTrace(Parser->pc, UserA, Parser->FileName, Parser->Line, Param[1]->Val->Integer);
 }
 #   endif
 
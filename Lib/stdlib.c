@@ -36,14 +36,20 @@ void StdlibStrtoul(ParseState Parser, Value ReturnValue, Value *Param, int NumAr
 
 void StdlibMalloc(ParseState Parser, Value ReturnValue, Value *Param, int NumArgs) {
    ReturnValue->Val->Pointer = malloc(Param[0]->Val->Integer);
+   if (Parser->pc->AllocTrace != NULL)
+      HeapTrace(Parser->pc, UserA, Parser->FileName, Parser->Line, Param[0]->Val->Integer);
 }
 
 void StdlibCalloc(ParseState Parser, Value ReturnValue, Value *Param, int NumArgs) {
    ReturnValue->Val->Pointer = calloc(Param[0]->Val->Integer, Param[1]->Val->Integer);
+   if (Parser->pc->AllocTrace != NULL)
+      HeapTrace(Parser->pc, UserA, Parser->FileName, Parser->Line, Param[0]->Val->Integer*Param[1]->Val->Integer);
 }
 
 void StdlibRealloc(ParseState Parser, Value ReturnValue, Value *Param, int NumArgs) {
    ReturnValue->Val->Pointer = realloc(Param[0]->Val->Pointer, Param[1]->Val->Integer);
+   if (Parser->pc->AllocTrace != NULL)
+      HeapTrace(Parser->pc, UserA, Parser->FileName, Parser->Line, Param[1]->Val->Integer);
 }
 
 void StdlibFree(ParseState Parser, Value ReturnValue, Value *Param, int NumArgs) {
@@ -11,6 +11,38 @@
 #   include <stdio.h>
 #   include <string.h>
 
+// Show a report, if the environment variable Name is set: into the file it names, or to stderr if it's empty.
+static void ShowReport(State pc, const char *Name, void (*Show)(State pc, OutFile Stream)) {
+   char *File = getenv(Name);
+   if (File != NULL) {
+      FILE *Out = *File == '\0'? stderr: fopen(File, "w");
+      if (Out != NULL) {
+         Show(pc, Out);
+         if (Out != stderr)
+            fclose(Out);
+      }
+   }
+}
+
+// Report on the heap, the traced allocations, the traced loops, the compiled loops and the inlined calls, if asked to.
+static void ShowReports(State pc) {
+   if (getenv("HEAPSTATS") != NULL)
+      PicocShowHeapStats(pc, stderr);
+   ShowReport(pc, "ALLOCTRACE", PicocShowAllocTrace);
+   ShowReport(pc, "LOOPTRACE", PicocShowTraces);
+   ShowReport(pc, "LOOPREPORT", PicocShowLoops);
+   ShowReport(pc, "INLINEREPORT", PicocShowInlining);
+}
+
+// After cleanup, report how many heap allocations weren't freed, if asked to with HEAPSTATS: none, unless something leaks, or ARENA is set.
+static void ShowUnfreed(State pc) {
+   if (getenv("HEAPSTATS") != NULL) {
+      struct HeapStats Stats;
+      PicocGetHeapStats(pc, &Stats);
+      fprintf(stderr, "heap: %ld allocations not freed at cleanup\n", Stats.Allocs - Stats.Frees);
+   }
+}
+
 int main(int AC, char **AV) {
    char *App = AC < 1? NULL: AV[1]; if (App == NULL || *App == '\0') App = "PicoC";
    if (AC < 2) {
@@ -23,7 +55,25 @@ int main(int AC, char **AV) {
       exit(1);
    }
    struct State pc;
-   PicocInitialize(&pc, getenv("STACKSIZE")? atoi(getenv("STACKSIZE")): 0x20000);
+   int StackSize = getenv("STACKSIZE")? atoi(getenv("STACKSIZE")): 0x20000;
+// ARENA= has the interpreter's memory released in bulk at the end.
+   if (getenv("ARENA") != NULL)
+      PicocInitializeArena(&pc, StackSize);
+   else
+      PicocInitialize(&pc, StackSize);
+   if (getenv("ALLOCTRACE") != NULL)
+      PicocTraceAllocs(&pc, true);
+// LOOPTRACE= lists the loops traced in compiled code, so compilation is turned on for it, as JIT does.
+   if (getenv("LOOPTRACE") != NULL)
+      PicocTraceLoops(&pc, true), PicocEnableJit(&pc, true);
+   char *Jit = getenv("JIT");
+   if (Jit != NULL) {
+   // JIT=<CompileAfter>,<NativeAfter> sets the tiers, as well.
+      int CompileAfter, NativeAfter;
+      PicocEnableJit(&pc, true);
+      if (sscanf(Jit, "%d,%d", &CompileAfter, &NativeAfter) == 2)
+         PicocSetJitTiers(&pc, CompileAfter, NativeAfter);
+   }
    int A = 1;
    bool DontRunMain = strcmp(AV[A], "-s") == 0 || strcmp(AV[A], "-m") == 0;
    if (DontRunMain) {
@@ -35,15 +85,23 @@ int main(int AC, char **AV) {
       PicocParseInteractive(&pc);
    } else {
       if (PicocPlatformSetExitPoint(&pc)) {
+         ShowReports(&pc);
          PicocCleanup(&pc);
+         ShowUnfreed(&pc);
          return pc.PicocExitValue;
       }
       for (; A < AC && strcmp(AV[A], "-") != 0; A++)
          PicocPlatformScanFile(&pc, AV[A]);
-      if (!DontRunMain)
+      if (!DontRunMain) {
+      // AOT=<Source.c> keeps the C translation of the program in Source.c.
+         if (getenv("AOT") != NULL && !PicocTranslateProgram(&pc, getenv("AOT")))
+            fprintf(stderr, "AOT: couldn't translate the program to C, build it and load it, so it's run as usual\n");
          PicocCallMain(&pc, AC - A, &AV[A]);
+      }
    }
+   ShowReports(&pc);
    PicocCleanup(&pc);
+   ShowUnfreed(&pc);
    return pc.PicocExitValue;
 }
 #else
@@ -35,6 +35,7 @@ void PicocParseInteractive(State pc);
 
 // Sys.c:
 void PicocInitialize(State pc, int StackSize);
+void PicocInitializeArena(State pc, int StackSize);
 void PicocCleanup(State pc);
 void PicocCallMain(State pc, int AC, char **AV);
 // Defined in the following places:
@@ -48,4 +49,23 @@ void PicocPlatformScanFile(State pc, const char *FileName);
 // Inc.c:
 void PicocIncludeAllSystemHeaders(State pc);
 
+// Comp.c:
+void PicocEnableJit(State pc, bool On);
+void PicocSetJitTiers(State pc, int CompileAfter, int NativeAfter);
+void PicocShowLoops(State pc, OutFile Stream);
+void PicocShowInlining(State pc, OutFile Stream);
+
+// Run.c:
+void PicocTraceLoops(State pc, bool On);
+void PicocShowTraces(State pc, OutFile Stream);
+
+// Aot.c:
+bool PicocTranslateProgram(State pc, const char *Source);
+
+// Heap.c:
+void PicocGetHeapStats(State pc, HeapStats Stats);
+void PicocShowHeapStats(State pc, OutFile Stream);
+void PicocTraceAllocs(State pc, bool On);
+void PicocShowAllocTrace(State pc, OutFile Stream);
+
 #endif // MAIN_H.
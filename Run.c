@@ -0,0 +1,426 @@
+// PicoC compiled code interpreter:
+// This runs a function compiled by Comp.c one operation at a time, on any host,
+// until it's been run enough to be worth translating into machine code by Jit.c.
+// It works exactly as the machine code does, so the two can take over from each other in the middle of a loop.
+#include "Extern.h"
+
+#ifndef NO_COMPILER
+// Convert an integer to the integer type Base.
+static long Narrow(long Integer, BaseType Base) {
+   switch (Base) {
+      case IntT: return (int)Integer;
+      case ShortIntT: return (short)Integer;
+      case CharT: return (signed char)Integer;
+      case NatT: return (unsigned)Integer;
+      case ShortNatT: return (unsigned short)Integer;
+      case ByteT: return (unsigned char)Integer;
+      default: return Integer;
+   }
+}
+
+// The size of the Base at an address.
+static int BaseSize(BaseType Base) {
+   switch (Base) {
+      case CharT: case ByteT: return 1;
+      case ShortIntT: case ShortNatT: return 2;
+      case IntT: case NatT: return 4;
+      default: return 8;
+   }
+}
+
+// The address of the Base at address K, indexed by the int in slot B for LoadXC and StoreXC.
+static char *Address(CodeOp Op, CodeSlot Slots) {
+   char *Addr = Op->K.Pointer;
+   if (Op->Code == LoadXC || Op->Code == StoreXC)
+      Addr += (int)Slots[Op->B].Integer*BaseSize(Op->Base);
+   return Addr;
+}
+
+// Direct threading: each operation ends in a jump of its own to the handler of the next, through the handler's address,
+// which is looked up once for each operation, before the function's first run.
+// That needs labels as values, which GCC and Clang have; other compilers, such as MSVC, dispatch through a switch.
+#if defined __GNUC__ && !defined NO_THREADING
+#   define THREADED
+#endif
+
+// A trace of one iteration of a loop: the operations done, in order, from the loop's head around to its jump back.
+// Each conditional jump on the way is replaced by a guard: a jump out of the trace, to where the loop goes if it doesn't go the same way again.
+struct CodeTrace {
+   CodeTrace Next;
+   int Head; // The operation the loop starts at.
+   int Count; // The times it's been around, before it's traced.
+   bool Recording; // Set while it's being traced.
+   bool Ready; // Set once it's been traced.
+   bool Failed; // Set if it couldn't be traced: it returned, or went into an inner loop, or was too long.
+   long Runs, Iterations; // The times the trace has been entered, and gone around.
+   int NumOps;
+   struct CodeOp Ops[TraceOpMax];
+#ifdef THREADED
+   void *Thread[TraceOpMax]; // The handler of each operation.
+#endif
+};
+
+// The names of the operations, for the trace dump.
+// NOTE: the order of this array must correspond exactly to the order of the operations in OpCode.
+static const char *OpName[] = {
+   "Nop", "Clear", "MovK", "Mov", "Conv", "Float", "Fix",
+   "Add", "Sub", "Mul", "Div", "Mod", "ShL", "ShR", "And", "Or", "XOr",
+   "AddK", "Neg", "Cpl", "Not",
+   "Eq", "Ne", "Lt", "Gt", "Le", "Ge",
+   "FAdd", "FSub", "FMul", "FDiv", "FNeg", "FNot",
+   "FEq", "FNe", "FLt", "FGt", "FLe", "FGe",
+   "Load", "LoadX", "Store", "StoreX",
+   "Jmp", "ExitIfZero", "ExitIfNonZero", // In a trace, the conditional jumps are guards.
+   "ExitIfEq", "ExitIfNe", "ExitIfLt", "ExitIfGe", "ExitIfGt", "ExitIfLe", "Loop", "Vec",
+   "Call", "TailCall", "Ret", "Fail"
+};
+
+// Find the trace of the loop at Head, counting an iteration toward tracing it.
+// Return it if it's ready to be run, or to be recorded from now, else NULL.
+static CodeTrace TraceFind(State pc, CodeFunc Code, int Head) {
+   CodeTrace Trace = Code->Traces;
+   while (Trace != NULL && Trace->Head != Head)
+      Trace = Trace->Next;
+   if (Trace == NULL) {
+      if ((Trace = HeapAllocMem(pc, sizeof *Trace)) == NULL)
+         return NULL;
+      Trace->Head = Head;
+      Trace->Next = Code->Traces, Code->Traces = Trace;
+   }
+   if (Trace->Ready)
+      return Trace;
+   if (Trace->Failed || Trace->Recording || ++Trace->Count < TraceAfterMin)
+      return NULL;
+   Trace->Recording = true, Trace->NumOps = 0;
+   return Trace;
+}
+
+// Give up on recording a trace.
+// Return NULL, for the trace now being recorded.
+static CodeTrace TraceFail(CodeTrace Trace) {
+   Trace->Recording = false, Trace->Failed = true;
+   return NULL;
+}
+
+// Add an operation to the trace being recorded.
+// Return the trace, or NULL if it's too long, and so has failed.
+static CodeTrace TraceAdd(CodeTrace Trace, CodeOp Op) {
+   if (Trace->NumOps == TraceOpMax)
+      return TraceFail(Trace);
+   Trace->Ops[Trace->NumOps++] = *Op;
+   return Trace;
+}
+
+// Record the conditional jump Op, at operation N, as a guard that it goes the same way: Taken, or not.
+// The jump of a counted loop, whose increment has already been recorded, is its compare.
+static CodeTrace TraceGuard(CodeTrace Trace, CodeOp Op, int N, bool Taken) {
+   struct CodeOp Guard = *Op;
+   if (Op->Code == LoopC)
+      Guard.Code = JLtC, Guard.B = Op->A;
+   if (Taken && (Guard.Code == JzC || Guard.Code == JnzC))
+      Guard.Code = Guard.Code == JzC? JnzC: JzC, Guard.K.Integer = N + 1;
+   else if (Taken)
+      Guard.Code = JEqC + ((Guard.Code - JEqC)^1), Guard.K.Integer = N + 1;
+   return TraceAdd(Trace, &Guard);
+}
+
+#ifdef THREADED
+// Taking the address of a label, and jumping to it, are extensions to ISO C.
+#   pragma GCC diagnostic push
+#   pragma GCC diagnostic ignored "-Wpedantic"
+#endif
+
+// Run the operations of a compiled function on its slots, from operation Start on.
+// In tracing mode, a loop that's been around enough is recorded for one iteration, and then run from its trace,
+// with the same handlers, until a guard fails.
+void RunCode(State pc, CodeFunc Code, CodeSlot Slots, int Start) {
+   CodeOp Ops = Code->Ops, Op;
+   CodeSlot A, B, C;
+   CodeTrace Recording = NULL, Replaying = NULL;
+   bool Taken;
+   int N = Start;
+#ifdef THREADED
+// The handlers of the operations.
+#   define Handles(Code) [Code] = &&Do##Code
+   static void *const Handler[] = {
+      Handles(NopC), Handles(ClearC), Handles(MovKC), Handles(MovC), Handles(ConvC),
+#   ifndef NO_FP
+      Handles(FloatC), Handles(FixC),
+#   endif
+      Handles(AddC), Handles(SubC), Handles(MulC), Handles(DivC), Handles(ModC),
+      Handles(ShLC), Handles(ShRC), Handles(AndC), Handles(OrC), Handles(XOrC),
+      Handles(AddKC), Handles(NegC), Handles(CplC), Handles(NotC),
+      Handles(EqC), Handles(NeC), Handles(LtC), Handles(GtC), Handles(LeC), Handles(GeC),
+#   ifndef NO_FP
+      Handles(FAddC), Handles(FSubC), Handles(FMulC), Handles(FDivC), Handles(FNegC), Handles(FNotC),
+      Handles(FEqC), Handles(FNeC), Handles(FLtC), Handles(FGtC), Handles(FLeC), Handles(FGeC),
+#   endif
+      Handles(LoadC), Handles(LoadXC), Handles(StoreC), Handles(StoreXC),
+      Handles(JmpC), Handles(JzC), Handles(JnzC),
+      Handles(JEqC), Handles(JNeC), Handles(JLtC), Handles(JGeC), Handles(JGtC), Handles(JLeC), Handles(LoopC),
+      Handles(VecC), Handles(CallC),
+#   ifdef TAIL_CALLS
+      Handles(TailCallC),
+#   endif
+      Handles(RetC), Handles(FailC)
+   };
+#   undef Handles
+#   define Case(Code) Do##Code
+#   define Link(To, From, Num) for (int I = 0; I < (Num); I++) (To)[I] = Handler[(From)[I].Code]
+#   define Enter(From, FromThread) (Ops = (From), Thread = (FromThread))
+#   define Dispatch() { Op = &Ops[N], A = &Slots[Op->A], B = &Slots[Op->B], C = &Slots[Op->C]; goto *Thread[N]; }
+   void **Thread = Code->Thread;
+   if (Thread == NULL) {
+      if ((Thread = Code->Thread = HeapAllocMem(pc, Code->NumOps*sizeof *Thread)) == NULL)
+         ProgramFailNoParser(pc, "out of memory");
+      Link(Thread, Ops, Code->NumOps);
+   }
+   Dispatch();
+#else
+#   define Case(Code) case Code
+#   define Link(To, From, Num)
+#   define Enter(From, FromThread) (Ops = (From))
+#   define Dispatch() continue
+   while (true) {
+      Op = &Ops[N], A = &Slots[Op->A], B = &Slots[Op->B], C = &Slots[Op->C];
+      switch ((OpCode)Op->Code) {
+      default:
+#endif
+// Go on to the next operation, adding this one to the trace being recorded.
+#define Next() { if (Recording != NULL) Recording = TraceAdd(Recording, Op); N++; Dispatch(); }
+   Case(NopC): Next();
+   Case(ClearC):
+      for (int Slot = Op->A; Slot < Op->B; Slot++)
+         Slots[Slot].Integer = 0;
+   Next();
+   Case(MovKC): *A = Op->K; Next();
+   Case(MovC): *A = *B; Next();
+   Case(ConvC): A->Integer = Narrow(B->Integer, Op->Base); Next();
+#ifndef NO_FP
+   Case(FloatC): A->FP = (double)B->Integer; Next();
+   Case(FixC): A->Integer = (long)B->FP; Next();
+#endif
+// Integer arithmetic wraps around, as it does in the machine code.
+   Case(AddC): A->Integer = Narrow((long)((unsigned long)B->Integer + (unsigned long)C->Integer), Op->Base); Next();
+   Case(SubC): A->Integer = Narrow((long)((unsigned long)B->Integer - (unsigned long)C->Integer), Op->Base); Next();
+   Case(MulC): A->Integer = Narrow((long)((unsigned long)B->Integer*(unsigned long)C->Integer), Op->Base); Next();
+   Case(DivC): A->Integer = Narrow(B->Integer/C->Integer, Op->Base); Next();
+   Case(ModC): A->Integer = Narrow(B->Integer%C->Integer, Op->Base); Next();
+   Case(ShLC): A->Integer = Narrow((long)((unsigned long)B->Integer << (C->Integer&63)), Op->Base); Next();
+   Case(ShRC): A->Integer = Narrow(B->Integer >> (C->Integer&63), Op->Base); Next();
+   Case(AndC): A->Integer = Narrow(B->Integer&C->Integer, Op->Base); Next();
+   Case(OrC): A->Integer = Narrow(B->Integer|C->Integer, Op->Base); Next();
+   Case(XOrC): A->Integer = Narrow(B->Integer^C->Integer, Op->Base); Next();
+   Case(AddKC): A->Integer = Narrow((long)((unsigned long)B->Integer + (unsigned long)Op->K.Integer), Op->Base); Next();
+   Case(NegC): A->Integer = Narrow((long)-(unsigned long)B->Integer, Op->Base); Next();
+   Case(CplC): A->Integer = Narrow(~B->Integer, Op->Base); Next();
+   Case(NotC): A->Integer = !B->Integer; Next();
+   Case(EqC): A->Integer = B->Integer == C->Integer; Next();
+   Case(NeC): A->Integer = B->Integer != C->Integer; Next();
+   Case(LtC): A->Integer = B->Integer < C->Integer; Next();
+   Case(GtC): A->Integer = B->Integer > C->Integer; Next();
+   Case(LeC): A->Integer = B->Integer <= C->Integer; Next();
+   Case(GeC): A->Integer = B->Integer >= C->Integer; Next();
+#ifndef NO_FP
+   Case(FAddC): A->FP = B->FP + C->FP; Next();
+   Case(FSubC): A->FP = B->FP - C->FP; Next();
+   Case(FMulC): A->FP = B->FP*C->FP; Next();
+   Case(FDivC): A->FP = B->FP/C->FP; Next();
+   Case(FNegC): A->FP = -B->FP; Next();
+   Case(FNotC): A->FP = B->FP == 0.0; Next();
+   Case(FEqC): A->Integer = B->FP == C->FP; Next();
+   Case(FNeC): A->Integer = B->FP != C->FP; Next();
+   Case(FLtC): A->Integer = B->FP < C->FP; Next();
+   Case(FGtC): A->Integer = B->FP > C->FP; Next();
+   Case(FLeC): A->Integer = B->FP <= C->FP; Next();
+   Case(FGeC): A->Integer = B->FP >= C->FP; Next();
+#endif
+   Case(LoadC): Case(LoadXC): {
+      char *Addr = Address(Op, Slots);
+      switch (Op->Base) {
+         case CharT: A->Integer = *(signed char *)Addr; break;
+         case ByteT: A->Integer = *(unsigned char *)Addr; break;
+         case ShortIntT: A->Integer = *(short *)Addr; break;
+         case ShortNatT: A->Integer = *(unsigned short *)Addr; break;
+         case IntT: A->Integer = *(int *)Addr; break;
+         case NatT: A->Integer = *(unsigned *)Addr; break;
+         default: memcpy(A, Addr, sizeof *A); break;
+      }
+   }
+   Next();
+   Case(StoreC): Case(StoreXC): {
+      char *Addr = Address(Op, Slots);
+      switch (BaseSize(Op->Base)) {
+         case 1: *(char *)Addr = A->Integer; break;
+         case 2: *(short *)Addr = A->Integer; break;
+         case 4: *(int *)Addr = A->Integer; break;
+         default: memcpy(Addr, A, sizeof *A); break;
+      }
+   }
+   Next();
+   Case(VecC): VecRun(Op->K.Pointer, Slots); Next();
+   Case(CallC): CompileCall(Op->K.Pointer, B, Op->A == NoSlot? NULL: A); Next();
+#ifdef TAIL_CALLS
+   Case(TailCallC): CompileTailCall(Op->K.Pointer, B); Next();
+#endif
+   Case(FailC): CompileFail(Op->K.Pointer); return;
+   Case(RetC):
+      if (Recording != NULL)
+         TraceFail(Recording);
+   return;
+   Case(JmpC): Taken = true; goto Branch;
+   Case(JzC): Taken = A->Integer == 0; goto Branch;
+   Case(JnzC): Taken = A->Integer != 0; goto Branch;
+   Case(JEqC): Taken = B->Integer == C->Integer; goto Branch;
+   Case(JNeC): Taken = B->Integer != C->Integer; goto Branch;
+   Case(JLtC): Taken = B->Integer < C->Integer; goto Branch;
+   Case(JGeC): Taken = B->Integer >= C->Integer; goto Branch;
+   Case(JGtC): Taken = B->Integer > C->Integer; goto Branch;
+   Case(JLeC): Taken = B->Integer <= C->Integer; goto Branch;
+   Case(LoopC):
+      if (Recording != NULL) {
+         struct CodeOp Increment = *Op;
+         Increment.Code = AddKC, Increment.B = Op->A, Increment.K.Integer = 1;
+         Recording = TraceAdd(Recording, &Increment);
+      }
+      A->Integer = Narrow((long)((unsigned long)A->Integer + 1), Op->Base);
+      Taken = A->Integer < C->Integer;
+   goto Branch;
+   Branch: {
+      int Target = Op->K.Integer;
+      if (Replaying != NULL) {
+      // In a trace, a conditional jump is a guard, which leaves the trace if it's taken, and the jump at the end goes back around.
+         if (Op->Code != JmpC) {
+            if (Taken)
+               Replaying = NULL, Enter(Code->Ops, Code->Thread), N = Target;
+            else
+               N++;
+            Dispatch();
+         }
+         Replaying->Iterations++;
+         if (CompileLoop(pc, Code)) {
+            Code->Native(Slots, Code->NativeOps[Target]);
+            return;
+         }
+         N = 0;
+         Dispatch();
+      }
+      if (Recording != NULL && Op->Code != JmpC)
+         Recording = TraceGuard(Recording, Op, N, Taken);
+      if (!Taken || Target > N) {
+         N = Taken? Target: N + 1;
+         Dispatch();
+      }
+   // A jump back is a loop: once the loop's been around enough, it carries on in machine code.
+      if (CompileLoop(pc, Code)) {
+         if (Recording != NULL)
+            TraceFail(Recording);
+         Code->Native(Slots, Code->NativeOps[Target]);
+         return;
+      }
+      if (Recording != NULL) {
+      // Back at the head, the trace is complete, once the jump back is added; at the head of another loop, this one can't be traced.
+         struct CodeOp Back = *Op;
+         Back.Code = JmpC;
+         if (Target != Recording->Head)
+            TraceFail(Recording);
+         else if (TraceAdd(Recording, &Back) != NULL) {
+            Recording->Recording = false, Recording->Ready = true;
+            Link(Recording->Thread, Recording->Ops, Recording->NumOps);
+         }
+         Recording = NULL;
+      } else if (pc->TraceLoops) {
+         CodeTrace Trace = TraceFind(pc, Code, Target);
+         if (Trace != NULL && Trace->Ready) {
+            Replaying = Trace, Trace->Runs++;
+            Enter(Trace->Ops, Trace->Thread), N = 0;
+            Dispatch();
+         }
+         Recording = Trace;
+      }
+      N = Target;
+      Dispatch();
+   }
+#ifndef THREADED
+      }
+   }
+#endif
+#undef Next
+#undef Dispatch
+#undef Enter
+#undef Link
+#undef Case
+}
+
+#ifdef THREADED
+#   pragma GCC diagnostic pop
+#endif
+
+// Free a compiled function's traces, and its handler addresses.
+void RunFree(State pc, CodeFunc Code) {
+   if (Code->Thread != NULL)
+      HeapFreeMem(pc, Code->Thread), Code->Thread = NULL;
+   while (Code->Traces != NULL) {
+      CodeTrace Next = Code->Traces->Next;
+      HeapFreeMem(pc, Code->Traces);
+      Code->Traces = Next;
+   }
+}
+#endif
+
+// Turn loop tracing on or off.
+void PicocTraceLoops(State pc, bool On) {
+#ifndef NO_COMPILER
+   pc->TraceLoops = On;
+#endif
+}
+
+#ifndef NO_COMPILER
+// Show the constant of a traced operation, without showing where anything is in memory:
+// as the global it reaches and the offset into it, the function it calls, the string it is, or else the number it is.
+static void TraceShowConstant(State pc, OutFile Stream, CodeOp Op) {
+   switch (Op->Code) {
+      case LoadC: case LoadXC: case StoreC: case StoreXC:
+         for (int Count = 0; Count < pc->GlobalTable.Size; Count++) {
+            for (TableEntry Entry = pc->GlobalTable.HashTable[Count]; Entry != NULL; Entry = Entry->Next) {
+               Value Val = Entry->p.v.Val;
+               long Offset = (char *)Op->K.Pointer - (char *)Val->Val;
+               if (Val->Typ->Base != FunctionT && Val->Typ->Base != MacroT && Offset >= 0 && Offset < TypeSizeValue(Val, false)) {
+                  PlatformPrintf(Stream, Offset == 0? "&%s": "&%s+%l", Entry->p.v.Key, Offset);
+                  return;
+               }
+            }
+         }
+         PlatformPrintf(Stream, "?");
+      break;
+      case CallC: case TailCallC: case FailC: PlatformPrintf(Stream, "%s", ((CodeSite)Op->K.Pointer)->FuncName); break;
+      case VecC: PlatformPrintf(Stream, "-"); break;
+      case MovKC:
+         if (Op->Base == PointerT) {
+            PlatformPrintf(Stream, "\"%s\"", (char *)Op->K.Pointer);
+            break;
+         }
+      default: PlatformPrintf(Stream, "%l", Op->K.Integer); break;
+   }
+}
+#endif
+
+// List the loop traces: for each, where its function is and what it does.
+void PicocShowTraces(State pc, OutFile Stream) {
+#ifndef NO_COMPILER
+   for (CodeFunc Code = pc->CodeList; Code != NULL; Code = Code->Next) {
+      for (CodeTrace Trace = Code->Traces; Trace != NULL; Trace = Trace->Next) {
+         if (!Trace->Ready)
+            continue;
+         PlatformPrintf(Stream, "The loop at operation %d of the function at %s:%d: %d operations, entered %l times, around %l times\n",
+            Trace->Head, Code->Func->Body.FileName, Code->Func->Body.Line, Trace->NumOps, Trace->Runs, Trace->Iterations
+         );
+         for (CodeOp Op = Trace->Ops; Op < Trace->Ops + Trace->NumOps; Op++) {
+            PlatformPrintf(Stream, "   %s %d, %d, %d, ", OpName[Op->Code], Op->A, Op->B, Op->C);
+            TraceShowConstant(pc, Stream, Op);
+            PlatformPrintf(Stream, "\n");
+         }
+      }
+   }
+#endif
+}
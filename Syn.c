@@ -56,6 +56,11 @@ Value ParseFunctionDefinition(ParseState Parser, ValueType ReturnType, char *Ide
    FuncValue->Val->FuncDef.ReturnType = ReturnType;
    FuncValue->Val->FuncDef.NumParams = ParamCount;
    FuncValue->Val->FuncDef.VarArgs = false;
+   FuncValue->Val->FuncDef.NumLocals = -1;
+#ifndef NO_COMPILER
+   FuncValue->Val->FuncDef.Compiled = NULL;
+   FuncValue->Val->FuncDef.NoCompile = false;
+#endif
    FuncValue->Val->FuncDef.ParamType = (ValueType *)((char *)FuncValue->Val + sizeof FuncValue->Val->FuncDef);
    FuncValue->Val->FuncDef.ParamName = (char **)((char *)FuncValue->Val->FuncDef.ParamType + ParamCount*sizeof(ValueType));
    Lexical Token = NoneL;
@@ -274,6 +279,8 @@ static void ParseMacroDefinition(ParseState Parser) {
       struct ParseState ParamParser;
       ParserCopy(&ParamParser, Parser);
       int NumParams = ParseCountParams(&ParamParser);
+      if (NumParams > ParameterMax)
+         ProgramFail(Parser, "too many parameters (%d allowed)", ParameterMax);
       MacroValue = VariableAllocValueAndData(Parser->pc, Parser, sizeof MacroValue->Val->MacroDef + NumParams*sizeof(const char *), false, NULL, true);
       MacroValue->Val->MacroDef.NumParams = NumParams;
       MacroValue->Val->MacroDef.ParamName = (char **)((char *)MacroValue->Val + sizeof MacroValue->Val->MacroDef);
@@ -297,6 +304,9 @@ static void ParseMacroDefinition(ParseState Parser) {
       MacroValue = VariableAllocValueAndData(Parser->pc, Parser, sizeof MacroValue->Val->MacroDef, false, NULL, true);
       MacroValue->Val->MacroDef.NumParams = 0;
    }
+   MacroValue->Val->MacroDef.Evaluated = false;
+   MacroValue->Val->MacroDef.Folded = NULL;
+   MacroValue->Val->MacroDef.Named = false;
 // Copy the body of the macro to execute later.
    ParserCopy(&MacroValue->Val->MacroDef.Body, Parser);
    MacroValue->Typ = &Parser->pc->MacroType;
@@ -311,15 +321,6 @@ void ParserCopy(ParseState To, ParseState From) {
    memcpy((void *)To, (void *)From, sizeof *To);
 }
 
-// Copy where we're at in the parsing.
-static void ParserCopyPos(ParseState To, ParseState From) {
-   To->Pos = From->Pos;
-   To->Line = From->Line;
-   To->HashIfLevel = From->HashIfLevel;
-   To->HashIfEvaluateToLevel = From->HashIfEvaluateToLevel;
-   To->CharacterPos = From->CharacterPos;
-}
-
 // Parse a "for" statement.
 static void ParseFor(ParseState Parser) {
    RunMode OldMode = Parser->Mode;
@@ -328,25 +329,29 @@ static void ParseFor(ParseState Parser) {
       ProgramFail(Parser, "'(' expected");
    if (ParseStatement(Parser, true) != OkSyn)
       ProgramFail(Parser, "statement expected");
-   struct ParseState PreConditional;
+   struct ParseCursor PreConditional;
    ParserCopyPos(&PreConditional, Parser);
    bool Condition = LexGetToken(Parser, NULL, false) == SemiL || ExpressionParseInt(Parser) != 0;
    if (LexGetToken(Parser, NULL, true) != SemiL)
       ProgramFail(Parser, "';' expected");
-   struct ParseState PreIncrement;
+   struct ParseCursor PreIncrement;
    ParserCopyPos(&PreIncrement, Parser);
    ParseStatementMaybeRun(Parser, false, false);
    if (LexGetToken(Parser, NULL, true) != RParL)
       ProgramFail(Parser, "')' expected");
-   struct ParseState PreStatement;
+   struct ParseCursor PreStatement;
    ParserCopyPos(&PreStatement, Parser);
    if (ParseStatementMaybeRun(Parser, Condition, true) != OkSyn)
       ProgramFail(Parser, "statement expected");
    if (Parser->Mode == ContinueM && OldMode == RunM)
       Parser->Mode = RunM;
-   struct ParseState After;
+   struct ParseCursor After;
    ParserCopyPos(&After, Parser);
    while (Condition && Parser->Mode == RunM) {
+#ifndef NO_COMPILER
+      if (CompileEnterLoop(Parser, PreConditional.Pos))
+         break;
+#endif
       ParserCopyPos(Parser, &PreIncrement);
       ParseStatement(Parser, false);
       ParserCopyPos(Parser, &PreConditional);
@@ -406,8 +411,8 @@ ParseResult ParseStatement(ParseState Parser, bool CheckTrailingSemicolon) {
    if (Parser->DebugMode && Parser->Mode == RunM)
       DebugCheckStatement(Parser);
 // Take note of where we are and then grab a token to see what statement we have.
-   struct ParseState PreState;
-   ParserCopy(&PreState, Parser);
+   struct ParseCursor PreState;
+   ParserCopyPos(&PreState, Parser);
    Value LexerValue;
    Lexical Token = LexGetToken(Parser, &LexerValue, true);
    switch (Token) {
@@ -417,7 +422,7 @@ ParseResult ParseStatement(ParseState Parser, bool CheckTrailingSemicolon) {
          if (VariableDefined(Parser->pc, LexerValue->Val->Identifier)) {
             Value VarValue = VariableGet(Parser->pc, Parser, LexerValue->Val->Identifier);
             if (VarValue->Typ->Base == TypeT) {
-               *Parser = PreState;
+               ParserCopyPos(Parser, &PreState);
                ParseDeclaration(Parser, Token);
                break;
             }
@@ -456,7 +461,7 @@ ParseResult ParseStatement(ParseState Parser, bool CheckTrailingSemicolon) {
 #endif
          }
       case StarL: case AndL: case IncOpL: case DecOpL: case LParL: {
-         *Parser = PreState;
+         ParserCopyPos(Parser, &PreState);
          Value CValue = ExpressionParse(Parser);
          if (Parser->Mode == RunM)
             VariableStackPop(Parser, CValue);
@@ -481,12 +486,19 @@ ParseResult ParseStatement(ParseState Parser, bool CheckTrailingSemicolon) {
       break;
       case WhileL: {
          RunMode PreMode = Parser->Mode;
+#ifndef NO_COMPILER
+         const unsigned char *PreLoop = Parser->Pos;
+#endif
          if (LexGetToken(Parser, NULL, true) != LParL)
             ProgramFail(Parser, "'(' expected");
-         struct ParseState PreConditional;
+         struct ParseCursor PreConditional;
          ParserCopyPos(&PreConditional, Parser);
          bool Condition;
          do {
+#ifndef NO_COMPILER
+         // If it carries on compiled, the rest of the loop is skipped, as after a return.
+            CompileEnterLoop(Parser, PreLoop);
+#endif
             ParserCopyPos(Parser, &PreConditional);
             Condition = ExpressionParseInt(Parser) != 0;
             if (LexGetToken(Parser, NULL, true) != RParL)
@@ -503,10 +515,13 @@ ParseResult ParseStatement(ParseState Parser, bool CheckTrailingSemicolon) {
       break;
       case DoL: {
          RunMode PreMode = Parser->Mode;
-         struct ParseState PreStatement;
+         struct ParseCursor PreStatement;
          ParserCopyPos(&PreStatement, Parser);
          bool Condition;
          do {
+#ifndef NO_COMPILER
+            CompileEnterLoop(Parser, PreStatement.Pos);
+#endif
             ParserCopyPos(Parser, &PreStatement);
             if (ParseStatement(Parser, true) != OkSyn)
                ProgramFail(Parser, "statement expected");
@@ -529,7 +544,7 @@ ParseResult ParseStatement(ParseState Parser, bool CheckTrailingSemicolon) {
       case IntL: case ShortL: case CharL: case LongL: case FloatL: case DoubleL:
       case VoidL: case StructL: case UnionL: case EnumL: case SignedL:
       case UnsignedL: case StaticL: case AutoL: case RegisterL: case ExternL:
-         *Parser = PreState, CheckTrailingSemicolon = ParseDeclaration(Parser, Token);
+         ParserCopyPos(Parser, &PreState), CheckTrailingSemicolon = ParseDeclaration(Parser, Token);
       break;
       case DefineP: ParseMacroDefinition(Parser), CheckTrailingSemicolon = false; break;
 #ifndef NO_HASH_INCLUDE
@@ -589,6 +604,11 @@ ParseResult ParseStatement(ParseState Parser, bool CheckTrailingSemicolon) {
       break;
       case ReturnL:
          if (Parser->Mode == RunM) {
+#ifdef TAIL_CALLS
+            if (ExpressionParseTailCall(Parser))
+               ; // The caller will make the call, in place of this function.
+            else
+#endif
             if (!Parser->pc->TopStackFrame || Parser->pc->TopStackFrame->ReturnValue->Typ->Base != VoidT) {
                Value CValue = ExpressionParse(Parser);
                if (CValue == NULL)
@@ -630,7 +650,7 @@ ParseResult ParseStatement(ParseState Parser, bool CheckTrailingSemicolon) {
          }
       }
       break;
-      default: *Parser = PreState; return BadSyn;
+      default: ParserCopyPos(Parser, &PreState); return BadSyn;
    }
    if (CheckTrailingSemicolon) {
       if (LexGetToken(Parser, NULL, true) != SemiL)
@@ -662,8 +682,10 @@ void PicocParse(State pc, const char *FileName, const char *Source, int SourceLe
    if (Ok == BadSyn)
       ProgramFail(&Parser, "parse error");
 // Clean up.
-   if (CleanupNow)
+   if (CleanupNow) {
+      LexForgetExpansions(pc);
       HeapFreeMem(pc, Tokens);
+   }
 }
 
 // Parse interactively.
@@ -4,8 +4,9 @@
 #include "Extern.h"
 
 // Initialize everything.
-void PicocInitialize(State pc, int StackSize) {
+static void Initialize(State pc, int StackSize, bool HeapArena) {
    memset(pc, '\0', sizeof *pc);
+   pc->HeapArena = HeapArena;
    PlatformInit(pc);
    BasicIOInit(pc);
    HeapInit(pc, StackSize);
@@ -23,19 +24,38 @@ void PicocInitialize(State pc, int StackSize) {
 #endif
    PlatformLibraryInit(pc);
    DebugInit(pc);
+#ifndef NO_COMPILER
+   CompileInit(pc);
+#endif
+}
+
+void PicocInitialize(State pc, int StackSize) {
+   Initialize(pc, StackSize, false);
+}
+
+// Initialize everything in arena mode: PicocCleanup() then frees the interpreter's memory wholesale, rather than piece by piece.
+// Until then, freed blocks are reused, small ones by size and large ones first-fit, but the regions they're in are kept.
+// Memory allocated by the program itself, with malloc() and its kin, is still the program's to free.
+void PicocInitializeArena(State pc, int StackSize) {
+   Initialize(pc, StackSize, true);
 }
 
 // Free memory.
 void PicocCleanup(State pc) {
-   DebugCleanup(pc);
+#ifndef NO_COMPILER
+   CompileCleanup(pc);
+#endif
+   if (!pc->HeapArena) {
+      DebugCleanup(pc);
 #ifndef NO_HASH_INCLUDE
-   IncludeCleanup(pc);
+      IncludeCleanup(pc);
 #endif
-   ParseCleanup(pc);
-   LexCleanup(pc);
-   VariableCleanup(pc);
-   TypeCleanup(pc);
-   TableStrFree(pc);
+      ParseCleanup(pc);
+      LexCleanup(pc);
+      VariableCleanup(pc);
+      TypeCleanup(pc);
+      TableStrFree(pc);
+   }
    HeapCleanup(pc);
    PlatformCleanup(pc);
 }
@@ -96,6 +116,7 @@ void PlatformVPrintf(OutFile Stream, const char *Format, va_list Args) {
          switch (*FPos) {
             case 's': PrintStr(va_arg(Args, char *), Stream); break;
             case 'd': PrintSimpleInt(va_arg(Args, int), Stream); break;
+            case 'l': PrintSimpleInt(va_arg(Args, long), Stream); break;
             case 'c': PrintCh(va_arg(Args, int), Stream); break;
             case 't': PrintType(va_arg(Args, ValueType), Stream); break;
 #ifndef NO_FP
@@ -28,13 +28,29 @@
 #define SubAlign(X, N) ((char *)(X) - MemAlign(N))
 
 #define GloTabMax 97		// The capacity for the global variable table.
+#define StaTabMax 97		// The capacity for the table of static local variables.
 #define StrTabMax 97		// The capacity for the shared string table.
 #define LitTabMax 97		// The capacity for the string literal table.
 #define KeyTabMax 97		// The capacity for the reserved word table.
+#define ExpTabMax 97		// The capacity for the table of macro expansions.
 #define ParameterMax 0x10	// The parameter count of the most egregious function allowed.
 #define LineBufMax 0x100	// The character size of the longest line allowed.
-#define LocTabMax 11		// The initial capacity of local variable (growable) tables.
+#define LocTabMax 11		// The capacity of the local table for a function not yet called.
+#define TypeTabMax 251		// The capacity for the index of derived types.
 #define MemTabMax 11		// The initial capacity of struct/union member (growable) tables.
+#define MemberCacheMax 0x40	// The number of slots, a power of 2, in the cache of struct/union member lookups.
+#define SlabMax 0x40		// The number of nodes in each chunk of a slab pool.
+#define SizeClassMax 10		// The number of block size classes in the heap statistics.
+#define ArenaMax 0x10000		// The size of each heap region in arena mode.
+#define ArenaBucketMax 0x40	// The number of block sizes, in steps of AlignSize, that arena mode recycles.
+#define TraceTabMax 97		// The capacity for the allocation tracer's site table.
+#define TraceDepthMax 0x20	// The most calling functions the allocation tracer names per site.
+#define CodeLocalMax 0x100	// The most parameters and local variables a compiled function may have.
+#define CompileAfterMin 2	// The calls and loop iterations, by default, before a function is compiled.
+#define NativeAfterMin 0x400	// The calls and loop iterations, by default, before compiled code is translated to machine code.
+#define TraceAfterMin 0x10	// The iterations of a loop run by Run.c before it's traced, in tracing mode.
+#define TraceOpMax 0x80		// The most operations in a loop trace.
+#define KernelRegMax 0x10	// The most registers in the kernel of an element-wise loop.
 
 #define PromptStart "Starting PicoC " PICOC_VERSION "\n"
 #define PromptStatement "PicoC> "
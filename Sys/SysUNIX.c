@@ -72,7 +72,7 @@ char *PlatformReadFile(State pc, const char *FileName) {
    struct stat FileInfo;
    if (stat(FileName, &FileInfo))
       ProgramFailNoParser(pc, "can't read file %s\n", FileName);
-   char *ReadText = malloc(FileInfo.st_size + 1);
+   char *ReadText = HeapAllocMem(pc, FileInfo.st_size + 1);
    if (ReadText == NULL)
       ProgramFailNoParser(pc, "out of memory\n");
    FILE *InFile = fopen(FileName, "r");
@@ -22,6 +22,7 @@ static unsigned TableHash(const char *Key, int Len) {
 // Initialize a table.
 void TableInitTable(Table Tbl, TableEntry *HashTable, int Size, bool OnHeap) {
    Tbl->Size = Size;
+   Tbl->Count = 0;
    Tbl->OnHeap = OnHeap;
    Tbl->HashTable = HashTable;
    memset((void *)HashTable, '\0', Size*sizeof *HashTable);
@@ -45,7 +46,12 @@ bool TableSet(State pc, Table Tbl, char *Key, Value Val, const char *DeclFileNam
    int AddAt;
    TableEntry FoundEntry = TableSearch(Tbl, Key, &AddAt);
    if (FoundEntry == NULL) { // Add it to the table.
-      TableEntry NewEntry = VariableAlloc(pc, NULL, sizeof *NewEntry, Tbl->OnHeap);
+// Every field is set below, so a stack entry needn't be cleared.
+      TableEntry NewEntry = Tbl->OnHeap? HeapAllocNode(pc, &pc->EntryPool): HeapReserveStack(pc, sizeof *NewEntry);
+      if (NewEntry == NULL)
+         ProgramFailNoParser(pc, "out of memory");
+      if (pc->AllocTrace != NULL)
+         HeapTrace(pc, EntryA, DeclFileName, DeclLine, sizeof *NewEntry);
       NewEntry->DeclFileName = DeclFileName;
       NewEntry->DeclLine = DeclLine;
       NewEntry->DeclColumn = DeclColumn;
@@ -53,6 +59,7 @@ bool TableSet(State pc, Table Tbl, char *Key, Value Val, const char *DeclFileNam
       NewEntry->p.v.Val = Val;
       NewEntry->Next = Tbl->HashTable[AddAt];
       Tbl->HashTable[AddAt] = NewEntry;
+      Tbl->Count++;
       return true;
    }
    return false;
@@ -83,7 +90,8 @@ Value TableDelete(State pc, Table Tbl, const char *Key) {
          TableEntry DeleteEntry = *EntryPtr;
          Value Val = DeleteEntry->p.v.Val;
          *EntryPtr = DeleteEntry->Next;
-         HeapFreeMem(pc, DeleteEntry);
+         Tbl->Count--;
+         HeapFreeNode(&pc->EntryPool, DeleteEntry);
          return Val;
       }
    }
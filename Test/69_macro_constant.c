@@ -0,0 +1,31 @@
+#include <stdio.h>
+
+#define N 10
+#define M (N*4 + 1)
+#define S (sizeof(struct fred)*2)
+#define H (N/4.0)
+#define C ((char)300)
+#define X (x + 1)
+
+struct fred {
+   int a;
+   int b;
+};
+
+int x = 5;
+
+// A local N shadows the one M names, so M isn't folded here.
+int f() {
+   int N = 3;
+   return M;
+}
+
+void main() {
+   int i;
+   for (i = 0; i < 3; i++) {
+      printf("%d %d %d %f %d %d\n", N, M, S, H, C, X);
+      x++;
+   }
+   printf("%d %d %d\n", N, f(), M);
+   printf("%d %d\n", f(), M);
+}
@@ -0,0 +1,21 @@
+#include <stdio.h>
+
+#define MAX(a, b) ((a) > (b)? (a): (b))
+#define SQUARE(x) ((x)*(x))
+#define ELEMENT(a, i) a[i]
+#define ANSWER() 42
+
+int Array[4];
+
+void main() {
+   int i, Total = 0;
+   for (i = 0; i < 10; i++)
+      Total += MAX(i & 3, SQUARE(2 - i));
+   printf("%d\n", Total);
+   ELEMENT(Array, 2) = 9;
+   printf("%d %d\n", ELEMENT(Array, 2), MAX(MAX(1, 5), 3));
+   printf("%d\n", ANSWER());
+   printf("%f\n", SQUARE(1.5));
+   i = 1;
+   printf("%d %d\n", MAX(i++, 0), i);
+}
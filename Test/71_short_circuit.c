@@ -0,0 +1,49 @@
+#include <stdio.h>
+
+struct Node {
+   int Value;
+   struct Node *Next;
+};
+
+int Calls = 0;
+
+int Count(int Value) {
+   Calls++;
+   return Value;
+}
+
+void Then() {
+   printf("then\n");
+}
+
+void Else() {
+   printf("else\n");
+}
+
+void main() {
+   struct Node Tail;
+   struct Node *Ptr = &Tail;
+   int Array[3];
+   int i;
+   Tail.Value = 7;
+   Tail.Next = NULL;
+   Array[0] = 1; Array[1] = 2; Array[2] = 3;
+   printf("%d\n", Ptr != NULL && Ptr->Value == 7);
+   Ptr = Ptr->Next;
+   printf("%d\n", Ptr != NULL && Ptr->Value == 7);
+   printf("%d\n", Ptr == NULL || Ptr->Next->Value);
+   for (i = 0; i < 3 && Array[i] < 3; i++)
+      ;
+   printf("%d\n", i);
+   printf("%d\n", 0 && Count(1) || Count(2));
+   printf("%d\n", 1 || Count(3) && Count(4));
+   printf("%d\n", (0 && (Count(5) + Array[Count(1)])) + 5);
+   printf("%d\n", 0? Count(6): Array[1] + Count(7));
+   printf("%d\n", 1? Array[2]*2: Count(8) + Array[Count(1)]);
+   printf("%d calls\n", Calls);
+   for (i = 0; i < 2; i++)
+      i? Then(): Else();
+   printf("%d\n", 1? Count(1): 0? Count(2): Count(3));
+   printf("%d\n", 0? 1? Count(4): Count(5): Count(6));
+   printf("%d calls\n", Calls);
+}
@@ -0,0 +1,52 @@
+#include <stdio.h>
+
+int CountDown(int N, int Sum) {
+   if (N == 0)
+      return Sum;
+   return CountDown(N - 1, Sum + 1);
+}
+
+int IsOdd(int N);
+
+int IsEven(int N) {
+   if (N == 0)
+      return 1;
+   return IsOdd(N - 1);
+}
+
+int IsOdd(int N) {
+   if (N == 0)
+      return 0;
+   return IsEven(N - 1);
+}
+
+int Total(int *Array, int N, int Sum) {
+   int Copy[4];
+   if (N == 0)
+      return Sum;
+   Copy[0] = Array[0] + 1;
+   return Total(Copy, N - 1, Sum + Copy[0]);
+}
+
+double Halve(double X, int N) {
+   if (N == 0)
+      return X;
+   return Halve(X/2, N - 1);
+}
+
+int Double(int N) {
+   return N*2;
+}
+
+long Widen(int N) {
+   return Double(N);
+}
+
+void main() {
+   int Start = 1;
+   printf("%d\n", CountDown(100000, 0));
+   printf("%d %d\n", IsEven(10000), IsOdd(10001));
+   printf("%d\n", Total(&Start, 3, 0));
+   printf("%f\n", Halve(10.0, 3));
+   printf("%ld\n", Widen(21));
+}
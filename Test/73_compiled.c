@@ -0,0 +1,163 @@
+#include <stdio.h>
+
+#define Size 4
+#define Scale (Size*2)
+
+unsigned char Bytes[Size];
+short Shorts[Size];
+double Reals[Size];
+int Count = 3;
+char Letter = 'x';
+
+enum Colour { Red = 4, Green = 9 };
+
+int Fib(int N) {
+   if (N < 2)
+      return N;
+   return Fib(N - 1) + Fib(N - 2);
+}
+
+int Narrow(char C, short S, unsigned char B, unsigned short W) {
+   return C + S + B + W;
+}
+
+unsigned Difference(unsigned A, unsigned B) {
+   return A - B;
+}
+
+int Bits(int X) {
+   X <<= 3;
+   X >>= 1;
+   X |= 1;
+   X ^= 6;
+   X &= 255;
+   X %= 7;
+   return X;
+}
+
+double Real(double D, int I) {
+   D -= I;
+   D *= 2;
+   D /= 3;
+   return D + !D - -D;
+}
+
+int Store(int I) {
+   Bytes[I] = 300 + I;
+   Shorts[I] = 70000 + I;
+   Reals[I] = I*0.5;
+   return Bytes[I] + Shorts[I] + Reals[I];
+}
+
+int Pick(int I) {
+   return I > 2? Count: Letter;
+}
+
+int Colour(int X) {
+   switch (X) {
+      case Red: return 1;
+      case Green: return 2;
+      case 'a': return 3;
+   }
+   return 0;
+}
+
+int Macro(int X) {
+   Count = X;
+   Count += Scale;
+   return Count;
+}
+
+int Convert(double D) {
+   int I = D;
+   return I + (char)300 + (unsigned char)-1 + (int)(D*1.5);
+}
+
+int Steps(int A, int B) {
+   int R = 0;
+   R += A++ + ++B;
+   R += A-- - --B;
+   return R*100 + A*10 + B;
+}
+
+int Loops(int N) {
+   int I, S = 0;
+   for (I = 0; I < N; I++) {
+      if (I == 5)
+         break;
+      if (I&1)
+         continue;
+      S += I;
+   }
+   while (1) {
+      if (--N < 0)
+         break;
+      S += N;
+   }
+   do
+      S++;
+   while (S < 40);
+   return S;
+}
+
+int Scopes(int A) {
+   int B = A;
+   {
+      int C = B*2;
+      B = C;
+   }
+   {
+      int C;
+      B += C;
+   }
+   return B;
+}
+
+int Logic(int A, int B) {
+   return A && B || !A;
+}
+
+void Bump(void) {
+   Count++;
+}
+
+int Twice(void) {
+   Bump();
+   Bump();
+   return Count;
+}
+
+int Sum(int N, int Acc) {
+   if (N == 0)
+      return Acc;
+   return Sum(N - 1, Acc + N);
+}
+
+int Missing(int X) {
+   if (X > 0)
+      return X;
+}
+
+int main() {
+   int I;
+   printf("%d\n", Fib(20));
+   printf("%d\n", Narrow(-3, -300, 250, 65000));
+   printf("%u %u\n", Difference(3, 5), Difference(10, 4));
+   printf("%d %d\n", Bits(13), Bits(-13));
+   printf("%f %f\n", Real(3.0, 3), Real(7.5, 1));
+   for (I = 0; I < Size; I++)
+      printf("%d ", Store(I));
+   printf("\n");
+   printf("%d %d\n", Pick(1), Pick(5));
+   printf("%d %d %d %d\n", Colour(4), Colour(9), Colour('a'), Colour(0));
+   printf("%d %d\n", Macro(5), Count);
+   printf("%d %d\n", Convert(3.99), Convert(-3.99));
+   printf("%d\n", Steps(3, 4));
+   printf("%d\n", Loops(10));
+   printf("%d\n", Scopes(4));
+   printf("%d %d %d\n", Logic(1, 1), Logic(0, 0), Logic(1, 0));
+   printf("%d\n", Twice());
+   printf("%d\n", Sum(100, 0));
+   printf("%d\n", Missing(2));
+   return 0;
+}
@@ -0,0 +1,60 @@
+#include <stdio.h>
+
+int Total;
+
+// Each is called once, so it's only compiled part way through one of its loops.
+long Sum(int N) {
+   long S = 0;
+   for (int I = 0; I < N; I++)
+      S += I%7;
+   return S;
+}
+
+int Digits(int N) {
+   int Count = 0;
+   while (N != 0) {
+      N /= 10;
+      Count++;
+   }
+   int Late;
+   return Count + Late;
+}
+
+double Halve(double D) {
+   int Steps = 0;
+   do {
+      D /= 2;
+      Steps++;
+   } while (D > 1);
+   return D + Steps;
+}
+
+void Nest(int N) {
+   for (int I = 0; I < N; I++) {
+      int J = 0;
+      while (J < I) {
+         J++;
+         Total += J;
+      }
+   }
+}
+
+int Early(int N) {
+   for (int I = 0; ; I++)
+      if (I*I > N)
+         return I;
+}
+
+int main() {
+   long Outer = 0;
+   for (int I = 0; I < 300; I++)
+      Outer += I;
+   printf("%ld\n", Outer);
+   printf("%ld\n", Sum(5000));
+   printf("%d\n", Digits(1234567890));
+   printf("%f\n", Halve(1000000.0));
+   Nest(60);
+   printf("%d\n", Total);
+   printf("%d\n", Early(100000));
+   return 0;
+}
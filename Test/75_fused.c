@@ -0,0 +1,37 @@
+#include <stdio.h>
+
+// Each relation, as a loop condition and as an if either way, fused with the jump on it once compiled.
+int Relations(int A, int B) {
+   int Mask = 0;
+   if (A == B) Mask |= 1;
+   if (A != B) Mask |= 2;
+   if (A < B) Mask |= 4;
+   if (A > B) Mask |= 8;
+   if (A <= B) Mask |= 16;
+   if (A >= B) Mask |= 32;
+   if (!(A < B)) Mask |= 64;
+   return Mask;
+}
+
+// Counted loops: an empty one, one whose bound moves, and one on a narrow counter.
+long Counted(int N) {
+   long Sum = 0;
+   for (int I = 0; I < N; I++)
+      Sum += I;
+   for (int I = 0; I < N; I++)
+      N -= I&1;
+   for (unsigned char C = 250; C < 255; C++)
+      Sum += C;
+   int J = 10;
+   while (J > N)
+      J--;
+   return Sum*100 + N + J;
+}
+
+int main() {
+   for (int Pass = 0; Pass < 3; Pass++) {
+      printf("%d %d %d\n", Relations(1, 2), Relations(2, 2), Relations(3, 2));
+      printf("%ld %ld %ld\n", Counted(0), Counted(7), Counted(100));
+   }
+   return 0;
+}
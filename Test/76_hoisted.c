@@ -0,0 +1,43 @@
+#include <stdio.h>
+
+int Limit = 6;
+int Table[8];
+
+// Once compiled, what doesn't change in a loop is worked out before it: constants, sums of them, and a global no store in the loop can change.
+int Invariant(int N) {
+   int Sum = 0;
+   for (int I = 0; I < Limit*2; I++)
+      Sum += N*3 + I%5;
+   return Sum;
+}
+
+// A store to memory, so the global is read on each iteration.
+int Stored(int N) {
+   int Sum = 0;
+   for (int I = 0; I < Limit; I++) {
+      Table[I] = I + N;
+      Sum += Limit;
+      if (I == 2)
+         Limit--;
+   }
+   Limit = 6;
+   return Sum + Table[3];
+}
+
+// An invariant used only on some iterations, and a loop with an inner loop, which is left as it is.
+int Nested(int N) {
+   int Sum = 0;
+   for (int I = 0; I < N; I++) {
+      if (I > 100)
+         Sum += N*7;
+      for (int J = 0; J < 3; J++)
+         Sum += J*2 + 1;
+   }
+   return Sum;
+}
+
+int main() {
+   for (int Pass = 0; Pass < 3; Pass++)
+      printf("%d %d %d\n", Invariant(Pass), Stored(Pass), Nested(Pass + 4));
+   return 0;
+}
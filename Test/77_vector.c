@@ -0,0 +1,69 @@
+#include <stdio.h>
+
+int A[100], B[100], C[100];
+unsigned U[100];
+double X[50], Y[50], Z[50];
+
+// Once compiled, these run a batch of elements at a time, up to the last, which is left to the loop.
+void Ints(int N, int K) {
+   for (int I = 0; I < N; I++)
+      C[I] = A[I]*K + B[I];
+}
+
+void Rats(int N, double K) {
+   for (int I = 0; I < N; I++)
+      Z[I] = X[I]*K - Y[I]/2.0;
+}
+
+void Mixed(int From, int N) {
+   for (int I = From; I < N; I++) {
+      U[I] = ~(A[I]^0x55) + 7;
+      B[I] = -B[I] & 0xffff;
+   }
+}
+
+// A do loop runs its body once, even past its bound.
+void Once(int I, int N) {
+   do
+      C[I] = 9;
+   while (++I < N);
+}
+
+// These depend on the iterations before, or on the count, so they're left as they are.
+int Sum(int N) {
+   int S = 0;
+   for (int I = 0; I < N; I++)
+      S += C[I];
+   return S;
+}
+
+void Shift(int N) {
+   for (int I = 0; I < N; I++)
+      A[I] = I - A[I];
+}
+
+int main() {
+   for (int I = 0; I < 100; I++) {
+      A[I] = I*3 - 50;
+      B[I] = 1000 - I*I;
+   }
+   for (int I = 0; I < 50; I++) {
+      X[I] = I*0.5;
+      Y[I] = I;
+   }
+   for (int Pass = 0; Pass < 4; Pass++) {
+      Ints(97 - Pass, 3 + Pass);
+      Rats(43 + Pass, 1.5);
+      Mixed(Pass, 90 + Pass);
+      Once(95, 90);
+      Shift(50 + Pass);
+      double T = 0;
+      for (int I = 0; I < 50; I++)
+         T += Z[I];
+      unsigned W = 0;
+      for (int I = 0; I < 100; I++)
+         W = W*31 + U[I] + B[I];
+      printf("%d %f %u %d\n", Sum(100), T, W, C[95]);
+   }
+   return 0;
+}
@@ -0,0 +1,44 @@
+#include <stdio.h>
+
+int G = 5;
+
+// Once compiled, the calls of these are compiled in place.
+int Get() { return G; }
+int Abs(int X) { if (X < 0) return -X; return X; }
+int Max(int X, int Y) { return X > Y? X: Y; }
+double Half(double X) { return X/2; }
+int Sign(int X) { if (X > 0) return 1; else if (X < 0) return -1; else return 0; }
+void Add(int X) { G += X; }
+
+// Each call clears the variables, and leaves the arguments alone.
+int Bump(int X) { X++; int Y; Y += X; return Y; }
+
+// A call in a call.
+int Twice(int X) { int Y = Abs(X); return Y + Y; }
+
+// These stay calls: one's recursive, one has a loop, and one makes a tail call.
+int Fact(int N) { if (N <= 1) return 1; return N*Fact(N - 1); }
+int Sum(int N) { int S = 0; for (int I = 1; I <= N; I++) S += I; return S; }
+int Wrap(int N) { return Fact(N); }
+
+// This only fails if it runs off the end.
+int Odd(int X) { if (X&1) return 1; }
+
+int Loop(int N) {
+   int S = 0;
+   for (int I = -N; I < N; I++) {
+      int A = I;
+      S += Abs(I) + Max(I, 0)*Sign(I) - Bump(A) + Twice(I) + Get();
+      if (A != I) printf("argument changed\n");
+   }
+   for (int I = 0; I < N; I++)
+      Add(1);
+   return S + Sum(N) + Wrap(5) + (int)Half(9.0) + Max(Abs(-3), Get()) + Odd(1);
+}
+
+int main() {
+   for (int K = 0; K < 3; K++)
+      printf("%d\n", Loop(10));
+   printf("%d %f\n", G, Half(G));
+   return 0;
+}
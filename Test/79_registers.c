@@ -0,0 +1,53 @@
+#include <stdio.h>
+
+int A[64];
+
+// Once in machine code, the slots these use most are kept in registers, but for those that calls and vector loops reach.
+int Mix(int N) {
+   unsigned X = 7, S = 0;
+   for (int I = 0; I < N; I++) {
+      X = X*69069 + 1;
+      S += (X >> 8)&0xff;
+   }
+   return S;
+}
+
+double Poly(double X, int N) {
+   double S = 0, P = 1;
+   for (int I = 0; I < N; I++) {
+      S += P/(I + 1);
+      P *= X;
+   }
+   return S;
+}
+
+int Twice(int X) {
+   int Y = X;
+   for (int I = 0; I < 2; I++)
+      Y += X;
+   return Y - X;
+}
+
+// A call in a loop: its argument and result stay in memory.
+int Calls(int N) {
+   int S = 0;
+   for (int I = 0; I < N; I++)
+      S += Twice(I) - I;
+   return S;
+}
+
+// A vector loop, with its count, bound and constant in memory.
+int Scale(int N, int K) {
+   int S = 0;
+   for (int I = 0; I < N; I++)
+      A[I] = I*K + 1;
+   for (int I = 0; I < N; I++)
+      S += A[I];
+   return S;
+}
+
+int main() {
+   for (int K = 0; K < 4; K++)
+      printf("%d %.6f %d %d\n", Mix(1000 + K), Poly(0.5, 20 + K), Calls(50 + K), Scale(60 + K, K));
+   return 0;
+}
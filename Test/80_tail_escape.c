@@ -0,0 +1,28 @@
+#include <stdio.h>
+
+int *Global;
+
+int Sum(int A, int B, int C, int D) {
+   int Y = 99, Z = 77;
+   return *Global + A + B + C + D - A - B - C - D;
+}
+
+// The address of X outlives the return, so the frame can't be reused for the call.
+int ByAddress(int N) {
+   int X = 5;
+   Global = &X;
+   return Sum(1, 2, 3, 4);
+}
+
+// Nor can it if an array's in it.
+int ByArray(int N) {
+   int Array[2];
+   Array[0] = 6;
+   Global = Array;
+   return Sum(1, 2, 3, 4);
+}
+
+void main() {
+   printf("%d\n", ByAddress(0));
+   printf("%d\n", ByArray(0));
+}
@@ -0,0 +1,20 @@
+#include <stdio.h>
+
+int Count() {
+   static int N = 0;
+   N++;
+   return N;
+}
+
+void main() {
+   int I, Last = 0;
+   for (I = 0; I < 20000; I++)
+      Last = Count();
+   printf("%d\n", Last);
+// A static declared in a loop's body is visited again on each pass.
+   for (I = 0; I < 3; I++) {
+      static int K = 10;
+      K++;
+      printf("%d\n", K);
+   }
+}
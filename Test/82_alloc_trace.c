@@ -0,0 +1,22 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+// Each malloc() is traced to where it's made, under the functions it's made in; the one at the top level, under none.
+char *Top = malloc(100);
+
+void Inner(int N) {
+   free(malloc(N));
+}
+
+void Outer(int N) {
+   Inner(N);
+   Inner(N*2);
+}
+
+void main() {
+   int I;
+   for (I = 0; I < 3; I++)
+      Outer(100);
+   free(calloc(10, 20));
+   free(Top);
+}
@@ -0,0 +1,19 @@
+#include <stdio.h>
+
+struct Pair {
+   int A, B;
+};
+
+int Square(int N) {
+   return N*N;
+}
+
+// Once cleaned up after, everything allocated has been freed.
+void main() {
+   struct Pair P;
+   int I, Sum = 0;
+   for (I = 0; I < 10; I++)
+      Sum += Square(I);
+   P.A = Sum, P.B = -Sum;
+   printf("%d %d\n", P.A, P.B);
+}
@@ -0,0 +1,56 @@
+#include <stdio.h>
+
+int Data[8];
+
+int Length(char *S) {
+   int N = 0;
+   while (S[N] != 0)
+      N++;
+   return N;
+}
+
+// A counted loop, whose jump back is a compare in the trace, with a branch that's taken on the traced iteration.
+int Evens(int N) {
+   int I, Count = 0;
+   for (I = 0; I < N; I++) {
+      if (I%2 == 0)
+         Count++;
+   }
+   return Count;
+}
+
+// A loop over a global array, with a call and a branch that isn't taken on the traced iteration.
+int Sum(int N) {
+   int I, S = 0;
+   for (I = 0; I < N; I++) {
+      Data[I&7] = I;
+      if (I < 0)
+         S--;
+      S += Data[I&7] + Length("ab");
+   }
+   return S;
+}
+
+// A loop that returns before it's been around once, when it's traced: no trace.
+int Find(int N) {
+   int I = 0;
+   while (1) {
+      if (I == N)
+         return I;
+      I++;
+   }
+}
+
+// An outer loop, which has an inner one in it: only the inner loop is traced.
+int Nested(int N) {
+   int I, J, S = 0;
+   for (I = 0; I < N; I++) {
+      for (J = 0; J < N; J++)
+         S += J;
+   }
+   return S;
+}
+
+void main() {
+   printf("%d %d %d %d\n", Evens(100), Sum(100), Find(16), Nested(30));
+}
@@ -0,0 +1,59 @@
+// A microbenchmark of dispatch: loops of cheap operations, where most of the time goes on getting from one operation to the next.
+// Run it interpreted, with JIT=0,-1 for the compiled code interpreter, and with JIT=0,0 for machine code.
+#include <stdio.h>
+#include <time.h>
+
+unsigned Array[0x400];
+
+// Straight-line arithmetic.
+unsigned Count(int N) {
+   unsigned S = 0;
+   for (int I = 0; I < N; I++)
+      S += (I&7) ^ (I >> 3);
+   return S;
+}
+
+// A branch that goes both ways.
+unsigned Branch(int N) {
+   unsigned S = 0;
+   for (int I = 0; I < N; I++) {
+      if (I%3 == 0)
+         S += I;
+      else
+         S -= 1;
+   }
+   return S;
+}
+
+// Indexed loads and stores.
+unsigned Sweep(int N) {
+   unsigned S = 0;
+   for (int I = 0; I < N; I++) {
+      Array[I&0x3ff] += I;
+      S += Array[(I + 1)&0x3ff];
+   }
+   return S;
+}
+
+// Calls.
+int Fib(int N) {
+   if (N < 2)
+      return N;
+   return Fib(N - 1) + Fib(N - 2);
+}
+
+void Report(char *Name, clock_t Start, unsigned Result) {
+   printf("%-8s %6d ms   (%u)\n", Name, (int)((clock() - Start)/(CLOCKS_PER_SEC/1000)), Result);
+}
+
+int main() {
+   clock_t Start = clock();
+   Report("Count", Start, Count(1000000));
+   Start = clock();
+   Report("Branch", Start, Branch(1000000));
+   Start = clock();
+   Report("Sweep", Start, Sweep(1000000));
+   Start = clock();
+   Report("Fib", Start, Fib(25));
+   return 0;
+}
@@ -6,9 +6,25 @@
 static int PointerAlignBytes;
 static int IntAlignBytes;
 
+// Where a derived type goes in the index of types.
+#define HashType(Parent, Base, ArraySize, Identifier) ( \
+   ((unsigned long)(Parent) ^ (unsigned long)(Identifier) ^ ((unsigned long)(Base) << 4) ^ ((unsigned long)(ArraySize) << 8))%TypeTabMax \
+)
+
+// Enter a type in the index of types, under its parent.
+static void TypeIndex(State pc, ValueType ParentType, ValueType Typ) {
+   int HashValue = HashType(ParentType, Typ->Base, Typ->ArraySize, Typ->Identifier);
+   Typ->HashNext = pc->TypeHashTable[HashValue];
+   pc->TypeHashTable[HashValue] = Typ;
+}
+
 // Add a new type to the set of types we know about.
 static ValueType TypeAdd(State pc, ParseState Parser, ValueType ParentType, BaseType Base, int ArraySize, const char *Identifier, int Sizeof, int AlignBytes) {
-   ValueType NewType = VariableAlloc(pc, Parser, sizeof *NewType, true);
+   ValueType NewType = HeapAllocNode(pc, &pc->TypePool);
+   if (NewType == NULL)
+      ProgramFailNoParser(pc, "out of memory");
+   if (pc->AllocTrace != NULL)
+      HeapTrace(pc, TypeA, Parser != NULL? Parser->FileName: NULL, Parser != NULL? Parser->Line: 0, sizeof *NewType);
    NewType->Base = Base;
    NewType->ArraySize = ArraySize;
    NewType->Sizeof = Sizeof;
@@ -20,15 +36,16 @@ static ValueType TypeAdd(State pc, ParseState Parser, ValueType ParentType, Base
    NewType->OnHeap = true;
    NewType->Next = ParentType->DerivedTypeList;
    ParentType->DerivedTypeList = NewType;
+   TypeIndex(pc, ParentType, NewType);
    return NewType;
 }
 
 // Given a parent type, get a matching derived type and make one if necessary.
 // Identifier should be registered with the shared string table.
 ValueType TypeGetMatching(State pc, ParseState Parser, ValueType ParentType, BaseType Base, int ArraySize, const char *Identifier, bool AllowDuplicates) {
-   ValueType ThisType = ParentType->DerivedTypeList;
-   while (ThisType != NULL && (ThisType->Base != Base || ThisType->ArraySize != ArraySize || ThisType->Identifier != Identifier))
-      ThisType = ThisType->Next;
+   ValueType ThisType = pc->TypeHashTable[HashType(ParentType, Base, ArraySize, Identifier)];
+   while (ThisType != NULL && (ThisType->Base != Base || ThisType->ArraySize != ArraySize || ThisType->Identifier != Identifier || (ThisType->FromType != NULL? ThisType->FromType: &pc->UberType) != ParentType))
+      ThisType = ThisType->HashNext;
    if (ThisType != NULL) {
       if (AllowDuplicates)
          return ThisType;
@@ -80,6 +97,7 @@ static void TypeAddBaseType(State pc, ValueType TypeNode, BaseType Base, int Siz
    TypeNode->OnHeap = false;
    TypeNode->Next = pc->UberType.DerivedTypeList;
    pc->UberType.DerivedTypeList = TypeNode;
+   TypeIndex(pc, &pc->UberType, TypeNode);
 }
 
 // Initialize the type system.
@@ -137,20 +155,16 @@ void TypeInit(State pc) {
    pc->VoidPtrType = TypeAdd(pc, NULL, &pc->VoidType, PointerT, 0, pc->StrEmpty, sizeof pa.y, PointerAlignBytes);
 }
 
-// Deallocate heap-allocated types.
+// Deallocate the members of heap-allocated types.
+// The type nodes themselves are released in bulk with the type pool by HeapCleanup().
 static void TypeCleanupNode(State pc, ValueType Typ) {
 // Clean up and free all the sub-nodes.
-   for (ValueType SubType = Typ->DerivedTypeList, NextSubType; SubType != NULL; SubType = NextSubType) {
-      NextSubType = SubType->Next;
+   for (ValueType SubType = Typ->DerivedTypeList; SubType != NULL; SubType = SubType->Next) {
       TypeCleanupNode(pc, SubType);
-      if (SubType->OnHeap) {
-      // If it's a struct or union deallocate all the member values.
-         if (SubType->Members != NULL) {
-            VariableTableCleanup(pc, SubType->Members);
-            HeapFreeMem(pc, SubType->Members);
-         }
-      // Free this node.
-         HeapFreeMem(pc, SubType);
+   // If it's a struct or union deallocate all the member values.
+      if (SubType->OnHeap && SubType->Members != NULL) {
+         VariableTableCleanup(pc, SubType->Members);
+         HeapFreeMem(pc, SubType->Members);
       }
    }
 }
@@ -289,8 +303,8 @@ static void TypeParseEnum(ParseState Parser, ValueType *Typ) {
 ValueType TypeParseFront(ParseState Parser, bool *IsStatic) {
    ValueType Type = NULL;
 // Ignore leading type qualifiers.
-   struct ParseState Before;
-   ParserCopy(&Before, Parser);
+   struct ParseCursor Before;
+   ParserCopyPos(&Before, Parser);
    Value LexerValue;
    Lexical Token = LexGetToken(Parser, &LexerValue, true);
    bool StaticQualifier = false;
@@ -333,15 +347,15 @@ ValueType TypeParseFront(ParseState Parser, bool *IsStatic) {
       break;
    // We already know it's a typedef-defined type because we got here.
       case IdL: Type = VariableGet(pc, Parser, LexerValue->Val->Identifier)->Val->Typ; break;
-      default: ParserCopy(Parser, &Before); return Type;
+      default: ParserCopyPos(Parser, &Before); return Type;
    }
    return Type;
 }
 
 // Parse a type - the part at the end after the identifier. e.g. array specifications etc.
 static ValueType TypeParseBack(ParseState Parser, ValueType FromType) {
-   struct ParseState Before;
-   ParserCopy(&Before, Parser);
+   struct ParseCursor Before;
+   ParserCopyPos(&Before, Parser);
    Lexical Token = LexGetToken(Parser, NULL, true);
    if (Token == LBrL) {
    // Add another array bound.
@@ -361,7 +375,7 @@ static ValueType TypeParseBack(ParseState Parser, ValueType FromType) {
       }
    } else {
    // The type specification has finished.
-      ParserCopy(Parser, &Before);
+      ParserCopyPos(Parser, &Before);
       return FromType;
    }
 }
@@ -372,8 +386,8 @@ ValueType TypeParseIdentPart(ParseState Parser, ValueType BasicTyp, char **Ident
    *Identifier = Parser->pc->StrEmpty;
    bool Done = false;
    while (!Done) {
-      struct ParseState Before;
-      ParserCopy(&Before, Parser);
+      struct ParseCursor Before;
+      ParserCopyPos(&Before, Parser);
       Value LexValue;
       Lexical Token = LexGetToken(Parser, &LexValue, true);
       switch (Token) {
@@ -395,7 +409,7 @@ ValueType TypeParseIdentPart(ParseState Parser, ValueType BasicTyp, char **Ident
             *Identifier = LexValue->Val->Identifier;
             Done = true;
          break;
-         default: ParserCopy(Parser, &Before), Done = true; break;
+         default: ParserCopyPos(Parser, &Before), Done = true; break;
       }
    }
    if (Type == NULL)
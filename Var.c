@@ -16,8 +16,11 @@ void VariableFree(State pc, Value Val) {
       if (Val->Typ == &pc->FunctionType && Val->Val->FuncDef.Intrinsic == NULL && Val->Val->FuncDef.Body.Pos != NULL)
          HeapFreeMem(pc, (void *)Val->Val->FuncDef.Body.Pos);
    // Free macro bodies.
-      if (Val->Typ == &pc->MacroType)
+      if (Val->Typ == &pc->MacroType) {
          HeapFreeMem(pc, (void *)Val->Val->MacroDef.Body.Pos);
+         if (Val->Val->MacroDef.Folded != NULL)
+            VariableFree(pc, Val->Val->MacroDef.Folded);
+      }
    // Free the AnyValue.
       if (Val->AnyValOnHeap)
          HeapFreeMem(pc, Val->Val);
@@ -27,21 +30,26 @@ void VariableFree(State pc, Value Val) {
       HeapFreeMem(pc, Val);
 }
 
-// Deallocate the global table and the string literal table.
+// Deallocate the values in the global table and the string literal table.
+// The hash table entries themselves are released in bulk with the entry pool by HeapCleanup().
 void VariableTableCleanup(State pc, Table HashTable) {
    for (int Count = 0; Count < HashTable->Size; Count++) {
-      for (TableEntry Entry = HashTable->HashTable[Count], NextEntry; Entry != NULL; Entry = NextEntry) {
-         NextEntry = Entry->Next;
+      for (TableEntry Entry = HashTable->HashTable[Count]; Entry != NULL; Entry = Entry->Next)
          VariableFree(pc, Entry->p.v.Val);
-      // Free the hash table entry.
-         HeapFreeMem(pc, Entry);
-      }
    }
 }
 
 void VariableCleanup(State pc) {
    VariableTableCleanup(pc, &pc->GlobalTable);
    VariableTableCleanup(pc, &pc->StringLiteralTable);
+   for (int Count = 0; Count < StaTabMax; Count++) {
+      while (pc->StaticHashTable[Count] != NULL) {
+         StaticSite Next = pc->StaticHashTable[Count]->Next;
+         HeapFreeMem(pc, pc->StaticHashTable[Count]->Mirror);
+         HeapFreeMem(pc, pc->StaticHashTable[Count]);
+         pc->StaticHashTable[Count] = Next;
+      }
+   }
 }
 
 // Allocate some memory, either on the heap or the stack and check if we've run out.
@@ -49,6 +57,8 @@ void *VariableAlloc(State pc, ParseState Parser, int Size, bool OnHeap) {
    void *NewValue = OnHeap? HeapAllocMem(pc, Size): HeapAllocStack(pc, Size);
    if (NewValue == NULL)
       ProgramFail(Parser, "out of memory");
+   if (pc->AllocTrace != NULL)
+      HeapTrace(pc, ValueA, Parser != NULL? Parser->FileName: NULL, Parser != NULL? Parser->Line: 0, Size);
 #ifdef DEBUG_HEAP
    if (!OnHeap)
       printf("pushing %d at 0x%lx\n", Size, (unsigned long)NewValue);
@@ -80,6 +90,32 @@ Value VariableAllocValueFromType(State pc, ParseState Parser, ValueType Typ, boo
    return NewValue;
 }
 
+// Allocate the values for a call's arguments, of the given types, on the stack, all in one piece after the array that points to them.
+// Any after the parameters are laid out the way a variable argument list is.
+Value *VariableAllocArguments(ParseState Parser, int NumArgs, ValueType *ArgType) {
+   State pc = Parser->pc;
+   int Size = MemAlign(NumArgs*sizeof(Value));
+   for (int Count = 0; Count < NumArgs; Count++)
+      Size += MemAlign(sizeof(struct Value)) + MemAlign(TypeSize(ArgType[Count], ArgType[Count]->ArraySize, false));
+   Value *ParamArray = VariableAlloc(pc, Parser, Size, false);
+   char *Pos = AddAlign(ParamArray, NumArgs*sizeof *ParamArray);
+   for (int Count = 0; Count < NumArgs; Count++) {
+      Value Param = ParamArray[Count] = (Value)Pos;
+      Param->Typ = ArgType[Count];
+      Param->Val = (AnyValue)AddAlign(Param, sizeof *Param);
+      Param->ValOnStack = true;
+      Param->ScopeID = Parser->ScopeID;
+      Pos = AddAlign(Param->Val, TypeSize(Param->Typ, Param->Typ->ArraySize, false));
+   }
+   return ParamArray;
+}
+
+// Allocate the values for a function's parameters.
+// The arguments are then evaluated straight into them.
+Value *VariableAllocParameters(ParseState Parser, struct FuncDef *Func) {
+   return VariableAllocArguments(Parser, Func->NumParams, Func->ParamType);
+}
+
 // Allocate a value either on the heap or the stack and copy its value.
 // Handles overlapping data.
 Value VariableAllocValueAndCopy(State pc, ParseState Parser, Value FromValue, bool OnHeap) {
@@ -203,12 +239,60 @@ Value VariableDefine(State pc, ParseState Parser, char *Ident, Value InitValue,
       VariableAllocValueFromType(pc, Parser, Typ, MakeWritable, NULL, pc->TopStackFrame == NULL);
    AssignValue->IsLValue = MakeWritable;
    AssignValue->ScopeID = ScopeID;
+#ifdef TAIL_CALLS
+   if (pc->TopStackFrame != NULL && (AssignValue->Typ->Base == ArrayT || AssignValue->Typ->Base == StructT || AssignValue->Typ->Base == UnionT))
+      pc->TopStackFrame->Addressed = true;
+#endif
    AssignValue->OutOfScope = false;
    if (!TableSet(pc, currentTable, Ident, AssignValue, Parser? (char *)Parser->FileName: NULL, Parser? Parser->Line: 0, Parser? Parser->CharacterPos: 0))
       ProgramFail(Parser, "'%s' is already defined", Ident);
    return AssignValue;
 }
 
+// Define a function parameter in the current stack frame, using the value its argument was evaluated into, rather than a copy.
+void VariableDefineParameter(ParseState Parser, char *Ident, Value Param) {
+   Param->IsLValue = true;
+   Param->ScopeID = -1; // Function parameters should not go out of scope.
+#ifdef TAIL_CALLS
+   if (Param->Typ->Base == StructT || Param->Typ->Base == UnionT)
+      Parser->pc->TopStackFrame->Addressed = true;
+#endif
+   if (!TableSet(Parser->pc, &Parser->pc->TopStackFrame->LocalTable, Ident, Param, (char *)Parser->FileName, Parser->Line, Parser->CharacterPos))
+      ProgramFail(Parser, "'%s' is already defined", Ident);
+}
+
+// Find or define the global store for a static variable, under a name mangled from the file, the function and the variable.
+static Value VariableDefineStatic(ParseState Parser, char *Ident, ValueType Typ, bool *FirstVisit) {
+   State pc = Parser->pc;
+// Make the mangled static name (avoiding using sprintf() to minimize library impact).
+   char MangledName[LineBufMax];
+   char *MNPos = MangledName;
+   char *MNEnd = &MangledName[LineBufMax - 1];
+   memset((void *)&MangledName, '\0', sizeof MangledName);
+   *MNPos++ = '/';
+   strncpy(MNPos, (char *)Parser->FileName, MNEnd - MNPos);
+   MNPos += strlen(MNPos);
+   if (pc->TopStackFrame != NULL) {
+   // We're inside a function.
+      if (MNEnd - MNPos > 0) *MNPos++ = '/';
+      strncpy(MNPos, (char *)pc->TopStackFrame->FuncName, MNEnd - MNPos);
+      MNPos += strlen(MNPos);
+   }
+   if (MNEnd - MNPos > 0) *MNPos++ = '/';
+   strncpy(MNPos, Ident, MNEnd - MNPos);
+   const char *RegisteredMangledName = TableStrRegister(pc, MangledName);
+// Is this static already defined?
+   const char *DeclFileName; int DeclLine, DeclColumn;
+   Value ExistingValue = TableGet(&pc->GlobalTable, RegisteredMangledName, &DeclFileName, &DeclLine, &DeclColumn);
+   if (ExistingValue == NULL) {
+   // Define the mangled-named static variable store in the global scope.
+      ExistingValue = VariableAllocValueFromType(Parser->pc, Parser, Typ, true, NULL, true);
+      TableSet(pc, &pc->GlobalTable, (char *)RegisteredMangledName, ExistingValue, (char *)Parser->FileName, Parser->Line, Parser->CharacterPos);
+      *FirstVisit = true;
+   }
+   return ExistingValue;
+}
+
 // Define a variable.
 // Ident must be registered.
 // If it's a redefinition from the same declaration don't throw an error.
@@ -218,35 +302,41 @@ Value VariableDefineButIgnoreIdentical(ParseState Parser, char *Ident, ValueType
    if (TypeIsForwardDeclared(Parser, Typ))
       ProgramFail(Parser, "type '%t' isn't defined", Typ);
    if (IsStatic) {
-   // Make the mangled static name (avoiding using sprintf() to minimize library impact).
-      char MangledName[LineBufMax];
-      char *MNPos = MangledName;
-      char *MNEnd = &MangledName[LineBufMax - 1];
-      memset((void *)&MangledName, '\0', sizeof MangledName);
-      *MNPos++ = '/';
-      strncpy(MNPos, (char *)Parser->FileName, MNEnd - MNPos);
-      MNPos += strlen(MNPos);
-      if (pc->TopStackFrame != NULL) {
-      // We're inside a function.
-         if (MNEnd - MNPos > 0) *MNPos++ = '/';
-         strncpy(MNPos, (char *)pc->TopStackFrame->FuncName, MNEnd - MNPos);
-         MNPos += strlen(MNPos);
-      }
-      if (MNEnd - MNPos > 0) *MNPos++ = '/';
-      strncpy(MNPos, Ident, MNEnd - MNPos);
-      const char *RegisteredMangledName = TableStrRegister(pc, MangledName);
-   // Is this static already defined?
-      const char *DeclFileName; int DeclLine, DeclColumn;
-      Value ExistingValue = TableGet(&pc->GlobalTable, RegisteredMangledName, &DeclFileName, &DeclLine, &DeclColumn);
-      if (ExistingValue == NULL) {
-      // Define the mangled-named static variable store in the global scope.
-         ExistingValue = VariableAllocValueFromType(Parser->pc, Parser, Typ, true, NULL, true);
-         TableSet(pc, &pc->GlobalTable, (char *)RegisteredMangledName, ExistingValue, (char *)Parser->FileName, Parser->Line, Parser->CharacterPos);
-         *FirstVisit = true;
+      if (pc->TopStackFrame == NULL) {
+         Value ExistingValue = VariableDefineStatic(Parser, Ident, Typ, FirstVisit);
+      // Static variable exists in the global scope - now make a mirroring variable in our own scope with the short name.
+         VariableDefinePlatformVar(Parser->pc, Parser, Ident, ExistingValue->Typ, ExistingValue->Val, true);
+         return ExistingValue;
+      } else {
+      // A static local: after the first visit to its declaration, it's found by where it's declared.
+         int HashValue = (unsigned long)Parser->Pos%StaTabMax;
+         StaticSite Site = pc->StaticHashTable[HashValue];
+         for (; Site != NULL; Site = Site->Next) {
+            if (Site->Site == Parser->Pos && Site->Ident == Ident && Site->FuncName == pc->TopStackFrame->FuncName && Site->FileName == Parser->FileName)
+               break;
+         }
+         if (Site == NULL) {
+            Site = HeapAllocMem(pc, sizeof *Site);
+            if (Site == NULL)
+               ProgramFail(Parser, "out of memory");
+            if (pc->AllocTrace != NULL)
+               HeapTrace(pc, EntryA, Parser->FileName, Parser->Line, sizeof *Site);
+            Site->Site = Parser->Pos, Site->Ident = Ident, Site->FuncName = pc->TopStackFrame->FuncName, Site->FileName = Parser->FileName;
+            Site->Static = VariableDefineStatic(Parser, Ident, Typ, FirstVisit);
+            Site->Mirror = VariableAllocValueAndData(pc, NULL, 0, true, NULL, true);
+            Site->Mirror->Typ = Site->Static->Typ, Site->Mirror->Val = Site->Static->Val;
+            Site->Mirror->ScopeID = -1; // Like a parameter, it's there for the rest of the function.
+            Site->Next = pc->StaticHashTable[HashValue], pc->StaticHashTable[HashValue] = Site;
+         }
+      // Put its mirror in our own scope with the short name, unless it's there from an earlier visit in this call.
+      // The entry goes with the frame, and the mirror with the site.
+         if (
+            !TableSet(pc, &pc->TopStackFrame->LocalTable, Ident, Site->Mirror, (char *)Parser->FileName, Parser->Line, Parser->CharacterPos) &&
+            TableGet(&pc->TopStackFrame->LocalTable, Ident, NULL, NULL, NULL) != Site->Mirror
+         )
+            ProgramFail(Parser, "'%s' is already defined", Ident);
+         return Site->Static;
       }
-   // Static variable exists in the global scope - now make a mirroring variable in our own scope with the short name.
-      VariableDefinePlatformVar(Parser->pc, Parser, Ident, ExistingValue->Typ, ExistingValue->Val, true);
-      return ExistingValue;
    } else if (Parser->Line == 0) return false;
    else {
       const char *DeclFileName; int DeclLine, DeclColumn;
@@ -310,16 +400,27 @@ void VariableStackPop(ParseState Parser, Value Var) {
 }
 
 // Add a stack frame when doing a function call.
-void VariableStackFrameAdd(ParseState Parser, const char *FuncName, int NumParams) {
+// The frame, its parameters and a local hash table sized for NumLocals (or LocTabMax, if negative) share one uncleared stack allocation,
+// so popping the frame releases them all at once.
+void VariableStackFrameAdd(ParseState Parser, const char *FuncName, int NumParams, int NumLocals) {
+   int TableSize = NumLocals < 0? LocTabMax: NumLocals|1; // An odd size, since the keys hashed on are aligned addresses.
    HeapPushStackFrame(Parser->pc);
-   StackFrame NewFrame = HeapAllocStack(Parser->pc, sizeof *NewFrame + NumParams*sizeof *NewFrame->Parameter);
+   StackFrame NewFrame = HeapReserveStack(Parser->pc, sizeof *NewFrame + NumParams*sizeof *NewFrame->Parameter + TableSize*sizeof(TableEntry));
    if (NewFrame == NULL)
       ProgramFail(Parser, "out of memory");
-   ParserCopy(&NewFrame->ReturnParser, Parser);
+   ParserCopyPos(&NewFrame->ReturnPos, Parser);
    NewFrame->FuncName = FuncName;
+   NewFrame->ReturnValue = NULL;
    NewFrame->Parameter = NumParams > 0? (void *)((char *)NewFrame + sizeof *NewFrame): NULL;
-   TableInitTable(&NewFrame->LocalTable, NewFrame->LocalHashTable, LocTabMax, false);
+   NewFrame->NumParams = NumParams;
+   TableInitTable(&NewFrame->LocalTable, (TableEntry *)((char *)NewFrame + sizeof *NewFrame + NumParams*sizeof *NewFrame->Parameter), TableSize, false);
    NewFrame->PreviousStackFrame = Parser->pc->TopStackFrame;
+#ifndef NO_COMPILER
+   NewFrame->FuncValue = NULL;
+#endif
+#ifdef TAIL_CALLS
+   NewFrame->Addressed = false;
+#endif
    Parser->pc->TopStackFrame = NewFrame;
 }
 
@@ -327,7 +428,7 @@ void VariableStackFrameAdd(ParseState Parser, const char *FuncName, int NumParam
 void VariableStackFramePop(ParseState Parser) {
    if (Parser->pc->TopStackFrame == NULL)
       ProgramFail(Parser, "stack is empty - can't go back");
-   ParserCopy(Parser, &Parser->pc->TopStackFrame->ReturnParser);
+   ParserCopyPos(Parser, &Parser->pc->TopStackFrame->ReturnPos);
    Parser->pc->TopStackFrame = Parser->pc->TopStackFrame->PreviousStackFrame;
    HeapPopStackFrame(Parser->pc);
 }
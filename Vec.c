@@ -0,0 +1,125 @@
+// PicoC vector kernels:
+// This runs the element-wise loops that Comp.c finds, such as c[i] = a[i]*k + b[i] over int or double arrays,
+// a batch of iterations at a time: each operation of the loop's body is done on the elements of a whole batch at once.
+// With GCC or Clang a batch is a vector, done in SSE2 registers on x86-64, or in AVX2 ones on a processor that has them;
+// other compilers get a loop over the elements of the batch.
+#include "Extern.h"
+
+#ifndef NO_COMPILER
+#define BatchSize 32 // The bytes in a batch: 8 ints or 4 doubles.
+#define StripMax 0x10 // The most batches run through each operation at once.
+#define IntLanes (BatchSize/sizeof(int))
+#define RatLanes (BatchSize/sizeof(double))
+
+#if defined __GNUC__ && !defined NO_SIMD
+#   define SIMD
+#endif
+
+// A register of a kernel: a batch of values.
+// The ints are kept as unsigned, so that they wrap as the compiled code's do, which only keeps the low 32 bits of them.
+typedef union Batch {
+#ifdef SIMD
+   unsigned Int __attribute__((vector_size(BatchSize)));
+#   ifndef NO_FP
+   double Rat __attribute__((vector_size(BatchSize)));
+#   endif
+#else
+   unsigned Int[IntLanes];
+#   ifndef NO_FP
+   double Rat[RatLanes];
+#   endif
+#endif
+} *Batch;
+
+// An operation on each value of each batch S of a strip: a vector operation on each batch, with SIMD, else a loop over its values.
+#ifdef SIMD
+#   define ForInt for (int S = 0; S < Strip; S++)
+#   define ForRat for (int S = 0; S < Strip; S++)
+#   define Each
+#else
+#   define ForInt for (int S = 0; S < Strip; S++) for (int L = 0; L < IntLanes; L++)
+#   define ForRat for (int S = 0; S < Strip; S++) for (int L = 0; L < RatLanes; L++)
+#   define Each [L]
+#endif
+
+// With GCC on x86-64 Linux the batches are run by two versions of the code, one for AVX2 and one for SSE2, picked when the program's loaded.
+#if defined SIMD && defined __x86_64__ && defined __linux__ && !defined __clang__ && __GNUC__ >= 6
+#   define MULTIVERSION __attribute__((target_clones("avx2", "default")))
+#else
+#   define MULTIVERSION
+#endif
+
+// The iterations a kernel runs at once.
+int VecLanes(CodeKernel Kernel) {
+#ifndef NO_FP
+   if (Kernel->IsRat)
+      return RatLanes;
+#endif
+   return IntLanes;
+}
+
+// Fill each value of a register with the value in a slot.
+static void Fill(Batch Reg, bool IsRat, union CodeSlot Value) {
+#ifndef NO_FP
+   if (IsRat) {
+      for (int L = 0; L < RatLanes; L++)
+         Reg->Rat[L] = Value.FP;
+      return;
+   }
+#endif
+   for (int L = 0; L < IntLanes; L++)
+      Reg->Int[L] = (unsigned)Value.Integer;
+}
+
+// Run the kernel on its registers Reg for the whole batches of iterations, from I on, that end before the last one, up to N.
+// Each operation's done on a strip of up to StripMax batches before the next, so that it's picked once for all of them.
+// Return the iteration it stops at.
+static MULTIVERSION long Batches(CodeKernel Kernel, Batch Reg, long I, long N) {
+   int Lanes = VecLanes(Kernel), Size = BatchSize/Lanes;
+   for (int Strip; (Strip = (N - 1 - I)/Lanes) > 0; I += Strip*Lanes) {
+      if (Strip > StripMax)
+         Strip = StripMax;
+      for (CodeOp Op = Kernel->Ops; Op < Kernel->Ops + Kernel->NumOps; Op++) {
+         Batch A = &Reg[Op->A*StripMax], B = &Reg[Op->B*StripMax], C = &Reg[Op->C*StripMax];
+         switch ((OpCode)Op->Code) {
+            case MovKC: for (int S = 0; S < Strip; S++) Fill(&A[S], Kernel->IsRat, Op->K); break;
+            case MovC: case ConvC: memcpy(A, B, Strip*sizeof *A); break;
+            case LoadXC: memcpy(A, (char *)Op->K.Pointer + I*Size, Strip*sizeof *A); break;
+            case StoreXC: memcpy((char *)Op->K.Pointer + I*Size, A, Strip*sizeof *A); break;
+            case AddC: ForInt A[S].Int Each = B[S].Int Each + C[S].Int Each; break;
+            case SubC: ForInt A[S].Int Each = B[S].Int Each - C[S].Int Each; break;
+            case MulC: ForInt A[S].Int Each = B[S].Int Each*C[S].Int Each; break;
+            case AndC: ForInt A[S].Int Each = B[S].Int Each&C[S].Int Each; break;
+            case OrC: ForInt A[S].Int Each = B[S].Int Each|C[S].Int Each; break;
+            case XOrC: ForInt A[S].Int Each = B[S].Int Each^C[S].Int Each; break;
+            case AddKC: ForInt A[S].Int Each = B[S].Int Each + (unsigned)Op->K.Integer; break;
+            case NegC: ForInt A[S].Int Each = -B[S].Int Each; break;
+            case CplC: ForInt A[S].Int Each = ~B[S].Int Each; break;
+#ifndef NO_FP
+            case FAddC: ForRat A[S].Rat Each = B[S].Rat Each + C[S].Rat Each; break;
+            case FSubC: ForRat A[S].Rat Each = B[S].Rat Each - C[S].Rat Each; break;
+            case FMulC: ForRat A[S].Rat Each = B[S].Rat Each*C[S].Rat Each; break;
+            case FDivC: ForRat A[S].Rat Each = B[S].Rat Each/C[S].Rat Each; break;
+            case FNegC: ForRat A[S].Rat Each = -B[S].Rat Each; break;
+#endif
+            default: break;
+         }
+      }
+   }
+   return I;
+}
+
+// Run an element-wise loop through its kernel, from where its count is, as many whole batches of iterations as come before its last one,
+// leaving its count where the loop's to carry on.
+void VecRun(CodeKernel Kernel, CodeSlot Slots) {
+   long I = Slots[Kernel->Index].Integer, N = Slots[Kernel->Bound].Integer;
+   if (I + VecLanes(Kernel) >= N || (int)N != N)
+      return;
+   union Batch Reg[KernelRegMax*StripMax];
+   for (struct CodeSplat *Splat = Kernel->Splat; Splat < Kernel->Splat + Kernel->NumSplats; Splat++) {
+      for (int S = 0; S < StripMax; S++)
+         Fill(&Reg[Splat->Reg*StripMax + S], Kernel->IsRat, Slots[Splat->Slot]);
+   }
+   Slots[Kernel->Index].Integer = Batches(Kernel, Reg, I, N);
+}
+#endif